@@ -0,0 +1,762 @@
+// Headless benchmark driver. Runs the simulation core without a window and
+// reports throughput and step latency.
+//
+//   ./bench -c 800 -r 600 -s 42 -n 1000 -S mixed
+//   ./bench -c 4096 -r 4096 -n 1000 -L B3/S23
+//   ./bench -c 256 -r 256 -n 100 -L B3/S23 -J 10
+//   ./bench -R session.log
+//   ./bench -n 1000000 -O sand & ./stream_view sand
+//   ./bench -c 128 -r 96 -n 3000 -S fire_storm -E 8 -X fire_decay=2,5,10 -C sweep.csv
+//   ./bench -c 1024 -r 1024 -n 500 -S sand_pile -D 8
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim.h"
+#include "chunk.h"
+#include "thermal.h"
+#include "life.h"
+#include "hashlife.h"
+#include "sector.h"
+#include "save.h"
+#include "replay.h"
+#include "brush.h"
+#include "profile.h"
+#include "stream.h"
+#include "ensemble.h"
+#include "strips.h"
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "usage: %s [-c cols] [-r rows] [-s seed] [-n steps] [-S scenario] [-F] [-t threads] [-H isa] [-W] [-P n] [-A file] [-L rule [-J k]] [-R log] [-T name] [-O name]\n"
+        "       %s -U [-s seed]\n"
+        "       %s -E n [-X param=v1,v2,...]... [-C file] [-c cols] [-r rows] [-s seed] [-n steps] [-S scenario] [-t threads] [-W]\n"
+        "       %s -D n [-c cols] [-r rows] [-s seed] [-n steps] [-S scenario] [-F] [-W]\n"
+        "  -F  full sweep, disable active-chunk tracking\n"
+        "  -t  checkerboard tile mode on this many threads\n"
+        "  -H  thermal kernel: scalar, ssse3 or avx2 (default: best supported)\n"
+        "  -W  disable pressure-driven water levelling\n"
+        "  -P  pan the window one sector right every n steps over an unbounded world\n"
+        "  -A  save to this file in the background halfway, then save, reload and compare at the end\n"
+        "  -L  run the Life-like engine with this B/S rule instead (-H: scalar or avx2)\n"
+        "  -J  with -L, run HashLife instead, each step jumping 2^k generations\n"
+        "  -R  replay an input log recorded by the game (--record), checking its checksums;\n"
+        "      -t overrides the recorded thread count\n"
+        "  -T  write name.json (Chrome trace) and name.csv; needs make PROFILE=1\n"
+        "  -O  publish every tick to the shared-memory stream name (stream_view, stream_record)\n"
+        "  -E  ensemble: n seeds of every -X combination, each world run to -n steps or until\n"
+        "      it settles, spread over -t threads (default: all cores)\n"
+        "  -X  sweep a parameter over a comma-separated list; repeat for a grid of sweeps\n"
+        "  -C  per-world results for -E (default ensemble.csv)\n"
+        "  -D  split the grid into horizontal strips, one process each, and time 1, 2, 4 ... n\n"
+        "      processes against each other\n"
+        "  -U  check that water levels in a U-tube, chunked and with a full sweep\n"
+        "params:    %s\n"
+        "scenarios:", prog, prog, prog, prog, sim_params_names());
+    for (int i = 0; i < SCENARIO_COUNT; i++) {
+        fprintf(stderr, " %s", scenario_name(i));
+    }
+    fprintf(stderr, "\n");
+}
+
+// Saves the finished run, loads it into a fresh world and compares
+static bool check_save(const char *path, SectorMap *sectors, World *world) {
+    uint64_t t0 = now_ns();
+    SaveJob *job = save_begin(sectors, world, path);
+    uint64_t begin_ns = now_ns() - t0;
+    if (!job || !save_end(sectors, job)) return false;
+    uint64_t save_ns = now_ns() - t0;
+
+    World *loaded = world_create(world->rows, world->cols, 0);
+    SectorMap *map = sector_map_create(sectors->window_w, sectors->window_h, NULL);
+    bool ok = loaded && map;
+    t0 = now_ns();
+    ok = ok && save_load(path, map, loaded);
+    uint64_t load_ns = now_ns() - t0;
+    if (ok) {
+        const SaveHeader *h = map->backing->header;
+        printf("save:       %u sectors, %.1f KB (%.2f bytes/cell)\n", h->sector_count, map->backing->size / 1e3,
+               (double)map->backing->size / ((double)(h->sector_count ? h->sector_count : 1) * SECTOR_CELLS));
+        printf("save time:  %.2f ms on the sim thread, %.2f ms in all\n", begin_ns / 1e6, save_ns / 1e6);
+        printf("load:       %.2f ms, %u sectors left undecoded, checksum %s\n",
+               load_ns / 1e6, map->count,
+               world_checksum(loaded) == world_checksum(world) && loaded->tick == world->tick ? "matches" : "MISMATCH");
+    }
+    sector_map_destroy(map);
+    world_destroy(loaded);
+    return ok;
+}
+
+// Zone and per-element totals of a PROFILE build
+static void print_profile(uint64_t steps) {
+    ProfileTotals totals;
+    profile_read(&totals);
+    for (int z = 0; z < PROFILE_ZONE_COUNT; z++) {
+        const ProfileZoneStats *s = &totals.zones[z];
+        if (!s->calls) continue;
+        printf("zone:       %-9s %8llu calls %10.3f ms  mean %9.1f us  max %9.1f us\n", profile_zone_name(z),
+               (unsigned long long)s->calls, s->total_ns / 1e6, s->total_ns / 1e3 / s->calls, s->max_ns / 1e3);
+    }
+    for (int e = 0; e < ELEMENT_COUNT; e++) {
+        const ProfileElementStats *s = &totals.elements[e];
+        if (!s->visited && !s->skipped) continue;
+        printf("element:    %-9s %10.0f visited %10.0f moved %10.0f skipped per step  %6.1f ns/visit\n",
+               element_info[e].name, (double)s->visited / steps, (double)s->moved / steps,
+               (double)s->skipped / steps, s->visited ? s->cycles * totals.ns_per_cycle / s->visited : 0.0);
+    }
+}
+
+static bool write_profile(const char *name) {
+    if (!PROFILE_ENABLED) {
+        fprintf(stderr, "-T needs a profiling build: make bench PROFILE=1\n");
+        return false;
+    }
+    size_t length = strlen(name) + sizeof(".json");
+    char *path = (char *)malloc(length);
+    if (!path) return false;
+    snprintf(path, length, "%s.json", name);
+    bool ok = profile_write_trace(path);
+    snprintf(path, length, "%s.csv", name);
+    ok = ok && profile_write_csv(path);
+    free(path);
+    return ok;
+}
+
+// Feeds a recorded session back into a headless world as fast as it will
+// go. Pauses only stopped the clock, so they are counted and skipped.
+static int run_replay(const char *path, int threads) {
+    ReplayLog *log = replay_open(path);
+    if (!log) return 1;
+    const ReplayHeader *h = &log->header;
+    World *world = world_create(h->rows, h->cols, h->seed);
+    SectorMap *sectors = h->sectors ? sector_map_create(h->window_w, h->window_h, NULL) : NULL;
+    if (!world || (h->sectors && !sectors) || !world_set_threads(world, threads >= 0 ? threads : h->threads)) {
+        sector_map_destroy(sectors);
+        world_destroy(world);
+        replay_close(log);
+        return 1;
+    }
+    world->chunking = h->chunking;
+    world->levelling = h->levelling;
+    world->tick = h->start_tick;
+    world_load_scenario(world, (Scenario)h->scenario);
+    if (sectors) {
+        sectors->window_sx = h->window_sx;
+        sectors->window_sy = h->window_sy;
+    }
+
+    uint64_t counts[REPLAY_KIND_COUNT] = { 0 };
+    uint64_t diverged_at = 0;
+    bool diverged = false;
+    bool ended = false;
+    ReplayEvent event;
+    uint64_t start = now_ns();
+    while (!ended && replay_next(log, &event)) {
+        while (world->tick < event.tick) world_step(world);
+        counts[event.kind]++;
+        switch (event.kind) {
+            case REPLAY_BRUSH:
+                brush_paint(world, &event.stroke);
+                break;
+            case REPLAY_WINDOW:
+                if (sectors) sector_map_move_window(sectors, world, event.sx, event.sy);
+                break;
+            case REPLAY_CHECKSUM:
+            case REPLAY_END:
+                if (!diverged && world_checksum(world) != event.checksum) {
+                    diverged = true;
+                    diverged_at = event.tick;
+                }
+                ended = event.kind == REPLAY_END;
+                break;
+            case REPLAY_LOAD:
+                ended = true;
+                break;
+            default:
+                break;
+        }
+    }
+    uint64_t total = now_ns() - start;
+    uint64_t ticks = world->tick - h->start_tick;
+
+    printf("replay:     %s\n", path);
+    printf("grid:       %dx%d%s\n", h->cols, h->rows, h->sectors ? " sector window" : "");
+    printf("seed:       %u\n", h->seed);
+    printf("mode:       %s\n", world->threads > 0 ? "tiles" : "rows");
+    printf("threads:    %d\n", world->threads > 0 ? world->threads : 1);
+    printf("ticks:      %llu (%llu to %llu)\n", (unsigned long long)ticks,
+           (unsigned long long)h->start_tick, (unsigned long long)world->tick);
+    printf("events:     %llu strokes, %llu pause toggles, %llu window moves\n",
+           (unsigned long long)counts[REPLAY_BRUSH], (unsigned long long)counts[REPLAY_RUNNING],
+           (unsigned long long)counts[REPLAY_WINDOW]);
+    printf("steps/sec:  %.1f\n", ticks / (total / 1e9));
+    uint64_t checked = counts[REPLAY_CHECKSUM] + counts[REPLAY_END];
+    if (diverged) {
+        printf("checksums:  %llu checked, DIVERGED by tick %llu\n",
+               (unsigned long long)checked, (unsigned long long)diverged_at);
+    } else {
+        printf("checksums:  %llu checked, all match\n", (unsigned long long)checked);
+    }
+    if (counts[REPLAY_LOAD]) printf("stopped:    a snapshot was loaded at tick %llu\n", (unsigned long long)world->tick);
+    if (log->failed) printf("stopped:    log is cut short after tick %llu\n", (unsigned long long)log->tick);
+
+    bool ok = !diverged && !log->failed;
+    sector_map_destroy(sectors);
+    world_destroy(world);
+    replay_close(log);
+    return ok ? 0 : 1;
+}
+
+// Life-like engine from a 50% random soup
+static int run_life(int rows, int cols, unsigned int seed, int steps, LifeRule rule, const char *isa_name) {
+    LifeGrid *grid = life_create(rows, cols, rule);
+    if (!grid) return 1;
+    if (isa_name) {
+        int isa = -1;
+        for (int i = 0; i < LIFE_ISA_COUNT; i++) {
+            if (strcmp(isa_name, life_isa_name(i)) == 0) isa = i;
+        }
+        if (isa < 0 || !life_set_isa(grid, isa)) {
+            fprintf(stderr, "life kernel '%s' not supported\n", isa_name);
+            life_destroy(grid);
+            return 1;
+        }
+    }
+    life_randomize(grid, seed, 50);
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < steps; i++) {
+        life_step(grid);
+    }
+    uint64_t total = now_ns() - start;
+    double cells = (double)rows * cols * steps;
+
+    char rule_text[24];
+    life_format_rule(rule, rule_text, sizeof(rule_text));
+    printf("rule:       %s\n", rule_text);
+    printf("grid:       %dx%d\n", cols, rows);
+    printf("seed:       %u\n", seed);
+    printf("steps:      %d\n", steps);
+    printf("kernel:     %s\n", life_isa_name(grid->isa));
+    printf("memory:     %.2f MB (%.3f bytes/cell)\n",
+           life_memory_bytes(grid) / 1e6, (double)life_memory_bytes(grid) / ((double)rows * cols));
+    printf("steps/sec:  %.1f\n", steps / (total / 1e9));
+    printf("ns/cell:    %.4f\n", total / cells);
+    printf("Gcells/sec: %.2f\n", cells / total);
+    printf("population: %llu\n", (unsigned long long)life_population(grid));
+    printf("checksum:   %016llx\n", (unsigned long long)life_checksum(grid));
+
+    life_destroy(grid);
+    return 0;
+}
+
+// HashLife from the same soup, one jump of 2^k generations per step
+static int run_hashlife(int rows, int cols, unsigned int seed, int steps, LifeRule rule, int k) {
+    LifeGrid *soup = life_create(rows, cols, rule);
+    HashLife *hl = hashlife_create(rule);
+    if (!soup || !hl) {
+        life_destroy(soup);
+        hashlife_destroy(hl);
+        return 1;
+    }
+    life_randomize(soup, seed, 50);
+    bool loaded = hashlife_load_grid(hl, soup);
+    life_destroy(soup);
+    if (!loaded) {
+        fprintf(stderr, "HashLife ran out of memory loading the soup\n");
+        hashlife_destroy(hl);
+        return 1;
+    }
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < steps; i++) {
+        if (!hashlife_jump(hl, k)) {
+            fprintf(stderr, "pattern outgrew the universe or memory after %d jumps\n", i);
+            hashlife_destroy(hl);
+            return 1;
+        }
+    }
+    uint64_t total = now_ns() - start;
+
+    char rule_text[24];
+    life_format_rule(rule, rule_text, sizeof(rule_text));
+    printf("rule:       %s\n", rule_text);
+    printf("soup:       %dx%d\n", cols, rows);
+    printf("seed:       %u\n", seed);
+    printf("jumps:      %d x 2^%d\n", steps, k);
+    printf("generation: %llu\n", (unsigned long long)hl->generation);
+    printf("gens/sec:   %.4g\n", hl->generation / (total / 1e9));
+    printf("nodes:      %u (root level %d)\n", hl->live, hl->level);
+    printf("memory:     %.2f MB\n", hashlife_memory_bytes(hl) / 1e6);
+    printf("population: %llu\n", (unsigned long long)hashlife_population(hl));
+
+    hashlife_destroy(hl);
+    return 0;
+}
+
+// One -X option: a SimParams field and the values it takes
+#define MAX_SWEEPS 4
+#define MAX_SWEEP_VALUES 64
+// Ticks without any change before an ensemble world counts as settled
+#define ENSEMBLE_QUIET_TICKS 30
+
+typedef struct {
+    const char *name;
+    const char *values[MAX_SWEEP_VALUES];
+    int count;
+} Sweep;
+
+// Splits "name=v1,v2,..." in place and checks every value
+static bool parse_sweep(char *text, Sweep *sweep) {
+    char *eq = strchr(text, '=');
+    if (!eq) return false;
+    *eq = '\0';
+    sweep->name = text;
+    sweep->count = 0;
+    SimParams scratch = sim_default_params;
+    for (char *value = strtok(eq + 1, ","); value; value = strtok(NULL, ",")) {
+        if (sweep->count == MAX_SWEEP_VALUES || !sim_params_set(&scratch, sweep->name, value)) return false;
+        sweep->values[sweep->count++] = value;
+    }
+    return sweep->count > 0;
+}
+
+static int compare_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Every combination of the sweeps, `replicas` consecutive seeds each
+static int run_ensemble(int rows, int cols, unsigned int seed, int steps, int scenario, int replicas,
+                        int threads, bool levelling, const Sweep *sweeps, int sweep_count, const char *csv_path) {
+    int configs = 1;
+    for (int s = 0; s < sweep_count; s++) configs *= sweeps[s].count;
+    int count = configs * replicas;
+    EnsembleMember *members = (EnsembleMember *)malloc(count * sizeof(EnsembleMember));
+    int64_t *settled = (int64_t *)malloc(count * sizeof(int64_t));
+    if (!members || !settled) {
+        fprintf(stderr, "Failed to allocate %d ensemble members\n", count);
+        free(members);
+        free(settled);
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        members[i].scenario = (Scenario)scenario;
+        members[i].seed = seed + (unsigned int)(i % replicas);
+        members[i].params = sim_default_params;
+        // Mixed radix, the last sweep varies fastest
+        int config = i / replicas;
+        for (int s = sweep_count - 1; s >= 0; s--) {
+            sim_params_set(&members[i].params, sweeps[s].name, sweeps[s].values[config % sweeps[s].count]);
+            config /= sweeps[s].count;
+        }
+    }
+
+    uint64_t t0 = now_ns();
+    Ensemble *ensemble = ensemble_create(rows, cols, count, members);
+    free(members);
+    if (!ensemble) {
+        free(settled);
+        return 1;
+    }
+    uint64_t setup_ns = now_ns() - t0;
+    for (int i = 0; i < count; i++) ensemble->worlds[i]->levelling = levelling;
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > count) threads = count;
+    uint64_t total = ensemble_run(ensemble, threads, (uint64_t)steps, ENSEMBLE_QUIET_TICKS);
+    if (!total) {
+        ensemble_destroy(ensemble);
+        free(settled);
+        return 1;
+    }
+
+    uint64_t ticks = 0;
+    uint64_t busy_ns = 0;
+    int settled_count = 0;
+    for (int i = 0; i < count; i++) {
+        const EnsembleResult *r = &ensemble->results[i];
+        ticks += r->ticks;
+        busy_ns += r->elapsed_ns;
+        if (r->settle_tick >= 0) settled[settled_count++] = r->settle_tick;
+    }
+    qsort(settled, settled_count, sizeof(int64_t), compare_i64);
+    double seconds = total / 1e9;
+
+    printf("ensemble:   %d worlds (%d configurations x %d seeds)\n", count, configs, replicas);
+    printf("scenario:   %s\n", scenario_name(scenario));
+    printf("grid:       %dx%d each\n", cols, rows);
+    for (int s = 0; s < sweep_count; s++) printf("sweep:      %s over %d values\n", sweeps[s].name, sweeps[s].count);
+    printf("threads:    %d, %llu steals\n", threads, (unsigned long long)ensemble->steals);
+    printf("memory:     %.2f MB in one block, %.2f ms to set up\n", ensemble->block_bytes / 1e6, setup_ns / 1e6);
+    printf("ticks:      %llu (%.0f per world, at most %d)\n", (unsigned long long)ticks, (double)ticks / count, steps);
+    if (settled_count) {
+        printf("settled:    %d of %d, median tick %lld, last %lld\n", settled_count, count,
+               (long long)settled[settled_count / 2], (long long)settled[settled_count - 1]);
+    } else {
+        printf("settled:    0 of %d\n", count);
+    }
+    printf("wall time:  %.1f ms, cores %.0f%% busy\n", total / 1e6, 100.0 * busy_ns / ((double)total * threads));
+    printf("ticks/sec:  %.1f\n", ticks / seconds);
+    printf("Mcells/sec: %.1f\n", (double)rows * cols * ticks / seconds / 1e6);
+
+    FILE *out = fopen(csv_path, "w");
+    bool ok = out && ensemble_write_csv(ensemble, out);
+    if (out && fclose(out) != 0) ok = false;
+    if (ok) {
+        printf("csv:        %s\n", csv_path);
+    } else {
+        fprintf(stderr, "Failed to write %s\n", csv_path);
+    }
+
+    ensemble_destroy(ensemble);
+    free(settled);
+    return ok ? 0 : 1;
+}
+
+// Water in a rock U-tube, one arm filled far higher than the other, has
+// to end up level whether or not the sweep tracks active chunks. At this
+// width the arms settle between levelling moves, so a connecting run that
+// is let fall asleep leaves them stuck apart.
+#define UTUBE_COLS 48
+#define UTUBE_ROWS 128
+#define UTUBE_TICKS 600
+
+// Top water row in column x, or rows if there is none
+static int water_surface(const World *world, int x) {
+    for (int y = 0; y < world->rows; y++) {
+        if (world->grid.type[world_index(world, x, y)] == WATER) return y;
+    }
+    return world->rows;
+}
+
+static bool check_utube(unsigned int seed, bool full_sweep) {
+    World *world = world_create(UTUBE_ROWS, UTUBE_COLS, seed);
+    if (!world) return false;
+    world->chunking = !full_sweep;
+    int temperature = AMBIENT_TEMPERATURE;
+    int mid = UTUBE_COLS / 2;
+    int right = UTUBE_COLS - 1;
+    // Frame and divider form one rock body standing on the bottom beam
+    for (int y = 0; y < UTUBE_ROWS; y++) {
+        world_fill_span(world, y, 0, 3, ROCK, temperature);
+        world_fill_span(world, y, right - 3, right, ROCK, temperature);
+        if (y < 4 || y >= 120) world_fill_span(world, y, 4, right - 4, ROCK, temperature);
+        else if (y < 100) world_fill_span(world, y, mid - 4, mid + 3, ROCK, temperature);
+    }
+    for (int y = 15; y < 120; y++) world_fill_span(world, y, 4, mid - 5, WATER, temperature);
+    for (int y = 100; y < 120; y++) world_fill_span(world, y, mid + 4, right - 4, WATER, temperature);
+
+    for (int i = 0; i < UTUBE_TICKS; i++) world_step(world);
+    int left_top = water_surface(world, mid / 2);
+    int right_top = water_surface(world, mid + mid / 2);
+    bool level = abs(left_top - right_top) <= 1;
+    printf("u-tube:     surfaces at rows %d and %d after %d ticks, %s (%s)\n", left_top, right_top, UTUBE_TICKS,
+           level ? "level" : "NOT LEVEL", full_sweep ? "full sweep" : "chunked");
+    world_destroy(world);
+    return level;
+}
+
+// Mass is what the strips must not lose: every cell that is not empty
+static uint64_t count_filled(const World *world) {
+    uint64_t filled = 0;
+    for (int y = 0; y < world->rows; y++) {
+        const uint8_t *row = &world->grid.type[world_index(world, 0, y)];
+        for (int x = 0; x < world->cols; x++) filled += row[x] != NONE;
+    }
+    return filled;
+}
+
+// The same run as 1, 2, 4 ... `max_processes` strip processes
+static int run_strips(int rows, int cols, unsigned int seed, int steps, int scenario, int max_processes,
+                      bool full_sweep, bool levelling) {
+    StripStats *stats = (StripStats *)malloc(max_processes * sizeof(StripStats));
+    if (!stats) return 1;
+
+    printf("scenario:   %s\n", scenario_name(scenario));
+    printf("grid:       %dx%d\n", cols, rows);
+    printf("seed:       %u\n", seed);
+    printf("steps:      %d\n", steps);
+    printf("cores:      %ld\n", sysconf(_SC_NPROCESSORS_ONLN));
+    printf("\n%5s %9s %10s %8s %9s %8s %9s %8s %5s %11s %16s\n", "procs", "wall ms", "steps/sec", "speedup",
+           "exchange", "claims", "granted", "returned", "lost", "filled", "checksum");
+
+    bool ok = true;
+    double base_ns = 0;
+    for (int p = 1; ok; p = p * 2 < max_processes ? p * 2 : max_processes) {
+        World *world = world_create(rows, cols, seed);
+        if (!world) {
+            ok = false;
+            break;
+        }
+        world->chunking = !full_sweep;
+        world->levelling = levelling;
+        world_load_scenario(world, scenario);
+        uint64_t filled = count_filled(world);
+
+        uint64_t t0 = now_ns();
+        ok = strips_run(world, p, steps, stats);
+        uint64_t total = now_ns() - t0;
+        if (ok) {
+            StripStats sum = { 0 };
+            for (int s = 0; s < p; s++) {
+                sum.step_ns += stats[s].step_ns;
+                sum.exchange_ns += stats[s].exchange_ns;
+                sum.claims += stats[s].claims;
+                sum.granted += stats[s].granted;
+                sum.returned += stats[s].returned;
+                sum.lost += stats[s].lost;
+            }
+            if (p == 1) base_ns = (double)total;
+            uint64_t after = count_filled(world);
+            printf("%5d %9.1f %10.1f %7.2fx %8.1f%% %8llu %9llu %8llu %5llu %+11lld %016llx\n", p, total / 1e6,
+                   steps / (total / 1e9), base_ns / total,
+                   100.0 * sum.exchange_ns / (double)(sum.step_ns + sum.exchange_ns),
+                   (unsigned long long)sum.claims, (unsigned long long)sum.granted,
+                   (unsigned long long)sum.returned, (unsigned long long)sum.lost,
+                   (long long)after - (long long)filled, (unsigned long long)world_checksum(world));
+        }
+        world_destroy(world);
+        if (p == max_processes) break;
+    }
+    printf("\nexchange is the share of strip time spent on halos and claims; filled is the change in\n"
+           "non-empty cells, 0 unless fire or boiling destroyed some\n");
+    free(stats);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    int cols = 200;
+    int rows = 145;
+    unsigned int seed = 1;
+    int steps = 1000;
+    int scenario = SCENARIO_MIXED;
+    bool full_sweep = false;
+    int threads = 0;
+    bool threads_set = false;
+    const char *replay_path = NULL;
+    const char *profile_name = NULL;
+    const char *stream_name = NULL;
+    int thermal_isa = -1;
+    bool levelling = true;
+    const char *isa_name = NULL;
+    bool life = false;
+    int jump_log = -1;
+    int pan = 0;
+    const char *save_path = NULL;
+    LifeRule life_rule;
+    int replicas = 0;
+    int processes = 0;
+    Sweep sweeps[MAX_SWEEPS];
+    int sweep_count = 0;
+    const char *csv_path = "ensemble.csv";
+    bool utube = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:r:s:n:S:Ft:H:WP:A:L:J:R:T:O:E:X:C:D:Uh")) != -1) {
+        switch (opt) {
+            case 'c': cols = atoi(optarg); break;
+            case 'r': rows = atoi(optarg); break;
+            case 's': seed = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'n': steps = atoi(optarg); break;
+            case 'S':
+                scenario = scenario_from_name(optarg);
+                if (scenario < 0) {
+                    fprintf(stderr, "unknown scenario '%s'\n", optarg);
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'F': full_sweep = true; break;
+            case 'W': levelling = false; break;
+            case 't':
+                threads = atoi(optarg);
+                threads_set = true;
+                break;
+            case 'R': replay_path = optarg; break;
+            case 'T': profile_name = optarg; break;
+            case 'O': stream_name = optarg; break;
+            case 'L':
+                if (!life_parse_rule(optarg, &life_rule)) {
+                    fprintf(stderr, "bad rule '%s', expected e.g. B3/S23\n", optarg);
+                    return 1;
+                }
+                life = true;
+                break;
+            case 'H': isa_name = optarg; break;
+            case 'J': jump_log = atoi(optarg); break;
+            case 'P': pan = atoi(optarg); break;
+            case 'A': save_path = optarg; break;
+            case 'E': replicas = atoi(optarg); break;
+            case 'C': csv_path = optarg; break;
+            case 'D': processes = atoi(optarg); break;
+            case 'U': utube = true; break;
+            case 'X':
+                if (sweep_count == MAX_SWEEPS || !parse_sweep(optarg, &sweeps[sweep_count])) {
+                    fprintf(stderr, "bad sweep '%s', expected e.g. fire_decay=2,5,10 (at most %d sweeps)\n",
+                            optarg, MAX_SWEEPS);
+                    return 1;
+                }
+                sweep_count++;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (cols <= 0 || rows <= 0 || steps <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (utube) {
+        bool chunked = check_utube(seed, false);
+        bool full = check_utube(seed, true);
+        return chunked && full ? 0 : 1;
+    }
+    if (replay_path) return run_replay(replay_path, threads_set ? threads : -1);
+    if (life && jump_log >= 0) return run_hashlife(rows, cols, seed, steps, life_rule, jump_log);
+    if (life) return run_life(rows, cols, seed, steps, life_rule, isa_name);
+    if (processes > 0) return run_strips(rows, cols, seed, steps, scenario, processes, full_sweep, levelling);
+    if (replicas > 0) {
+        return run_ensemble(rows, cols, seed, steps, scenario, replicas, threads, levelling, sweeps, sweep_count,
+                            csv_path);
+    }
+
+    if (isa_name) {
+        for (int i = 0; i < THERMAL_ISA_COUNT; i++) {
+            if (strcmp(isa_name, thermal_isa_name(i)) == 0) thermal_isa = i;
+        }
+        if (thermal_isa < 0) {
+            fprintf(stderr, "unknown thermal kernel '%s'\n", isa_name);
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Panning and saving need a window of whole sectors
+    SectorMap *sectors = NULL;
+    if (pan > 0 || save_path) {
+        cols = (cols + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+        rows = (rows + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+        sectors = sector_map_create(cols / SECTOR_SIZE, rows / SECTOR_SIZE, NULL);
+        if (!sectors) return 1;
+        if (pan > 0) sectors->page_after = (uint64_t)pan;
+    }
+
+    World *world = world_create(rows, cols, seed);
+    if (!world) {
+        sector_map_destroy(sectors);
+        return 1;
+    }
+    world->chunking = !full_sweep;
+    world->levelling = levelling;
+    if (thermal_isa >= 0 && !thermal_set_isa(world, thermal_isa)) {
+        fprintf(stderr, "thermal kernel '%s' not supported on this CPU\n", thermal_isa_name(thermal_isa));
+        world_destroy(world);
+        sector_map_destroy(sectors);
+        return 1;
+    }
+    if (!world_set_threads(world, threads)) {
+        world_destroy(world);
+        sector_map_destroy(sectors);
+        return 1;
+    }
+    world_load_scenario(world, scenario);
+
+    Stream *stream = stream_name ? stream_create(stream_name, world) : NULL;
+    uint64_t *step_ns = (uint64_t *)malloc(steps * sizeof(uint64_t));
+    if ((stream_name && !stream) || !step_ns) {
+        if (!step_ns) fprintf(stderr, "Failed to allocate latency buffer\n");
+        free(step_ns);
+        stream_close(stream);
+        world_destroy(world);
+        sector_map_destroy(sectors);
+        return 1;
+    }
+
+    uint64_t awake_tiles = 0;
+    SaveJob *save_job = NULL;
+    bool saved = true;
+    uint64_t start = now_ns();
+    for (int i = 0; i < steps; i++) {
+        uint64_t t0 = now_ns();
+        if (pan > 0 && i > 0 && i % pan == 0) {
+            sector_map_move_window(sectors, world, sectors->window_sx + 1, sectors->window_sy);
+            sector_map_page_out(sectors, world->tick);
+        }
+        if (save_path && i == steps / 2) {
+            save_job = save_begin(sectors, world, save_path);
+            saved = save_job != NULL;
+        }
+        if (save_job && save_finished(save_job)) {
+            saved = save_end(sectors, save_job);
+            save_job = NULL;
+        }
+        world_step(world);
+        if (stream) stream_publish(stream, world);
+        step_ns[i] = now_ns() - t0;
+        awake_tiles += world->chunks->awake_tiles;
+    }
+    uint64_t total = now_ns() - start;
+    if (save_job) saved = save_end(sectors, save_job);
+
+    qsort(step_ns, steps, sizeof(uint64_t), compare_u64);
+    uint64_t p50 = step_ns[steps / 2];
+    uint64_t p99 = step_ns[(int)((steps - 1) * 0.99)];
+    double seconds = total / 1e9;
+    double cells = (double)rows * cols * steps;
+
+    printf("scenario:   %s\n", scenario_name(scenario));
+    printf("grid:       %dx%d\n", cols, rows);
+    printf("seed:       %u\n", seed);
+    printf("steps:      %d\n", steps);
+    printf("mode:       %s\n", threads > 0 ? "tiles" : "rows");
+    printf("threads:    %d\n", threads > 0 ? threads : 1);
+    printf("thermal:    %s\n", thermal_isa_name(world->thermal_isa));
+    printf("memory:     %.2f MB (%.1f bytes/cell)\n",
+           world_memory_bytes(world) / 1e6, (double)world_memory_bytes(world) / ((double)rows * cols));
+    printf("steps/sec:  %.1f\n", steps / seconds);
+    printf("ns/cell:    %.3f\n", total / cells);
+    printf("p50 step:   %.1f us\n", p50 / 1e3);
+    printf("p99 step:   %.1f us\n", p99 / 1e3);
+    printf("awake:      %.1f%% of %d tiles\n",
+           100.0 * awake_tiles / ((double)steps * world->chunks->tiles_x * world->chunks->tiles_y),
+           world->chunks->tiles_x * world->chunks->tiles_y);
+    if (sectors) {
+        printf("sectors:    %u stored, %u paged out, %u pool blocks\n",
+               sectors->count, sectors->paged, sectors->block_count);
+        printf("sector mem: %.2f MB, page file %.1f KB\n",
+               sector_map_memory_bytes(sectors) / 1e6, sectors->page_end / 1e3);
+    }
+    if (stream) {
+        uint64_t offered = stream_frames(stream) + stream_drops(stream);
+        printf("stream:     %llu frames, %llu dropped (%.1f%% of ticks with a reader)\n",
+               (unsigned long long)stream_frames(stream), (unsigned long long)stream_drops(stream),
+               offered ? 100.0 * stream_drops(stream) / offered : 0.0);
+    }
+    printf("checksum:   %016llx\n", (unsigned long long)world_checksum(world));
+    if (save_path) saved = saved && check_save(save_path, sectors, world);
+    if (PROFILE_ENABLED) print_profile((uint64_t)steps);
+    if (profile_name) saved = write_profile(profile_name) && saved;
+
+    free(step_ns);
+    stream_close(stream);
+    world_destroy(world);
+    sector_map_destroy(sectors);
+    return saved ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#include <math.h>
+#include "brush.h"
+
+// Narrows [*lo, *hi] to the x where lo_c <= a * x + b <= hi_c
+static void clip_linear(float a, float b, float lo_c, float hi_c, float *lo, float *hi) {
+    if (a == 0.0f) {
+        if (b < lo_c || b > hi_c) *hi = *lo - 1.0f;
+        return;
+    }
+    float x0 = (lo_c - b) / a;
+    float x1 = (hi_c - b) / a;
+    if (a < 0.0f) {
+        float temp = x0;
+        x0 = x1;
+        x1 = temp;
+    }
+    if (x0 > *lo) *lo = x0;
+    if (x1 < *hi) *hi = x1;
+}
+
+// Widens [*lo, *hi] by the chord of the circle at (cx, cy) on row y
+static void add_circle(float cx, float cy, float r2, float y, float *lo, float *hi) {
+    float h2 = r2 - (y - cy) * (y - cy);
+    if (h2 < 0.0f) return;
+    float h = sqrtf(h2);
+    if (cx - h < *lo) *lo = cx - h;
+    if (cx + h > *hi) *hi = cx + h;
+}
+
+static inline float segment_dist2(const BrushStroke *s, float len2, float px, float py) {
+    float dx = s->x1 - s->x0;
+    float dy = s->y1 - s->y0;
+    float t = len2 > 0.0f ? ((px - s->x0) * dx + (py - s->y0) * dy) / len2 : 0.0f;
+    if (t < 0.0f) t = 0.0f;
+    if (t > 1.0f) t = 1.0f;
+    float ex = px - (s->x0 + t * dx);
+    float ey = py - (s->y0 + t * dy);
+    return ex * ex + ey * ey;
+}
+
+int brush_spans(const BrushStroke *stroke, int rows, int cols, BrushSpan span, void *ctx) {
+    float r = stroke->radius;
+    float r2 = r * r;
+    float dx = stroke->x1 - stroke->x0;
+    float dy = stroke->y1 - stroke->y0;
+    float len2 = dx * dx + dy * dy;
+    float len = sqrtf(len2);
+
+    int i0 = (int)floorf(fminf(stroke->y0, stroke->y1) - r);
+    int i1 = (int)ceilf(fmaxf(stroke->y0, stroke->y1) + r);
+    if (i0 < 0) i0 = 0;
+    if (i1 > rows - 1) i1 = rows - 1;
+
+    int painted = 0;
+    for (int i = i0; i <= i1; i++) {
+        float cy = i + 0.5f;
+
+        // The capsule is convex, so a row crosses it in one interval: the
+        // union of both end caps and the slab between them
+        float lo = INFINITY;
+        float hi = -INFINITY;
+        add_circle(stroke->x0, stroke->y0, r2, cy, &lo, &hi);
+        add_circle(stroke->x1, stroke->y1, r2, cy, &lo, &hi);
+        if (len2 > 0.0f) {
+            float slab_lo = -INFINITY;
+            float slab_hi = INFINITY;
+            float oy = cy - stroke->y0;
+            // along the segment: 0 <= (p - p0) . d <= |d|^2
+            clip_linear(dx, -stroke->x0 * dx + oy * dy, 0.0f, len2, &slab_lo, &slab_hi);
+            // across it: |(p - p0) x d| <= r |d|
+            clip_linear(dy, -stroke->x0 * dy - oy * dx, -r * len, r * len, &slab_lo, &slab_hi);
+            if (slab_lo <= slab_hi) {
+                if (slab_lo < lo) lo = slab_lo;
+                if (slab_hi > hi) hi = slab_hi;
+            }
+        }
+        if (lo > hi) continue;
+
+        // Cell centres inside the interval, then trimmed with the exact
+        // squared-distance test to absorb rounding at the ends
+        int j0 = (int)ceilf(lo - 0.5f) - 1;
+        int j1 = (int)floorf(hi - 0.5f) + 1;
+        if (j0 < 0) j0 = 0;
+        if (j1 > cols - 1) j1 = cols - 1;
+        while (j0 <= j1 && segment_dist2(stroke, len2, j0 + 0.5f, cy) > r2) j0++;
+        while (j1 >= j0 && segment_dist2(stroke, len2, j1 + 0.5f, cy) > r2) j1--;
+        if (j0 > j1) continue;
+
+        span(ctx, i, j0, j1);
+        painted += j1 - j0 + 1;
+    }
+    return painted;
+}
+
+typedef struct {
+    World *world;
+    Element element;
+} WorldPaint;
+
+static void paint_span(void *ctx, int y, int x0, int x1) {
+    WorldPaint *paint = (WorldPaint *)ctx;
+    world_fill_span(paint->world, y, x0, x1, paint->element, 20);
+}
+
+int brush_paint(World *world, const BrushStroke *stroke) {
+    WorldPaint paint = { world, stroke->element };
+    return brush_spans(stroke, world->rows, world->cols, paint_span, &paint);
+}
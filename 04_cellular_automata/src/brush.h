@@ -0,0 +1,28 @@
+#ifndef BRUSH_H
+#define BRUSH_H
+
+#include "sim.h"
+
+// Brush rasteriser. A stroke is the capsule swept by a circle moving from
+// (x0, y0) to (x1, y1), in cell units, so fast drags leave no gaps. Rows are
+// solved for the span the capsule covers and filled in one go, so the cost
+// follows the painted area, never the size of the world.
+
+typedef struct {
+    float x0, y0;
+    float x1, y1;
+    float radius;
+    Element element;
+} BrushStroke;
+
+// Receives cells x0..x1 of row y
+typedef void (*BrushSpan)(void *ctx, int y, int x0, int x1);
+
+// Calls `span` once per row for the cells of a rows x cols grid whose centre
+// lies within `radius` of the segment, and returns how many cells that was
+int brush_spans(const BrushStroke *stroke, int rows, int cols, BrushSpan span, void *ctx);
+
+// Paints those cells of the world with the stroke's element
+int brush_paint(World *world, const BrushStroke *stroke);
+
+#endif
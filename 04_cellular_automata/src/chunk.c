@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "chunk.h"
+
+static const DirtyRect empty_rect = { 1, 1, 0, 0 };
+
+ChunkMap *chunks_create(int rows, int cols) {
+    ChunkMap *map = (ChunkMap *)calloc(1, sizeof(ChunkMap));
+    if (!map) return NULL;
+
+    map->rows = rows;
+    map->cols = cols;
+    map->tiles_x = (cols + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    map->tiles_y = (rows + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    int count = map->tiles_x * map->tiles_y;
+    map->current = (DirtyRect *)malloc(count * sizeof(DirtyRect));
+    map->next = (DirtyRect *)malloc(count * sizeof(DirtyRect));
+    map->render_dirty = (unsigned char *)malloc(count);
+    if (!map->current || !map->next || !map->render_dirty) {
+        fprintf(stderr, "Failed to allocate chunk map\n");
+        chunks_destroy(map);
+        return NULL;
+    }
+
+    for (int t = 0; t < count; t++) {
+        map->current[t] = empty_rect;
+        map->next[t] = empty_rect;
+        map->render_dirty[t] = CHUNK_DIRTY_ALL;
+    }
+    return map;
+}
+
+void chunks_destroy(ChunkMap *map) {
+    if (!map) return;
+    free(map->current);
+    free(map->next);
+    free(map->render_dirty);
+    free(map);
+}
+
+static inline void grow_rect(DirtyRect *rect, int x0, int y0, int x1, int y1) {
+    if (rect_empty(rect)) {
+        *rect = (DirtyRect){ x0, y0, x1, y1 };
+        return;
+    }
+    if (x0 < rect->x0) rect->x0 = x0;
+    if (y0 < rect->y0) rect->y0 = y0;
+    if (x1 > rect->x1) rect->x1 = x1;
+    if (y1 > rect->y1) rect->y1 = y1;
+}
+
+// Splits a rect along tile boundaries and grows every tile it covers, either
+// in the shared map or, for tiles other than the outbox's home, in the outbox.
+static void mark_rect(ChunkMap *map, ChunkOutbox *box, int x0, int y0, int x1, int y1) {
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= map->cols) x1 = map->cols - 1;
+    if (y1 >= map->rows) y1 = map->rows - 1;
+    if (x1 < x0 || y1 < y0) return;
+
+    for (int ty = y0 / CHUNK_SIZE; ty <= y1 / CHUNK_SIZE; ty++) {
+        int tile_y0 = ty * CHUNK_SIZE;
+        int tile_y1 = tile_y0 + CHUNK_SIZE - 1;
+        int ry0 = y0 > tile_y0 ? y0 : tile_y0;
+        int ry1 = y1 < tile_y1 ? y1 : tile_y1;
+
+        for (int tx = x0 / CHUNK_SIZE; tx <= x1 / CHUNK_SIZE; tx++) {
+            int tile_x0 = tx * CHUNK_SIZE;
+            int tile_x1 = tile_x0 + CHUNK_SIZE - 1;
+            int rx0 = x0 > tile_x0 ? x0 : tile_x0;
+            int rx1 = x1 < tile_x1 ? x1 : tile_x1;
+
+            int t = ty * map->tiles_x + tx;
+            if (box && t != box->home) {
+                int slot = (ty - box->home_ty + 1) * 3 + (tx - box->home_tx + 1);
+                grow_rect(&box->current[slot], rx0, ry0, rx1, ry1);
+                grow_rect(&box->next[slot], rx0, ry0, rx1, ry1);
+            } else {
+                grow_rect(&map->current[t], rx0, ry0, rx1, ry1);
+                grow_rect(&map->next[t], rx0, ry0, rx1, ry1);
+                map->render_dirty[t] = CHUNK_DIRTY_ALL;
+            }
+        }
+    }
+}
+
+void chunks_mark_rect(ChunkMap *map, int x0, int y0, int x1, int y1) {
+    mark_rect(map, NULL, x0, y0, x1, y1);
+}
+
+void chunks_mark(ChunkMap *map, int x, int y) {
+    chunks_mark_rect(map, x - 1, y - 1, x + 1, y + 1);
+}
+
+void chunks_mark_all(ChunkMap *map) {
+    chunks_mark_rect(map, 0, 0, map->cols - 1, map->rows - 1);
+}
+
+void chunks_outbox_reset(ChunkOutbox *box, const ChunkMap *map, int tile) {
+    box->home = tile;
+    box->home_tx = tile % map->tiles_x;
+    box->home_ty = tile / map->tiles_x;
+    for (int k = 0; k < 9; k++) {
+        box->current[k] = empty_rect;
+        box->next[k] = empty_rect;
+    }
+}
+
+void chunks_mark_local(ChunkMap *map, ChunkOutbox *box, int x, int y) {
+    mark_rect(map, box, x - 1, y - 1, x + 1, y + 1);
+}
+
+void chunks_flush_outbox(ChunkMap *map, const ChunkOutbox *box) {
+    for (int k = 0; k < 9; k++) {
+        int tx = box->home_tx + k % 3 - 1;
+        int ty = box->home_ty + k / 3 - 1;
+        if (tx < 0 || ty < 0 || tx >= map->tiles_x || ty >= map->tiles_y) continue;
+
+        int t = ty * map->tiles_x + tx;
+        const DirtyRect *cur = &box->current[k];
+        const DirtyRect *nxt = &box->next[k];
+        if (!rect_empty(cur)) grow_rect(&map->current[t], cur->x0, cur->y0, cur->x1, cur->y1);
+        if (!rect_empty(nxt)) {
+            grow_rect(&map->next[t], nxt->x0, nxt->y0, nxt->x1, nxt->y1);
+            map->render_dirty[t] = CHUNK_DIRTY_ALL;
+        }
+    }
+}
+
+DirtyRect *chunks_sweep_rect(ChunkMap *map, ChunkOutbox *box, int tile) {
+    if (!box || tile == box->home) return &map->current[tile];
+    int tx = tile % map->tiles_x;
+    int ty = tile / map->tiles_x;
+    return &box->current[(ty - box->home_ty + 1) * 3 + (tx - box->home_tx + 1)];
+}
+
+void chunks_begin_tick(ChunkMap *map, bool wake_all) {
+    DirtyRect *temp = map->current;
+    map->current = map->next;
+    map->next = temp;
+
+    int count = map->tiles_x * map->tiles_y;
+    map->awake_tiles = 0;
+    for (int t = 0; t < count; t++) {
+        map->next[t] = empty_rect;
+        if (wake_all) {
+            int tx = t % map->tiles_x;
+            int ty = t / map->tiles_x;
+            int x1 = (tx + 1) * CHUNK_SIZE - 1;
+            int y1 = (ty + 1) * CHUNK_SIZE - 1;
+            map->current[t] = (DirtyRect){
+                tx * CHUNK_SIZE, ty * CHUNK_SIZE,
+                x1 < map->cols ? x1 : map->cols - 1,
+                y1 < map->rows ? y1 : map->rows - 1
+            };
+        }
+        if (!rect_empty(&map->current[t])) map->awake_tiles++;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <stdbool.h>
+
+// Active-region tracking. The grid is split into CHUNK_SIZE x CHUNK_SIZE
+// tiles and every tile keeps an inclusive dirty rectangle in grid
+// coordinates. A tile whose rectangle is empty is asleep: update_grid
+// neither copies nor visits it.
+
+#define CHUNK_SIZE 32
+
+typedef struct DirtyRect {
+    int x0, y0;
+    int x1, y1;  // inclusive, x1 < x0 means empty
+} DirtyRect;
+
+typedef struct ChunkMap {
+    int rows;
+    int cols;
+    int tiles_x;
+    int tiles_y;
+    DirtyRect *current;  // what this tick visits, grows while the tick runs
+    DirtyRect *next;     // collected for the following tick
+    int awake_tiles;     // tiles with a non-empty rect at the start of the tick
+    unsigned char *render_dirty;  // CHUNK_DIRTY_* bits, all set by every mark
+} ChunkMap;
+
+// Readers of render_dirty, each clears its own bit once it has the tile
+#define CHUNK_DIRTY_RENDER 0x01  // runner snapshots
+#define CHUNK_DIRTY_STREAM 0x02  // shared-memory frame stream (stream.h)
+#define CHUNK_DIRTY_ALL    0xFF
+
+ChunkMap *chunks_create(int rows, int cols);
+void chunks_destroy(ChunkMap *map);
+
+// Marks made by one tile while the other tiles of its checkerboard phase run
+// concurrently. The tile's own rect is grown directly since nobody else
+// touches it during the phase; marks spilling into the 8 surrounding tiles
+// are parked here and merged by chunks_flush_outbox once the phase is over.
+typedef struct ChunkOutbox {
+    int home;
+    int home_tx;
+    int home_ty;
+    DirtyRect current[9];
+    DirtyRect next[9];
+} ChunkOutbox;
+
+// Marks the 3x3 neighbourhood around a changed cell. The mark lands in both
+// the current and the next tick so cells the sweep has not reached yet react
+// in the same tick, exactly like a full sweep would.
+void chunks_mark(ChunkMap *map, int x, int y);
+void chunks_mark_rect(ChunkMap *map, int x0, int y0, int x1, int y1);
+void chunks_mark_all(ChunkMap *map);
+
+void chunks_outbox_reset(ChunkOutbox *box, const ChunkMap *map, int tile);
+void chunks_mark_local(ChunkMap *map, ChunkOutbox *box, int x, int y);
+void chunks_flush_outbox(ChunkMap *map, const ChunkOutbox *box);
+// The rect a mark landing in `tile` grows right now: the tile's own, or with
+// an outbox and a tile other than its home, the outbox's copy
+DirtyRect *chunks_sweep_rect(ChunkMap *map, ChunkOutbox *box, int tile);
+
+// Promotes the rects collected so far to `current` and starts a fresh `next`.
+// With wake_all every tile is visited in full.
+void chunks_begin_tick(ChunkMap *map, bool wake_all);
+
+static inline bool rect_empty(const DirtyRect *rect) {
+    return rect->x1 < rect->x0;
+}
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef ELEMENTS_H
+#define ELEMENTS_H
+
+#include <stdint.h>
+
+// Element rule table. Everything that differs between elements lives in one
+// row here; the Element enum, the per-element kernels (sim.c), the thermal
+// coefficients (thermal.c) and the colour LUT (render.c) are all expanded
+// from it. Adding an element means adding a row, plus a movement class in
+// sim.c if none of the existing ones fits.
+//
+// density     displacement order; powders sink into lighter liquids
+// move        movement class, picks the kernel: inert, powder, liquid,
+//             solid or fire
+// burn_point  above this, neighbouring fire destroys the cell ...
+// burn_pct    ... with this chance per tick and fire neighbour (0 = never)
+// melt_point  above this the cell turns into FIRE (0 = never)
+// boil_point  from this temperature on the cell evaporates (0 = never)
+// conduct     thermal conductivity, Q8 (thermal.c)
+// cool        pull towards ambient, Q8 (thermal.c)
+// r, g, b     base colour
+// glow_point  above this the colour reddens with temperature (0 = never)
+//
+// WALL has to stay last: it is the sentinel border and bounds the tables.
+//
+//  name    density move    burn_point burn_pct melt boil conduct cool  r    g    b  glow_point
+#define ELEMENT_TABLE(X) \
+    X(NONE,     0, inert,     0,  0,   0,   0, 16, 6, 255, 255, 255,   0) \
+    X(SAND,  1600, powder,  800, 10,   0,   0, 24, 1, 211, 176, 131, 400) \
+    X(WATER, 1000, liquid,    0,  0,   0, 100, 48, 2,   0, 121, 241,   0) \
+    X(ROCK,  2600, solid,     0,  0, 900,   0, 32, 1, 130, 130, 130, 600) \
+    X(FIRE,     0, fire,      0,  0,   0,   0,  0, 0, 230,  41,  55,   0) \
+    X(WALL,     0, inert,     0,  0,   0,   0,  0, 0, 200, 122, 255,   0)
+
+#define ELEMENT_ENUM(name, ...) name,
+typedef enum {
+    ELEMENT_TABLE(ELEMENT_ENUM)
+    ELEMENT_COUNT
+} Element;
+#undef ELEMENT_ENUM
+
+typedef enum {
+    MOVE_INERT,     // never updated (empty space, border)
+    MOVE_POWDER,    // falls, slides diagonally, sinks through lighter liquids
+    MOVE_LIQUID,    // falls, slides and spreads sideways into empty cells
+    MOVE_SOLID,     // falls straight down only when nothing holds it up
+    MOVE_FIRE       // rises, decays, ignites and is put out by neighbours
+} MoveClass;
+
+// Table columns use the lower-case class name so sim.c can paste it onto
+// kernel names; these map it back to the enum.
+#define MOVE_CLASS_inert  MOVE_INERT
+#define MOVE_CLASS_powder MOVE_POWDER
+#define MOVE_CLASS_liquid MOVE_LIQUID
+#define MOVE_CLASS_solid  MOVE_SOLID
+#define MOVE_CLASS_fire   MOVE_FIRE
+
+typedef struct {
+    const char *name;
+    int density;
+    MoveClass move;
+    int burn_point;
+    int burn_pct;
+    int melt_point;
+    int boil_point;
+    uint8_t conduct_q8;
+    uint8_t cool_q8;
+    uint8_t r, g, b;
+    int glow_point;
+} ElementInfo;
+
+// Indexed by Element. Static so that lookups with a constant element fold
+// away in the specialised kernels.
+#define ELEMENT_INFO(name, density, move, burn_point, burn_pct, melt_point, boil_point, \
+                     conduct, cool, r, g, b, glow_point) \
+    [name] = { #name, density, MOVE_CLASS_##move, burn_point, burn_pct, melt_point, boil_point, \
+               conduct, cool, r, g, b, glow_point },
+static const ElementInfo element_info[ELEMENT_COUNT] = {
+    ELEMENT_TABLE(ELEMENT_INFO)
+};
+#undef ELEMENT_INFO
+
+#endif
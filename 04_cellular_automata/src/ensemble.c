@@ -0,0 +1,254 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ensemble.h"
+#include "chunk.h"
+#include "pool.h"
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~    STORAGE    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Ensemble *ensemble_create(int rows, int cols, int count, const EnsembleMember *members) {
+    Ensemble *ensemble = (Ensemble *)calloc(1, sizeof(Ensemble));
+    if (!ensemble) return NULL;
+    ensemble->rows = rows;
+    ensemble->cols = cols;
+    ensemble->count = count;
+
+    // One extra cache line so the first world can start aligned
+    size_t world_bytes = world_block_bytes(rows, cols);
+    ensemble->block_bytes = world_bytes * count + 63;
+    ensemble->block = malloc(ensemble->block_bytes);
+    ensemble->worlds = (World **)calloc(count, sizeof(World *));
+    ensemble->members = (EnsembleMember *)malloc(count * sizeof(EnsembleMember));
+    ensemble->results = (EnsembleResult *)calloc(count, sizeof(EnsembleResult));
+    if (!ensemble->block || !ensemble->worlds || !ensemble->members || !ensemble->results) {
+        fprintf(stderr, "Failed to allocate an ensemble of %d %dx%d worlds (%.1f MB)\n", count, cols, rows,
+                ensemble->block_bytes / 1e6);
+        ensemble_destroy(ensemble);
+        return NULL;
+    }
+    memcpy(ensemble->members, members, count * sizeof(EnsembleMember));
+
+    uint8_t *base = (uint8_t *)(((uintptr_t)ensemble->block + 63) & ~(uintptr_t)63);
+    for (int i = 0; i < count; i++) {
+        World *world = world_create_in(base + (size_t)i * world_bytes, rows, cols, members[i].seed);
+        if (!world) {
+            ensemble_destroy(ensemble);
+            return NULL;
+        }
+        ensemble->worlds[i] = world;
+        world->params = members[i].params;
+        world_load_scenario(world, members[i].scenario);
+    }
+    return ensemble;
+}
+
+void ensemble_destroy(Ensemble *ensemble) {
+    if (!ensemble) return;
+    for (int i = 0; ensemble->worlds && i < ensemble->count; i++) world_destroy(ensemble->worlds[i]);
+    free(ensemble->worlds);
+    free(ensemble->members);
+    free(ensemble->results);
+    free(ensemble->block);
+    free(ensemble);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~    STEALING    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// One worker's worlds, [next, end). Packed into one word so that the owner
+// taking from the front and thieves cutting off the back both claim with a
+// single compare-and-swap. A range only ever shrinks or, once empty, is
+// replaced by a stolen one holding unclaimed worlds, so a stale value can
+// never match again.
+typedef struct {
+    uint64_t range;  // atomic, next << 32 | end
+    uint64_t steals;
+    uint8_t pad[48];
+} WorkQueue;
+
+typedef struct {
+    Ensemble *ensemble;
+    WorkQueue *queues;
+    int queue_count;
+    uint64_t max_ticks;
+    int quiet_ticks;
+} EnsembleRun;
+
+static inline uint64_t pack_range(uint32_t next, uint32_t end) {
+    return (uint64_t)next << 32 | end;
+}
+
+static inline uint32_t range_left(uint64_t range) {
+    uint32_t next = (uint32_t)(range >> 32);
+    uint32_t end = (uint32_t)range;
+    return next < end ? end - next : 0;
+}
+
+static bool claim(WorkQueue *queue, int *world) {
+    uint64_t range = __atomic_load_n(&queue->range, __ATOMIC_ACQUIRE);
+    while (range_left(range)) {
+        uint32_t next = (uint32_t)(range >> 32);
+        if (__atomic_compare_exchange_n(&queue->range, &range, pack_range(next + 1, (uint32_t)range), false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *world = (int)next;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Moves the back half of the fullest other queue into this worker's empty
+// one. False once every queue is empty, which ends the run for this worker.
+static bool steal(EnsembleRun *run, int self) {
+    for (;;) {
+        int victim = -1;
+        uint64_t seen = 0;
+        uint32_t most = 0;
+        for (int q = 0; q < run->queue_count; q++) {
+            if (q == self) continue;
+            uint64_t range = __atomic_load_n(&run->queues[q].range, __ATOMIC_ACQUIRE);
+            if (range_left(range) > most) {
+                most = range_left(range);
+                seen = range;
+                victim = q;
+            }
+        }
+        if (victim < 0) return false;
+
+        uint32_t end = (uint32_t)seen;
+        uint32_t take = (most + 1) / 2;
+        if (__atomic_compare_exchange_n(&run->queues[victim].range, &seen,
+                                        pack_range((uint32_t)(seen >> 32), end - take), false,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            __atomic_store_n(&run->queues[self].range, pack_range(end - take, end), __ATOMIC_RELEASE);
+            run->queues[self].steals++;
+            return true;
+        }
+    }
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    RUNNING    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void run_world(EnsembleRun *run, int index, int worker) {
+    World *world = run->ensemble->worlds[index];
+    EnsembleResult *result = &run->ensemble->results[index];
+    int quiet = 0;
+    result->settle_tick = -1;
+    result->worker = worker;
+
+    uint64_t t0 = now_ns();
+    while (world->tick < run->max_ticks) {
+        world_step(world);
+        if (world->chunks->awake_tiles) {
+            quiet = 0;
+            result->settle_tick = -1;
+            continue;
+        }
+        if (quiet++ == 0) result->settle_tick = (int64_t)world->tick - 1;
+        if (quiet >= run->quiet_ticks) break;
+    }
+    result->elapsed_ns = now_ns() - t0;
+    result->ticks = world->tick;
+
+    memset(result->counts, 0, sizeof(result->counts));
+    for (int y = 0; y < world->rows; y++) {
+        const uint8_t *row = &world->grid.type[world_index(world, 0, y)];
+        for (int x = 0; x < world->cols; x++) result->counts[row[x]]++;
+    }
+}
+
+static void worker_task(void *arg, int slot) {
+    EnsembleRun *run = (EnsembleRun *)arg;
+    int index;
+    do {
+        while (claim(&run->queues[slot], &index)) run_world(run, index, slot);
+    } while (steal(run, slot));
+}
+
+uint64_t ensemble_run(Ensemble *ensemble, int threads, uint64_t max_ticks, int quiet_ticks) {
+    if (threads < 1) threads = 1;
+    if (threads > ensemble->count) threads = ensemble->count;
+    EnsembleRun run = { ensemble, NULL, threads, max_ticks, quiet_ticks > 0 ? quiet_ticks : 1 };
+    run.queues = (WorkQueue *)calloc(threads, sizeof(WorkQueue));
+    ThreadPool *pool = pool_create(threads);
+    if (!run.queues || !pool) {
+        fprintf(stderr, "Failed to start %d ensemble threads\n", threads);
+        free(run.queues);
+        pool_destroy(pool);
+        return 0;
+    }
+    // Even contiguous shares, so each worker starts on its own stretch of the block
+    for (int q = 0; q < threads; q++) {
+        run.queues[q].range = pack_range((uint32_t)((int64_t)ensemble->count * q / threads),
+                                         (uint32_t)((int64_t)ensemble->count * (q + 1) / threads));
+    }
+
+    uint64_t t0 = now_ns();
+    pool_run(pool, threads, worker_task, &run);
+    uint64_t elapsed = now_ns() - t0;
+
+    ensemble->steals = 0;
+    for (int q = 0; q < threads; q++) ensemble->steals += run.queues[q].steals;
+    pool_destroy(pool);
+    free(run.queues);
+    return elapsed;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~    OUTPUT    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool ensemble_write_csv(const Ensemble *ensemble, FILE *out) {
+    fprintf(out, "world,scenario,seed,fire_decay,slide_left,boil_offset,evaporation_span,"
+                 "ticks,settle_tick,ms,mcells_per_s,worker");
+    for (int e = 0; e < WALL; e++) fprintf(out, ",%s", element_info[e].name);
+    fprintf(out, "\n");
+
+    double cells = (double)ensemble->rows * ensemble->cols;
+    for (int i = 0; i < ensemble->count; i++) {
+        const EnsembleMember *m = &ensemble->members[i];
+        const EnsembleResult *r = &ensemble->results[i];
+        double seconds = r->elapsed_ns / 1e9;
+        fprintf(out, "%d,%s,%u,%d,%.3f,%d,%d,%llu,%lld,%.3f,%.2f,%d", i, scenario_name(m->scenario), m->seed,
+                m->params.fire_decay_pct, m->params.slide_left, m->params.boil_offset, m->params.evaporation_span,
+                (unsigned long long)r->ticks, (long long)r->settle_tick, r->elapsed_ns / 1e6,
+                seconds > 0 ? cells * r->ticks / seconds / 1e6 : 0.0, r->worker);
+        for (int e = 0; e < WALL; e++) fprintf(out, ",%llu", (unsigned long long)r->counts[e]);
+        fprintf(out, "\n");
+    }
+    return !ferror(out);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~    PARAMS    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static bool parse_int(const char *text, int min, int max, int *out) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end || value < min || value > max) return false;
+    *out = (int)value;
+    return true;
+}
+
+bool sim_params_set(SimParams *params, const char *name, const char *value) {
+    if (strcmp(name, "fire_decay") == 0) return parse_int(value, 0, 100, &params->fire_decay_pct);
+    if (strcmp(name, "boil_offset") == 0) {
+        return parse_int(value, -MAX_TEMPERATURE, MAX_TEMPERATURE, &params->boil_offset);
+    }
+    if (strcmp(name, "evaporation_span") == 0) {
+        return parse_int(value, 1, MAX_TEMPERATURE, &params->evaporation_span);
+    }
+    if (strcmp(name, "slide_left") == 0) {
+        char *end;
+        float chance = strtof(value, &end);
+        if (end == value || *end || chance < 0.0f || chance > 1.0f) return false;
+        params->slide_left = chance;
+        return true;
+    }
+    return false;
+}
+
+const char *sim_params_names(void) {
+    return "fire_decay slide_left boil_offset evaporation_span";
+}
@@ -0,0 +1,68 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim.h"
+
+// Many small independent worlds run side by side, for parameter sweeps.
+// Every world's struct and cell planes sit back to back in one shared block
+// (world_create_in), so a worker walking its worlds walks the bulk of their
+// memory in order. The small per-world tables (chunk rects, support queues,
+// levelling scratch) are still allocated separately by each world.
+//
+// Each world runs single-threaded in the row sweep; the parallelism is
+// across worlds. Every worker starts with an even, contiguous share of the
+// worlds and, once that is used up, steals the back half of whichever
+// worker has the most left. Worlds that settle early (fire burning out)
+// therefore do not leave cores idle while slow ones are still running.
+//
+// A world stops after max_ticks, or once nothing has changed for
+// quiet_ticks ticks in a row: no tile was awake, temperatures included.
+
+typedef struct {
+    Scenario scenario;
+    unsigned int seed;
+    SimParams params;
+} EnsembleMember;
+
+typedef struct {
+    uint64_t ticks;            // ticks run
+    int64_t settle_tick;       // ticks until it went quiet for good, -1 if it never did
+    uint64_t elapsed_ns;       // time spent stepping this world
+    uint64_t counts[ELEMENT_COUNT];  // cells of each element at the end
+    int worker;                // who ran it
+} EnsembleResult;
+
+typedef struct Ensemble {
+    int rows;
+    int cols;
+    int count;
+    void *block;          // raw allocation behind every world
+    size_t block_bytes;
+    World **worlds;
+    EnsembleMember *members;
+    EnsembleResult *results;
+    uint64_t steals;      // ranges workers took from each other in the last run
+} Ensemble;
+
+// Creates `count` rows x cols worlds, loads each member's scenario and
+// applies its parameters. Loading is sequential (the scenarios draw from
+// rand()), so member i always starts from the same grid.
+Ensemble *ensemble_create(int rows, int cols, int count, const EnsembleMember *members);
+void ensemble_destroy(Ensemble *ensemble);
+// Runs every world to max_ticks or until settled, on `threads` threads.
+// Returns the wall time in nanoseconds, 0 if the threads could not start.
+uint64_t ensemble_run(Ensemble *ensemble, int threads, uint64_t max_ticks, int quiet_ticks);
+
+// One row per world: its member, then its result
+bool ensemble_write_csv(const Ensemble *ensemble, FILE *out);
+
+// Sets the SimParams field `name` (fire_decay, slide_left, boil_offset,
+// evaporation_span) from text. False for an unknown name or a bad value.
+bool sim_params_set(SimParams *params, const char *name, const char *value);
+// The names sim_params_set accepts, space separated
+const char *sim_params_names(void);
+
+#endif
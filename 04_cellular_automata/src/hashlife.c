@@ -0,0 +1,463 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hashlife.h"
+
+#define BLOCK_BITS 16
+#define BLOCK_NODES (1u << BLOCK_BITS)
+#define INITIAL_BUCKETS (1u << 16)
+#define INITIAL_GC_THRESHOLD (1u << 22)
+#define MIN_LEVEL 3
+
+enum { NW, NE, SW, SE };
+
+// Level 0 nodes are the two cell states
+#define DEAD 0
+#define ALIVE 1
+
+static inline HashNode *node(const HashLife *hl, uint32_t id) {
+    return &hl->blocks[id >> BLOCK_BITS][id & (BLOCK_NODES - 1)];
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    ARENA    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static uint32_t alloc_node(HashLife *hl) {
+    if (hl->free_list != HASHLIFE_NIL) {
+        uint32_t id = hl->free_list;
+        hl->free_list = node(hl, id)->next;
+        return id;
+    }
+    if ((hl->allocated & (BLOCK_NODES - 1)) == 0) {
+        if (hl->block_count == hl->block_capacity) {
+            int capacity = hl->block_capacity ? hl->block_capacity * 2 : 16;
+            HashNode **blocks = (HashNode **)realloc(hl->blocks, capacity * sizeof(HashNode *));
+            if (!blocks) return HASHLIFE_NIL;
+            hl->blocks = blocks;
+            hl->block_capacity = capacity;
+        }
+        HashNode *block = (HashNode *)malloc(BLOCK_NODES * sizeof(HashNode));
+        if (!block) return HASHLIFE_NIL;
+        hl->blocks[hl->block_count++] = block;
+    }
+    return hl->allocated++;
+}
+
+static inline uint32_t hash_children(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se) {
+    uint64_t h = (((uint64_t)nw << 32) | ne) * 0x9E3779B97F4A7C15ULL;
+    h ^= (((uint64_t)sw << 32) | se) * 0xC2B2AE3D27D4EB4FULL;
+    h ^= h >> 29;
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+static void rehash(HashLife *hl, uint32_t bucket_count) {
+    uint32_t *buckets = (uint32_t *)malloc(bucket_count * sizeof(uint32_t));
+    if (!buckets) return;  // keep the old table, chains just get longer
+    memset(buckets, 0xFF, bucket_count * sizeof(uint32_t));
+    for (uint32_t b = 0; b <= hl->bucket_mask; b++) {
+        uint32_t id = hl->buckets[b];
+        while (id != HASHLIFE_NIL) {
+            HashNode *n = node(hl, id);
+            uint32_t next = n->next;
+            uint32_t slot = hash_children(n->child[NW], n->child[NE], n->child[SW], n->child[SE]) & (bucket_count - 1);
+            n->next = buckets[slot];
+            buckets[slot] = id;
+            id = next;
+        }
+    }
+    free(hl->buckets);
+    hl->buckets = buckets;
+    hl->bucket_mask = bucket_count - 1;
+}
+
+// The canonical node with these children, or HASHLIFE_NIL once memory runs
+// out. A NIL child gives NIL too, so builds pass a failure up unchecked.
+static uint32_t find_node(HashLife *hl, uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se) {
+    if (nw == HASHLIFE_NIL || ne == HASHLIFE_NIL || sw == HASHLIFE_NIL || se == HASHLIFE_NIL) return HASHLIFE_NIL;
+    uint32_t slot = hash_children(nw, ne, sw, se) & hl->bucket_mask;
+    for (uint32_t id = hl->buckets[slot]; id != HASHLIFE_NIL; id = node(hl, id)->next) {
+        HashNode *n = node(hl, id);
+        if (n->child[NW] == nw && n->child[NE] == ne && n->child[SW] == sw && n->child[SE] == se) return id;
+    }
+
+    uint32_t id = alloc_node(hl);
+    if (id == HASHLIFE_NIL) return HASHLIFE_NIL;
+    HashNode *n = node(hl, id);
+    n->child[NW] = nw;
+    n->child[NE] = ne;
+    n->child[SW] = sw;
+    n->child[SE] = se;
+    n->result = HASHLIFE_NIL;
+    n->level = (uint8_t)(node(hl, nw)->level + 1);
+    n->marked = false;
+    n->population = node(hl, nw)->population + node(hl, ne)->population +
+                    node(hl, sw)->population + node(hl, se)->population;
+    n->next = hl->buckets[slot];
+    hl->buckets[slot] = id;
+
+    if (++hl->live > hl->bucket_mask + 1) rehash(hl, (hl->bucket_mask + 1) * 2);
+    return id;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    LIFETIME    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void build_base(HashLife *hl) {
+    for (int block = 0; block < (1 << 16); block++) {
+        uint8_t out = 0;
+        for (int i = 0; i < 4; i++) {
+            int cx = 1 + (i & 1);
+            int cy = 1 + (i >> 1);
+            int count = 0;
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    if (dx || dy) count += (block >> ((cy + dy) * 4 + cx + dx)) & 1;
+                }
+            }
+            bool alive = (block >> (cy * 4 + cx)) & 1;
+            uint16_t counts = alive ? hl->rule.survive : hl->rule.birth;
+            if (counts & (1u << count)) out |= (uint8_t)(1 << i);
+        }
+        hl->base[block] = out;
+    }
+}
+
+HashLife *hashlife_create(LifeRule rule) {
+    if (rule.birth & 1) {
+        fprintf(stderr, "HashLife cannot run B0 rules\n");
+        return NULL;
+    }
+    HashLife *hl = (HashLife *)calloc(1, sizeof(HashLife));
+    if (!hl) return NULL;
+
+    hl->rule = rule;
+    hl->free_list = HASHLIFE_NIL;
+    hl->gc_threshold = INITIAL_GC_THRESHOLD;
+    hl->buckets = (uint32_t *)malloc(INITIAL_BUCKETS * sizeof(uint32_t));
+    if (!hl->buckets || alloc_node(hl) != DEAD || alloc_node(hl) != ALIVE) {
+        fprintf(stderr, "Failed to allocate HashLife\n");
+        hashlife_destroy(hl);
+        return NULL;
+    }
+    memset(hl->buckets, 0xFF, INITIAL_BUCKETS * sizeof(uint32_t));
+    hl->bucket_mask = INITIAL_BUCKETS - 1;
+    build_base(hl);
+
+    for (uint32_t id = DEAD; id <= ALIVE; id++) {
+        HashNode *cell = node(hl, id);
+        memset(cell, 0, sizeof(HashNode));
+        cell->result = HASHLIFE_NIL;
+        cell->next = HASHLIFE_NIL;
+        cell->population = id;
+    }
+    hl->empty[0] = DEAD;
+    for (int level = 1; level <= HASHLIFE_MAX_LEVEL; level++) {
+        uint32_t e = hl->empty[level - 1];
+        hl->empty[level] = find_node(hl, e, e, e, e);
+    }
+    if (hl->empty[HASHLIFE_MAX_LEVEL] == HASHLIFE_NIL) {
+        fprintf(stderr, "Failed to allocate HashLife\n");
+        hashlife_destroy(hl);
+        return NULL;
+    }
+    hashlife_clear(hl);
+    return hl;
+}
+
+void hashlife_destroy(HashLife *hl) {
+    if (!hl) return;
+    for (int i = 0; i < hl->block_count; i++) free(hl->blocks[i]);
+    free(hl->blocks);
+    free(hl->buckets);
+    free(hl);
+}
+
+void hashlife_clear(HashLife *hl) {
+    hl->root = hl->empty[MIN_LEVEL];
+    hl->level = MIN_LEVEL;
+    hl->generation = 0;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    CELLS    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Grows the root one level, keeping it centred on the origin. False, with
+// the root left alone, if memory ran out.
+static bool expand(HashLife *hl) {
+    HashNode *r = node(hl, hl->root);
+    uint32_t e = hl->empty[hl->level - 1];
+    uint32_t nw = find_node(hl, e, e, e, r->child[NW]);
+    uint32_t ne = find_node(hl, e, e, r->child[NE], e);
+    uint32_t sw = find_node(hl, e, r->child[SW], e, e);
+    uint32_t se = find_node(hl, r->child[SE], e, e, e);
+    uint32_t root = find_node(hl, nw, ne, sw, se);
+    if (root == HASHLIFE_NIL) return false;
+    hl->root = root;
+    hl->level++;
+    return true;
+}
+
+static inline bool in_root(const HashLife *hl, int64_t x, int64_t y) {
+    int64_t half = (int64_t)1 << (hl->level - 1);
+    return x >= -half && x < half && y >= -half && y < half;
+}
+
+bool hashlife_get(const HashLife *hl, int64_t x, int64_t y) {
+    if (!in_root(hl, x, y)) return false;
+    uint64_t half = (uint64_t)1 << (hl->level - 1);
+    uint64_t ux = (uint64_t)x + half;
+    uint64_t uy = (uint64_t)y + half;
+    uint32_t id = hl->root;
+    for (int level = hl->level; level > 0; level--) {
+        HashNode *n = node(hl, id);
+        if (n->population == 0) return false;
+        int shift = level - 1;
+        id = n->child[((uy >> shift) & 1) * 2 + ((ux >> shift) & 1)];
+    }
+    return id == ALIVE;
+}
+
+static uint32_t set_rec(HashLife *hl, uint32_t id, int level, uint64_t x, uint64_t y, bool alive) {
+    if (level == 0) return alive ? ALIVE : DEAD;
+    HashNode *n = node(hl, id);
+    uint32_t child[4] = { n->child[NW], n->child[NE], n->child[SW], n->child[SE] };
+    int shift = level - 1;
+    int q = (int)(((y >> shift) & 1) * 2 + ((x >> shift) & 1));
+    child[q] = set_rec(hl, child[q], level - 1, x, y, alive);
+    return find_node(hl, child[NW], child[NE], child[SW], child[SE]);
+}
+
+bool hashlife_set(HashLife *hl, int64_t x, int64_t y, bool alive) {
+    while (!in_root(hl, x, y)) {
+        if (hl->level >= HASHLIFE_MAX_LEVEL || !expand(hl)) return false;
+    }
+    uint64_t half = (uint64_t)1 << (hl->level - 1);
+    uint32_t root = set_rec(hl, hl->root, hl->level, (uint64_t)x + half, (uint64_t)y + half, alive);
+    if (root == HASHLIFE_NIL) return false;
+    hl->root = root;
+    return true;
+}
+
+// Node of 2^level cells whose top-left is grid cell (x0, y0)
+static uint32_t build_rec(HashLife *hl, const LifeGrid *grid, int level, int x0, int y0) {
+    if (x0 >= grid->cols || y0 >= grid->rows) return hl->empty[level];
+    if (level == 0) return life_get(grid, x0, y0) ? ALIVE : DEAD;
+    if (level == 6) {
+        // One word per row, skip it if all 64 rows are clear
+        bool any = false;
+        for (int y = y0; y < y0 + 64 && y < grid->rows && !any; y++) {
+            any = grid->cells[(size_t)(y + 1) * grid->stride + 1 + (x0 >> 6)] != 0;
+        }
+        if (!any) return hl->empty[level];
+    }
+    int half = 1 << (level - 1);
+    uint32_t nw = build_rec(hl, grid, level - 1, x0, y0);
+    uint32_t ne = build_rec(hl, grid, level - 1, x0 + half, y0);
+    uint32_t sw = build_rec(hl, grid, level - 1, x0, y0 + half);
+    uint32_t se = build_rec(hl, grid, level - 1, x0 + half, y0 + half);
+    return find_node(hl, nw, ne, sw, se);
+}
+
+bool hashlife_load_grid(HashLife *hl, const LifeGrid *grid) {
+    hashlife_clear(hl);
+    int level = MIN_LEVEL - 1;
+    while ((1 << level) < grid->cols || (1 << level) < grid->rows) level++;
+
+    // The grid becomes the SE quadrant, whose top-left is the origin
+    uint32_t e = hl->empty[level];
+    uint32_t root = find_node(hl, e, e, e, build_rec(hl, grid, level, 0, 0));
+    if (root == HASHLIFE_NIL) return false;
+    hl->root = root;
+    hl->level = level + 1;
+    return true;
+}
+
+static void store_rec(const HashLife *hl, LifeGrid *grid, uint32_t id, int level, int64_t x, int64_t y) {
+    HashNode *n = node(hl, id);
+    if (n->population == 0) return;
+    int64_t size = (int64_t)1 << level;
+    if (x + size <= 0 || y + size <= 0 || x >= grid->cols || y >= grid->rows) return;
+    if (level == 0) {
+        life_set(grid, (int)x, (int)y, true);
+        return;
+    }
+    int64_t half = size / 2;
+    store_rec(hl, grid, n->child[NW], level - 1, x, y);
+    store_rec(hl, grid, n->child[NE], level - 1, x + half, y);
+    store_rec(hl, grid, n->child[SW], level - 1, x, y + half);
+    store_rec(hl, grid, n->child[SE], level - 1, x + half, y + half);
+}
+
+void hashlife_store_grid(const HashLife *hl, LifeGrid *grid, int64_t x0, int64_t y0) {
+    memset(grid->cells, 0, (size_t)(grid->rows + 2) * grid->stride * sizeof(uint64_t));
+    int64_t half = (int64_t)1 << (hl->level - 1);
+    store_rec(hl, grid, hl->root, hl->level, -half - x0, -half - y0);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    RESULT    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static uint32_t centre(HashLife *hl, uint32_t id) {
+    if (id == HASHLIFE_NIL) return HASHLIFE_NIL;
+    HashNode *n = node(hl, id);
+    return find_node(hl, node(hl, n->child[NW])->child[SE], node(hl, n->child[NE])->child[SW],
+                         node(hl, n->child[SW])->child[NE], node(hl, n->child[SE])->child[NW]);
+}
+
+// Node straddling the shared edge of horizontal neighbours w and e
+static uint32_t straddle_x(HashLife *hl, uint32_t w, uint32_t e) {
+    HashNode *a = node(hl, w);
+    HashNode *b = node(hl, e);
+    return find_node(hl, a->child[NE], b->child[NW], a->child[SE], b->child[SW]);
+}
+
+// Node straddling the shared edge of vertical neighbours n and s
+static uint32_t straddle_y(HashLife *hl, uint32_t n, uint32_t s) {
+    HashNode *a = node(hl, n);
+    HashNode *b = node(hl, s);
+    return find_node(hl, a->child[SW], a->child[SE], b->child[NW], b->child[NE]);
+}
+
+static uint32_t base_result(HashLife *hl, HashNode *n) {
+    unsigned block = 0;
+    for (int q = 0; q < 4; q++) {
+        HashNode *quad = node(hl, n->child[q]);
+        for (int s = 0; s < 4; s++) {
+            int x = (q & 1) * 2 + (s & 1);
+            int y = (q >> 1) * 2 + (s >> 1);
+            block |= quad->child[s] << (y * 4 + x);
+        }
+    }
+    uint8_t out = hl->base[block];
+    return find_node(hl, out & 1, (out >> 1) & 1, (out >> 2) & 1, (out >> 3) & 1);
+}
+
+// Centre half of a level >= 2 node, 2^min(level - 2, step_log) generations on.
+// Nine overlapping sub-squares are advanced (or, when the step is shorter
+// than this level allows, just cropped) and regrouped into four, whose
+// results tile the centre. HASHLIFE_NIL in or out of memory gives NIL,
+// which also leaves the node without a memoised result.
+static uint32_t result(HashLife *hl, uint32_t id) {
+    if (id == HASHLIFE_NIL) return HASHLIFE_NIL;
+    HashNode *n = node(hl, id);
+    if (n->result != HASHLIFE_NIL) return n->result;
+    if (n->population == 0) return hl->empty[n->level - 1];
+    if (n->level == 2) return n->result = base_result(hl, n);
+
+    uint32_t sub[9] = {
+        n->child[NW],
+        straddle_x(hl, n->child[NW], n->child[NE]),
+        n->child[NE],
+        straddle_y(hl, n->child[NW], n->child[SW]),
+        centre(hl, id),
+        straddle_y(hl, n->child[NE], n->child[SE]),
+        n->child[SW],
+        straddle_x(hl, n->child[SW], n->child[SE]),
+        n->child[SE],
+    };
+    bool full_speed = hl->step_log >= n->level - 2;
+    for (int i = 0; i < 9; i++) {
+        sub[i] = full_speed ? result(hl, sub[i]) : centre(hl, sub[i]);
+    }
+
+    uint32_t nw = result(hl, find_node(hl, sub[0], sub[1], sub[3], sub[4]));
+    uint32_t ne = result(hl, find_node(hl, sub[1], sub[2], sub[4], sub[5]));
+    uint32_t sw = result(hl, find_node(hl, sub[3], sub[4], sub[6], sub[7]));
+    uint32_t se = result(hl, find_node(hl, sub[4], sub[5], sub[7], sub[8]));
+    uint32_t out = find_node(hl, nw, ne, sw, se);
+    node(hl, id)->result = out;
+    return out;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    JUMP    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// True if everything lives in the root's central half
+static bool border_empty(const HashLife *hl) {
+    HashNode *r = node(hl, hl->root);
+    for (int q = 0; q < 4; q++) {
+        HashNode *quad = node(hl, r->child[q]);
+        for (int s = 0; s < 4; s++) {
+            if (s != 3 - q && node(hl, quad->child[s])->population) return false;
+        }
+    }
+    return true;
+}
+
+static void forget_results(HashLife *hl) {
+    for (uint32_t id = 0; id < hl->allocated; id++) node(hl, id)->result = HASHLIFE_NIL;
+}
+
+bool hashlife_jump(HashLife *hl, int k) {
+    if (k < 0 || k > HASHLIFE_MAX_LEVEL - 3) return false;
+    if (hl->live > hl->gc_threshold) {
+        hashlife_gc(hl);
+        // Still mostly live: let it grow instead of collecting every jump
+        if (hl->live > hl->gc_threshold / 2) hl->gc_threshold *= 2;
+    }
+    if (k != hl->step_log) {
+        forget_results(hl);
+        hl->step_log = k;
+    }
+
+    // Cells travel at most one cell per generation, so a pattern in the
+    // central quarter still fits the centre half after 2^k <= 2^(level-3)
+    // Expanding keeps the pattern, so a failure past this point leaves the
+    // universe as it was, only held in a larger root
+    while (hl->level < k + 2 || !border_empty(hl)) {
+        if (hl->level >= HASHLIFE_MAX_LEVEL - 1 || !expand(hl)) return false;
+    }
+    if (!expand(hl)) return false;
+
+    uint32_t root = result(hl, hl->root);
+    if (root == HASHLIFE_NIL) return false;
+    hl->root = root;
+    hl->level--;
+    hl->generation += (uint64_t)1 << k;
+
+    while (hl->level > MIN_LEVEL && border_empty(hl)) {
+        root = centre(hl, hl->root);
+        if (root == HASHLIFE_NIL) break;  // just stays larger than it needs
+        hl->root = root;
+        hl->level--;
+    }
+    return true;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    GC    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void mark(HashLife *hl, uint32_t id) {
+    HashNode *n = node(hl, id);
+    if (n->marked) return;
+    n->marked = true;
+    if (n->level == 0) return;
+    for (int q = 0; q < 4; q++) mark(hl, n->child[q]);
+}
+
+// Keeps what the root and the empty nodes reach. Memoised results that
+// point at collected nodes are dropped and recomputed on demand.
+void hashlife_gc(HashLife *hl) {
+    for (uint32_t id = 0; id < hl->allocated; id++) node(hl, id)->marked = false;
+    mark(hl, hl->root);
+    for (int level = 0; level <= HASHLIFE_MAX_LEVEL; level++) mark(hl, hl->empty[level]);
+
+    memset(hl->buckets, 0xFF, (hl->bucket_mask + 1) * sizeof(uint32_t));
+    hl->free_list = HASHLIFE_NIL;
+    hl->live = 0;
+    for (uint32_t id = hl->allocated; id-- > ALIVE + 1;) {
+        HashNode *n = node(hl, id);
+        if (!n->marked) {
+            n->next = hl->free_list;
+            hl->free_list = id;
+            continue;
+        }
+        uint32_t slot = hash_children(n->child[NW], n->child[NE], n->child[SW], n->child[SE]) & hl->bucket_mask;
+        n->next = hl->buckets[slot];
+        hl->buckets[slot] = id;
+        hl->live++;
+    }
+    for (uint32_t id = 0; id < hl->allocated; id++) {
+        HashNode *n = node(hl, id);
+        if (n->marked && n->result != HASHLIFE_NIL && !node(hl, n->result)->marked) {
+            n->result = HASHLIFE_NIL;
+        }
+    }
+}
+
+uint64_t hashlife_population(const HashLife *hl) {
+    return node(hl, hl->root)->population;
+}
+
+size_t hashlife_memory_bytes(const HashLife *hl) {
+    return sizeof(HashLife) + (size_t)hl->block_count * BLOCK_NODES * sizeof(HashNode) +
+           (size_t)(hl->bucket_mask + 1) * sizeof(uint32_t);
+}
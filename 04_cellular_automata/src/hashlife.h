@@ -0,0 +1,79 @@
+#ifndef HASHLIFE_H
+#define HASHLIFE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "life.h"
+
+// HashLife engine for the Life-like rules of life.h, on an unbounded plane.
+// The universe is a quadtree whose nodes are hash-consed, so identical
+// regions anywhere in space or time are one node, and every node memoises
+// its RESULT: its centre half advanced by the current step. Jumping 2^k
+// generations costs about as much as the pattern has distinct regions,
+// which for regular patterns is tiny next to cells times generations.
+//
+// Nodes live in an arena of fixed-size blocks so they never move; they are
+// referred to by 32-bit ids. Collection is mark and sweep from the root,
+// run between jumps once the live node count passes a threshold.
+//
+// Rules with B0 are rejected: their empty space would not stay empty.
+
+#define HASHLIFE_MAX_LEVEL 62  // root spans 2^62 cells, coordinates fit int64
+
+typedef struct {
+    uint32_t child[4];   // NW, NE, SW, SE; unused at level 0
+    uint32_t result;     // memoised RESULT for step_log, or HASHLIFE_NIL
+    uint32_t next;       // hash chain, or free list once collected
+    uint64_t population;
+    uint8_t level;       // node spans 2^level x 2^level cells
+    bool marked;
+} HashNode;
+
+#define HASHLIFE_NIL UINT32_MAX
+
+typedef struct {
+    LifeRule rule;
+    uint8_t base[1 << 16];  // 4x4 block -> its centre 2x2 one generation on
+
+    HashNode **blocks;
+    int block_count;
+    int block_capacity;
+    uint32_t allocated;     // ids handed out so far, live or free
+    uint32_t free_list;
+    uint32_t live;          // nodes in the hash table
+    uint32_t *buckets;
+    uint32_t bucket_mask;
+    uint32_t gc_threshold;  // collect before a jump once live passes this
+    uint32_t empty[HASHLIFE_MAX_LEVEL + 1];
+
+    uint32_t root;          // covers [-2^(level-1), 2^(level-1)) on both axes
+    int level;
+    int step_log;           // results currently memoised advance 2^step_log
+    uint64_t generation;
+} HashLife;
+
+HashLife *hashlife_create(LifeRule rule);
+void hashlife_destroy(HashLife *hl);
+// Empties the universe and resets the generation count
+void hashlife_clear(HashLife *hl);
+
+bool hashlife_get(const HashLife *hl, int64_t x, int64_t y);
+// Returns false if (x, y) is beyond the largest root or memory ran out
+bool hashlife_set(HashLife *hl, int64_t x, int64_t y, bool alive);
+
+// Replaces the universe with the grid's cells, grid (x, y) at (x, y).
+// Returns false, leaving the universe empty, if memory ran out.
+bool hashlife_load_grid(HashLife *hl, const LifeGrid *grid);
+// Fills the grid with the viewport whose top-left is (x0, y0)
+void hashlife_store_grid(const HashLife *hl, LifeGrid *grid, int64_t x0, int64_t y0);
+
+// Advances 2^k generations. Returns false if the pattern would outgrow the
+// largest root or memory ran out; the pattern is then unchanged.
+bool hashlife_jump(HashLife *hl, int k);
+void hashlife_gc(HashLife *hl);
+
+uint64_t hashlife_population(const HashLife *hl);
+size_t hashlife_memory_bytes(const HashLife *hl);
+
+#endif
@@ -0,0 +1,357 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "life.h"
+#include "rng.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LIFE_X86 1
+#include <immintrin.h>
+#endif
+
+#define LIFE_VECTOR_WORDS 4  // uint64_t per AVX2 register
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    RULES    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool life_parse_rule(const char *text, LifeRule *rule) {
+    LifeRule parsed = { 0, 0 };
+    bool seen_birth = false;
+    bool seen_survive = false;
+    const char *p = text;
+
+    while (*p) {
+        uint16_t *counts;
+        if ((*p == 'B' || *p == 'b') && !seen_birth) {
+            counts = &parsed.birth;
+            seen_birth = true;
+        } else if ((*p == 'S' || *p == 's') && !seen_survive) {
+            counts = &parsed.survive;
+            seen_survive = true;
+        } else {
+            return false;
+        }
+        for (p++; *p >= '0' && *p <= '8'; p++) {
+            *counts |= (uint16_t)(1u << (*p - '0'));
+        }
+        if (*p == '/') {
+            p++;
+            if (!*p) return false;
+        } else if (*p) {
+            return false;
+        }
+    }
+    if (!seen_birth) return false;
+    *rule = parsed;
+    return true;
+}
+
+void life_format_rule(LifeRule rule, char *out, size_t size) {
+    char text[24];
+    int n = 0;
+    text[n++] = 'B';
+    for (int k = 0; k <= 8; k++) {
+        if (rule.birth & (1u << k)) text[n++] = (char)('0' + k);
+    }
+    text[n++] = '/';
+    text[n++] = 'S';
+    for (int k = 0; k <= 8; k++) {
+        if (rule.survive & (1u << k)) text[n++] = (char)('0' + k);
+    }
+    text[n] = '\0';
+    snprintf(out, size, "%s", text);
+}
+
+// One neighbour count the rule reacts to. match[i] is all ones where bit i
+// of the count is set, so a lane has that count exactly when all four count
+// planes equal their match word.
+typedef struct {
+    uint64_t match[4];
+    uint64_t birth;    // all ones if a dead cell with this count is born
+    uint64_t survive;  // all ones if a live cell with this count survives
+} RuleTerm;
+
+static int rule_terms(LifeRule rule, RuleTerm terms[9]) {
+    int count = 0;
+    for (int k = 0; k <= 8; k++) {
+        bool birth = rule.birth & (1u << k);
+        bool survive = rule.survive & (1u << k);
+        if (!birth && !survive) continue;
+        RuleTerm *term = &terms[count++];
+        for (int bit = 0; bit < 4; bit++) {
+            term->match[bit] = (k >> bit) & 1 ? ~0ULL : 0;
+        }
+        term->birth = birth ? ~0ULL : 0;
+        term->survive = survive ? ~0ULL : 0;
+    }
+    return count;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    GRID    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+LifeGrid *life_create(int rows, int cols, LifeRule rule) {
+    LifeGrid *grid = (LifeGrid *)calloc(1, sizeof(LifeGrid));
+    if (!grid) return NULL;
+
+    grid->rows = rows;
+    grid->cols = cols;
+    grid->row_words = (cols + 63) / 64;
+    // Room for a whole last vector plus the dead word on either side
+    int vector_words = (grid->row_words + LIFE_VECTOR_WORDS - 1) / LIFE_VECTOR_WORDS * LIFE_VECTOR_WORDS;
+    grid->stride = vector_words + 2;
+    grid->tail_mask = (cols & 63) ? (1ULL << (cols & 63)) - 1 : ~0ULL;
+    grid->rule = rule;
+    grid->isa = life_best_isa();
+
+    size_t words = (size_t)(rows + 2) * grid->stride;
+    grid->cells = (uint64_t *)calloc(words, sizeof(uint64_t));
+    grid->next = (uint64_t *)calloc(words, sizeof(uint64_t));
+    if (!grid->cells || !grid->next) {
+        fprintf(stderr, "Failed to allocate %dx%d life grid\n", cols, rows);
+        life_destroy(grid);
+        return NULL;
+    }
+    return grid;
+}
+
+void life_destroy(LifeGrid *grid) {
+    if (!grid) return;
+    free(grid->cells);
+    free(grid->next);
+    free(grid);
+}
+
+void life_clear(LifeGrid *grid) {
+    memset(grid->cells, 0, (size_t)(grid->rows + 2) * grid->stride * sizeof(uint64_t));
+    grid->generation = 0;
+}
+
+void life_randomize(LifeGrid *grid, uint64_t seed, int percent) {
+    uint64_t key = rng_key(seed);
+    for (int y = 0; y < grid->rows; y++) {
+        for (int x = 0; x < grid->cols; x++) {
+            life_set(grid, x, y, rng_below(key, (uint32_t)(y * grid->cols + x), 0, 100) < (uint32_t)percent);
+        }
+    }
+}
+
+void life_set(LifeGrid *grid, int x, int y, bool alive) {
+    uint64_t *word = &grid->cells[(size_t)(y + 1) * grid->stride + 1 + (x >> 6)];
+    uint64_t bit = 1ULL << (x & 63);
+    *word = alive ? *word | bit : *word & ~bit;
+}
+
+void life_fill_span(LifeGrid *grid, int y, int x0, int x1, bool alive) {
+    uint64_t *row = &grid->cells[(size_t)(y + 1) * grid->stride + 1];
+    for (int w = x0 >> 6; w <= x1 >> 6; w++) {
+        int lo = w * 64 > x0 ? 0 : x0 & 63;
+        int hi = w * 64 + 63 < x1 ? 63 : x1 & 63;
+        uint64_t mask = (~0ULL >> (63 - hi)) & (~0ULL << lo);
+        row[w] = alive ? row[w] | mask : row[w] & ~mask;
+    }
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    KERNELS    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Both kernels advance one row: up/mid/down point at word 0 of the rows
+// around it, and words -1 and `count` are readable.
+//
+// Counting, per lane: the row above and the row below each add three bits
+// (west, centre, east) with a full adder into a 2-bit sum, the middle row
+// adds two with a half adder. The three low bits go through one more full
+// adder (giving bit 0 and a carry), the three high bits plus that carry
+// reduce to bit 1 and two carries, and those make bits 2 and 3.
+typedef void (*LifeRow)(const uint64_t *up, const uint64_t *mid, const uint64_t *down,
+                        uint64_t *out, int count, const RuleTerm *terms, int term_count);
+
+static void row_scalar(const uint64_t *up, const uint64_t *mid, const uint64_t *down,
+                       uint64_t *out, int count, const RuleTerm *terms, int term_count) {
+    for (int i = 0; i < count; i++) {
+        // West neighbour of bit b is bit b - 1, east is bit b + 1
+        uint64_t uw = (up[i] << 1) | (up[i - 1] >> 63);
+        uint64_t ue = (up[i] >> 1) | (up[i + 1] << 63);
+        uint64_t mw = (mid[i] << 1) | (mid[i - 1] >> 63);
+        uint64_t me = (mid[i] >> 1) | (mid[i + 1] << 63);
+        uint64_t dw = (down[i] << 1) | (down[i - 1] >> 63);
+        uint64_t de = (down[i] >> 1) | (down[i + 1] << 63);
+
+        uint64_t ux = uw ^ up[i];
+        uint64_t u0 = ux ^ ue;
+        uint64_t u1 = (uw & up[i]) | (ux & ue);
+        uint64_t m0 = mw ^ me;
+        uint64_t m1 = mw & me;
+        uint64_t dx = dw ^ down[i];
+        uint64_t d0 = dx ^ de;
+        uint64_t d1 = (dw & down[i]) | (dx & de);
+
+        uint64_t lx = u0 ^ m0;
+        uint64_t s0 = lx ^ d0;
+        uint64_t c1 = (u0 & m0) | (lx & d0);
+        uint64_t hx = u1 ^ m1;
+        uint64_t h = hx ^ d1;
+        uint64_t c2a = (u1 & m1) | (hx & d1);
+        uint64_t s1 = h ^ c1;
+        uint64_t c2b = h & c1;
+        uint64_t s2 = c2a ^ c2b;
+        uint64_t s3 = c2a & c2b;
+
+        uint64_t alive = mid[i];
+        uint64_t next = 0;
+        for (int t = 0; t < term_count; t++) {
+            const RuleTerm *term = &terms[t];
+            uint64_t differ = (s0 ^ term->match[0]) | (s1 ^ term->match[1]) |
+                              (s2 ^ term->match[2]) | (s3 ^ term->match[3]);
+            next |= ~differ & ((alive & term->survive) | (~alive & term->birth));
+        }
+        out[i] = next;
+    }
+}
+
+#ifdef LIFE_X86
+#define LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define AND _mm256_and_si256
+#define OR _mm256_or_si256
+#define XOR _mm256_xor_si256
+
+// `count` is rounded up to whole vectors; the caller clears what lies past
+// the last column
+__attribute__((target("avx2")))
+static void row_avx2(const uint64_t *up, const uint64_t *mid, const uint64_t *down,
+                     uint64_t *out, int count, const RuleTerm *terms, int term_count) {
+    for (int i = 0; i < count; i += LIFE_VECTOR_WORDS) {
+        __m256i u = LOAD(&up[i]);
+        __m256i m = LOAD(&mid[i]);
+        __m256i d = LOAD(&down[i]);
+        __m256i uw = OR(_mm256_slli_epi64(u, 1), _mm256_srli_epi64(LOAD(&up[i - 1]), 63));
+        __m256i ue = OR(_mm256_srli_epi64(u, 1), _mm256_slli_epi64(LOAD(&up[i + 1]), 63));
+        __m256i mw = OR(_mm256_slli_epi64(m, 1), _mm256_srli_epi64(LOAD(&mid[i - 1]), 63));
+        __m256i me = OR(_mm256_srli_epi64(m, 1), _mm256_slli_epi64(LOAD(&mid[i + 1]), 63));
+        __m256i dw = OR(_mm256_slli_epi64(d, 1), _mm256_srli_epi64(LOAD(&down[i - 1]), 63));
+        __m256i de = OR(_mm256_srli_epi64(d, 1), _mm256_slli_epi64(LOAD(&down[i + 1]), 63));
+
+        __m256i ux = XOR(uw, u);
+        __m256i u0 = XOR(ux, ue);
+        __m256i u1 = OR(AND(uw, u), AND(ux, ue));
+        __m256i m0 = XOR(mw, me);
+        __m256i m1 = AND(mw, me);
+        __m256i dx = XOR(dw, d);
+        __m256i d0 = XOR(dx, de);
+        __m256i d1 = OR(AND(dw, d), AND(dx, de));
+
+        __m256i lx = XOR(u0, m0);
+        __m256i s0 = XOR(lx, d0);
+        __m256i c1 = OR(AND(u0, m0), AND(lx, d0));
+        __m256i hx = XOR(u1, m1);
+        __m256i h = XOR(hx, d1);
+        __m256i c2a = OR(AND(u1, m1), AND(hx, d1));
+        __m256i s1 = XOR(h, c1);
+        __m256i c2b = AND(h, c1);
+        __m256i s2 = XOR(c2a, c2b);
+        __m256i s3 = AND(c2a, c2b);
+
+        __m256i next = _mm256_setzero_si256();
+        for (int t = 0; t < term_count; t++) {
+            const RuleTerm *term = &terms[t];
+            __m256i differ = OR(OR(XOR(s0, _mm256_set1_epi64x((long long)term->match[0])),
+                                   XOR(s1, _mm256_set1_epi64x((long long)term->match[1]))),
+                                OR(XOR(s2, _mm256_set1_epi64x((long long)term->match[2])),
+                                   XOR(s3, _mm256_set1_epi64x((long long)term->match[3]))));
+            __m256i born = _mm256_andnot_si256(m, _mm256_set1_epi64x((long long)term->birth));
+            __m256i kept = AND(m, _mm256_set1_epi64x((long long)term->survive));
+            next = OR(next, _mm256_andnot_si256(differ, OR(born, kept)));
+        }
+        _mm256_storeu_si256((__m256i *)&out[i], next);
+    }
+}
+
+#undef LOAD
+#undef AND
+#undef OR
+#undef XOR
+#endif
+
+static const LifeRow row_kernels[LIFE_ISA_COUNT] = {
+    [LIFE_SCALAR] = row_scalar,
+#ifdef LIFE_X86
+    [LIFE_AVX2] = row_avx2,
+#endif
+};
+
+static const char *isa_names[LIFE_ISA_COUNT] = {
+    [LIFE_SCALAR] = "scalar",
+    [LIFE_AVX2] = "avx2",
+};
+
+const char *life_isa_name(LifeIsa isa) {
+    if (isa < 0 || isa >= LIFE_ISA_COUNT) return "unknown";
+    return isa_names[isa];
+}
+
+static bool isa_supported(LifeIsa isa) {
+    switch (isa) {
+        case LIFE_SCALAR: return true;
+#ifdef LIFE_X86
+        case LIFE_AVX2: return __builtin_cpu_supports("avx2");
+#endif
+        default: return false;
+    }
+}
+
+LifeIsa life_best_isa(void) {
+    for (int isa = LIFE_ISA_COUNT - 1; isa > LIFE_SCALAR; isa--) {
+        if (isa_supported((LifeIsa)isa)) return (LifeIsa)isa;
+    }
+    return LIFE_SCALAR;
+}
+
+bool life_set_isa(LifeGrid *grid, LifeIsa isa) {
+    if (!isa_supported(isa)) return false;
+    grid->isa = isa;
+    return true;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    STEP    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void life_step(LifeGrid *grid) {
+    RuleTerm terms[9];
+    int term_count = rule_terms(grid->rule, terms);
+    LifeRow row = row_kernels[grid->isa];
+    int count = grid->isa == LIFE_SCALAR ? grid->row_words : grid->stride - 2;
+    int stride = grid->stride;
+
+    for (int y = 1; y <= grid->rows; y++) {
+        const uint64_t *mid = &grid->cells[(size_t)y * stride + 1];
+        uint64_t *out = &grid->next[(size_t)y * stride + 1];
+        row(mid - stride, mid, mid + stride, out, count, terms, term_count);
+
+        // Cells past the last column must stay dead
+        out[grid->row_words - 1] &= grid->tail_mask;
+        for (int i = grid->row_words; i < count; i++) out[i] = 0;
+    }
+
+    uint64_t *temp = grid->cells;
+    grid->cells = grid->next;
+    grid->next = temp;
+    grid->generation++;
+}
+
+uint64_t life_population(const LifeGrid *grid) {
+    uint64_t population = 0;
+    for (int y = 1; y <= grid->rows; y++) {
+        const uint64_t *row = &grid->cells[(size_t)y * grid->stride + 1];
+        for (int i = 0; i < grid->row_words; i++) {
+            population += (uint64_t)__builtin_popcountll(row[i]);
+        }
+    }
+    return population;
+}
+
+size_t life_memory_bytes(const LifeGrid *grid) {
+    return sizeof(LifeGrid) + 2 * (size_t)(grid->rows + 2) * grid->stride * sizeof(uint64_t);
+}
+
+uint64_t life_checksum(const LifeGrid *grid) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (int y = 1; y <= grid->rows; y++) {
+        const uint64_t *row = &grid->cells[(size_t)y * grid->stride + 1];
+        for (int i = 0; i < grid->row_words; i++) {
+            hash = (hash ^ row[i]) * 1099511628211ULL;
+        }
+    }
+    return hash;
+}
@@ -0,0 +1,76 @@
+#ifndef LIFE_H
+#define LIFE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Life-like engine. Runs any outer-totalistic B/S rule (Conway's B3/S23,
+// HighLife B36/S23, Day & Night B3678/S34678, ...) on a bounded grid whose
+// outside is dead. Cells are packed 64 to a uint64_t and a whole word is
+// advanced at once: the eight neighbour bits are summed with bit-sliced full
+// adders into a 4-bit count per lane, and the rule is applied to those count
+// planes. The AVX2 kernel does the same on four words at a time.
+//
+// Raylib-free like the sim core, so the benchmark can drive it.
+
+// Bit n set: n live neighbours cause a birth / let a live cell survive
+typedef struct {
+    uint16_t birth;
+    uint16_t survive;
+} LifeRule;
+
+typedef enum {
+    LIFE_SCALAR,
+    LIFE_AVX2,
+    LIFE_ISA_COUNT
+} LifeIsa;
+
+// Row r of the grid starts at cells[(r + 1) * stride + 1]. One dead row
+// above and below and one dead word left and right keep neighbour reads in
+// bounds; words past the last column stay zero.
+typedef struct {
+    int rows;
+    int cols;
+    int row_words;   // words holding cells, the last one maybe partly
+    int stride;      // words per row including padding, vector aligned
+    uint64_t tail_mask;
+    uint64_t *cells;
+    uint64_t *next;
+    LifeRule rule;
+    LifeIsa isa;
+    uint64_t generation;
+} LifeGrid;
+
+// Parses "B3/S23" style rules; also accepts lower case and "S23/B3".
+// Returns false on anything else.
+bool life_parse_rule(const char *text, LifeRule *rule);
+// Writes the rule back as "B.../S..."
+void life_format_rule(LifeRule rule, char *out, size_t size);
+
+LifeGrid *life_create(int rows, int cols, LifeRule rule);
+void life_destroy(LifeGrid *grid);
+void life_clear(LifeGrid *grid);
+// Fills the grid with live cells at `percent` density, reproducibly per seed
+void life_randomize(LifeGrid *grid, uint64_t seed, int percent);
+
+static inline bool life_get(const LifeGrid *grid, int x, int y) {
+    const uint64_t *row = &grid->cells[(size_t)(y + 1) * grid->stride + 1];
+    return (row[x >> 6] >> (x & 63)) & 1;
+}
+void life_set(LifeGrid *grid, int x, int y, bool alive);
+// Sets or clears cells x0..x1 of row y
+void life_fill_span(LifeGrid *grid, int y, int x0, int x1, bool alive);
+
+const char *life_isa_name(LifeIsa isa);
+// Best kernel the running CPU supports
+LifeIsa life_best_isa(void);
+// Returns false if the CPU cannot run `isa`
+bool life_set_isa(LifeGrid *grid, LifeIsa isa);
+
+void life_step(LifeGrid *grid);
+uint64_t life_population(const LifeGrid *grid);
+size_t life_memory_bytes(const LifeGrid *grid);
+uint64_t life_checksum(const LifeGrid *grid);
+
+#endif
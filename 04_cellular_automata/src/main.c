@@ -5,17 +5,12 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include "raylib.h"
-
-#define min(a,b) ((a) < (b) ? (a) : (b))
-
-#define NEIGHBOR_TOP          1
-#define NEIGHBOR_TOP_RIGHT    2
-#define NEIGHBOR_RIGHT        4
-#define NEIGHBOR_BOTTOM_RIGHT 7
-#define NEIGHBOR_BOTTOM       6
-#define NEIGHBOR_BOTTOM_LEFT  5
-#define NEIGHBOR_LEFT         3
-#define NEIGHBOR_TOP_LEFT     0
+#include "sim.h"
+#include "runner.h"
+#include "render.h"
+#include "life.h"
+#include "hashlife.h"
+#include "profile.h"
 
 const int UI_PANEL_W = 200;
 const int WND_H = 600;
@@ -24,427 +19,263 @@ const int GRID_H = 580;
 const int GRID_W = WND_W - UI_PANEL_W;
 const int GRID_PADDING = 10;  
 const int CELL_SIZE = 4;
-
-bool is_running = true;
-
-#define MAX_TEMPERATURE 1000
-#define MIN_TEMPERATURE 0
-
-typedef enum {
-    NONE,
-    SAND,
-    WATER,
-    ROCK,
-    FIRE
-} Element; 
-
-typedef struct {
-    Element type;
-    int temperature;
-    float velocity_x;
-    float velocity_y;
-    bool updated_this_frame;
-} Cell;
+const int PAN_SPEED = 4;  // cells per frame while an arrow key is held
+const char *SAVE_PATH = "falling_sand.sav";
+const int AUTOSAVE_SECONDS = 60;
+const int RECORD_CHECKSUM_TICKS = 30;  // grid checksum in the input log once a second
 
 Element selected_element = SAND;
 float brush_radius = 20.0f;
-
-// ~~~~~~~~~~~~~~~~~~~~~~~~~    RENDERING    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-void initialize_cell_layout(int *cell_x_positions, int *cell_y_positions, int rows, int cols) {
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            cell_x_positions[i * cols + j] = GRID_PADDING + j * CELL_SIZE;
-            cell_y_positions[i * cols + j] = GRID_PADDING + i * CELL_SIZE;
-        }
-    }
+Vector2 last_brush_pos;  // cell units, where the previous frame's stroke ended
+bool brush_down = false;
+int64_t camera_x = 0;  // plane cell at the top-left of the view
+int64_t camera_y = 0;
+int32_t requested_sx = 0;  // sim window last asked for
+int32_t requested_sy = 0;
+uint32_t seen_loads = 0;   // snapshot loads the camera has followed
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~    LIFE    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Life-like mode (L) pauses the sim and runs a Life grid of the same size
+// on this thread instead, drawn through the same renderer.
+typedef struct {
+    const char *name;
+    const char *rule;
+} LifePreset;
+
+const LifePreset life_presets[] = {
+    { "Conway", "B3/S23" },
+    { "HighLife", "B36/S23" },
+    { "Day & Night", "B3678/S34678" },
+    { "Seeds", "B2/S" },
+};
+#define LIFE_PRESET_COUNT (int)(sizeof(life_presets) / sizeof(life_presets[0]))
+#define LIFE_ALIVE ROCK  // element whose colour live cells are drawn in
+#define LIFE_JUMP_LOG 10 // J skips 2^10 generations
+
+bool life_mode = false;
+bool life_running = true;
+bool life_changed = true;   // grid differs from the last published snapshot
+bool sim_was_running = true;
+int life_preset = 0;
+int64_t life_origin_x = 0;  // plane cell of the Life grid's top-left
+int64_t life_origin_y = 0;
+
+void life_paint_span(void *ctx, int y, int x0, int x1) {
+    life_fill_span((LifeGrid *)ctx, y, x0, x1, true);
 }
 
-int* generate_neighbor_array(int rows, int cols) {
-    // Add error handling for malloc
-    int *neighbor_array = (int *)malloc(8 * rows * cols * sizeof(int));
-    if (!neighbor_array) {
-        TraceLog(LOG_ERROR, "Failed to allocate neighbor array");
-        return NULL;
-    }
-
-    // Define neighbor offsets for clearer code
-    const int neighbor_offsets[8][2] = {
-        {-1, -1}, {-1, 0}, {-1, 1},  // Top row
-        {0, -1},           {0, 1},    // Middle row
-        {1, -1},  {1, 0},  {1, 1}     // Bottom row
-    };
-
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            int idx = i * cols + j;
-
-            // Calculate all 8 neighbors using the offset array
-            for (int n = 0; n < 8; n++) {
-                int ni = i + neighbor_offsets[n][0];
-                int nj = j + neighbor_offsets[n][1];
+void life_select_preset(LifeGrid *life, int preset) {
+    life_preset = preset % LIFE_PRESET_COUNT;
+    life_parse_rule(life_presets[life_preset].rule, &life->rule);
+}
 
-                neighbor_array[idx * 8 + n] = (ni >= 0 && ni < rows && nj >= 0 && nj < cols) 
-                    ? ni * cols + nj 
-                    : -1;
-            }
+// Unpacks the grid into the snapshot the renderer reads
+void life_publish(const LifeGrid *life, Snapshot *snap, int tiles) {
+    for (int y = 0; y < life->rows; y++) {
+        for (int x = 0; x < life->cols; x++) {
+            snap->type[y * life->cols + x] = life_get(life, x, y) ? LIFE_ALIVE : NONE;
         }
     }
-
-    return neighbor_array;
+    snap->seq++;
+    snap->tick = life->generation;
+    snap->origin_x = life_origin_x;
+    snap->origin_y = life_origin_y;
+    for (int t = 0; t < tiles; t++) snap->tile_seq[t] = snap->seq;
 }
 
-inline int get_neighbor(const int* neighbor_array, int cell_idx, int neighbor_direction) {
-    return neighbor_array[cell_idx * 8 + neighbor_direction];
-}
-
-int draw_grid(Cell *grid, int *cell_x_positions, int *cell_y_positions, int rows, int cols) {
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            int idx = i * cols + j;
-            Element current_cell = grid[idx].type;
-
-            Color cell_color = PURPLE;
-            switch (current_cell) {
-                case NONE:
-                    cell_color = WHITE;
-                    break;
-                case SAND:
-                    cell_color = BEIGE;
-                    // Darken color based on temperature
-                    if (grid[idx].temperature > 400) {
-                        cell_color.r = min(255, cell_color.r + (grid[idx].temperature - 400) / 2);
-                    }
-                    break;
-                case WATER:
-                    cell_color = BLUE;
-                    break;
-                case ROCK:
-                    cell_color = GRAY;
-                    // Redden color based on temperature
-                    if (grid[idx].temperature > 600) {
-                        cell_color.r = min(255, cell_color.r + (grid[idx].temperature - 600) / 2);
-                    }
-                    break;
-                case FIRE:
-                    cell_color = RED;
-                    break;
-            }
-
-            DrawRectangle(
-                cell_x_positions[idx], 
-                cell_y_positions[idx], 
-                CELL_SIZE, CELL_SIZE, 
-                cell_color
-            );
-        }
+// Skips ahead through HashLife. Its universe is unbounded, so whatever
+// leaves the view on the way is gone when the grid is read back. If the
+// jump cannot be made the grid stays as it was.
+void life_jump(LifeGrid *life) {
+    HashLife *hl = hashlife_create(life->rule);
+    if (!hl) {
+        TraceLog(LOG_WARNING, "Jump skipped, HashLife could not start");
+        return;
     }
-    return 0;
+    if (hashlife_load_grid(hl, life) && hashlife_jump(hl, LIFE_JUMP_LOG)) {
+        hashlife_store_grid(hl, life, 0, 0);
+        life->generation += hl->generation;
+        life_changed = true;
+    } else {
+        TraceLog(LOG_WARNING, "Jump skipped, the pattern outgrew HashLife's universe or memory");
+    }
+    hashlife_destroy(hl);
 }
 
-// ~~~~~~~~~~~~~~~~~~~~~~    PHYSICS    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-int count_live_neighbors(int *grid, int i, int j) {
-    int live_neighbors = 0;
-    for (int x = -1; x <= 1; x++) {
-        for (int y = -1; y <= 1; y++) {
-            if (x == 0 && y == 0) continue;
-            int ni = i + x;
-            int nj = j + y;
-            if (ni >= 0 && ni < GRID_H && nj >= 0 && nj < GRID_W) {
-                live_neighbors += grid[ni * GRID_W + nj];
-            }
-        }
+void toggle_life_mode(SimRunner *runner, Renderer *renderer) {
+    life_mode = !life_mode;
+    if (life_mode) {
+        // The Life grid covers the sim's current window
+        const Snapshot *snap = runner_acquire_snapshot(runner);
+        life_origin_x = snap->origin_x;
+        life_origin_y = snap->origin_y;
+        sim_was_running = runner_is_running(runner);
+        runner_set_running(runner, false);
+        life_changed = true;
+    } else {
+        runner_set_running(runner, sim_was_running);
     }
-    return live_neighbors;
+    brush_down = false;
+    renderer_invalidate(renderer);
 }
 
-void swap_cells(Cell *a, Cell *b) {
-    Cell temp = *a;
-    *a = *b;
-    *b = temp;
+void draw_life_panel(float x, float y) {
+    DrawText(TextFormat("life: %s", life_presets[life_preset].name), x, y, 20, DARKGRAY);
+    DrawText(life_presets[life_preset].rule, x, y + 25, 20, DARKGRAY);
+    DrawText(TextFormat("R rule  N soup  J +%d  L sand", 1 << LIFE_JUMP_LOG), x, y + 50, 10, GRAY);
 }
 
-float calculate_water_pressure(Cell *grid, int idx, int rows, int cols, int *neighbor_array) {
-    int water_column = 0;
-    int current = idx;
-    
-    while (current >= cols) {
-        int above = neighbor_array[current * 8 + 1];
-        if (above == -1 || grid[above].type != WATER) break;
-        water_column++;
-        current = above;
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~    PROFILE    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// F3 shows the last second of profile.h numbers in the panel, F4 writes
+// them out. Both need a PROFILE build.
+bool profile_overlay = false;
+ProfileTotals profile_mark;   // totals when the current second started
+ProfileTotals profile_second; // differences over the last whole second
+double profile_mark_time = 0.0;
+
+void profile_sample(void) {
+    double now = GetTime();
+    if (now - profile_mark_time < 1.0) return;
+    ProfileTotals totals;
+    profile_read(&totals);
+    for (int z = 0; z < PROFILE_ZONE_COUNT; z++) {
+        profile_second.zones[z].calls = totals.zones[z].calls - profile_mark.zones[z].calls;
+        profile_second.zones[z].total_ns = totals.zones[z].total_ns - profile_mark.zones[z].total_ns;
     }
-    
-    return 1.0f + (water_column * 0.2f);
-}
-
-void update_sand(Cell *grid, Cell *new_grid, int idx, int rows, int cols, int *neighbor_array) {
-    if (new_grid[idx].updated_this_frame) return;
-
-    int below = get_neighbor(neighbor_array, idx, NEIGHBOR_BOTTOM);
-    int below_left = get_neighbor(neighbor_array, idx, NEIGHBOR_BOTTOM_LEFT);
-    int below_right = get_neighbor(neighbor_array, idx, NEIGHBOR_BOTTOM_RIGHT);
-
-    // FLOW STATE - same pattern as water for consistency
-    int flow_down = (below != -1 && !new_grid[below].updated_this_frame && 
-                    (new_grid[below].type == NONE || new_grid[below].type == WATER));
-    int flow_down_left = (below_left != -1 && !new_grid[below_left].updated_this_frame && 
-                         (new_grid[below_left].type == NONE || new_grid[below_left].type == WATER));
-    int flow_down_right = (below_right != -1 && !new_grid[below_right].updated_this_frame && 
-                          (new_grid[below_right].type == NONE || new_grid[below_right].type == WATER));
-
-    // PRIMARY MOVEMENT LOGIC
-    if (flow_down) {
-        // Direct fall - increase velocity
-        swap_cells(&new_grid[idx], &new_grid[below]);
-        new_grid[below].updated_this_frame = true;
-        new_grid[below].velocity_y = fmin(new_grid[below].velocity_y + 0.5f, 2.0f);
-        return;
+    for (int e = 0; e < ELEMENT_COUNT; e++) {
+        profile_second.elements[e].visited = totals.elements[e].visited - profile_mark.elements[e].visited;
+        profile_second.elements[e].moved = totals.elements[e].moved - profile_mark.elements[e].moved;
+        profile_second.elements[e].skipped = totals.elements[e].skipped - profile_mark.elements[e].skipped;
+        profile_second.elements[e].cycles = totals.elements[e].cycles - profile_mark.elements[e].cycles;
     }
+    profile_second.ns_per_cycle = totals.ns_per_cycle;
+    profile_mark = totals;
+    profile_mark_time = now;
+}
 
-    // More aggressive diagonal movement
-    if (flow_down_left || flow_down_right) {
-        int target;
-
-        // If both sides available, use velocity and randomness
-        if (flow_down_left && flow_down_right) {
-            // Bias based on horizontal velocity
-            float left_chance = 0.9f ;
-
-            target = (rand() / (float)RAND_MAX < left_chance) ? below_left : below_right;
-        } else {
-            target = flow_down_left ? below_left : below_right;
-        }
-
-        swap_cells(&new_grid[idx], &new_grid[target]);
-        new_grid[target].updated_this_frame = true;
-
-        // Update velocity for next frame
-        new_grid[target].velocity_y = fmin(new_grid[target].velocity_y + 0.3f, 1.5f);
-        new_grid[target].velocity_x = (target == below_left) ? -0.5f : 0.5f;
-
-        return;
+void profile_export(void) {
+    if (profile_write_trace("profile.json") && profile_write_csv("profile.csv")) {
+        TraceLog(LOG_INFO, "Profile written to profile.json and profile.csv");
+    } else if (!PROFILE_ENABLED) {
+        TraceLog(LOG_WARNING, "Profiling is not built in, rebuild with make PROFILE=1");
     }
-
-    // If we can't move, slowly reset velocities
-    new_grid[idx].velocity_x *= 0.8f;
-    new_grid[idx].velocity_y *= 0.8f;
 }
 
-void update_water(Cell *grid, Cell *new_grid, int idx, int rows, int cols, int *neighbor_array) {
-    // Skip if already updated
-    if (new_grid[idx].updated_this_frame) {
+// Zones as mean ms per call and calls per second; elements per tick
+void draw_profile_overlay(float x, float y) {
+    if (!PROFILE_ENABLED) {
+        DrawText("profiling: make PROFILE=1", x, y, 10, GRAY);
         return;
     }
-
-    // Get neighbor indices using the new helper function
-    int below = get_neighbor(neighbor_array, idx, NEIGHBOR_BOTTOM);
-    int below_left = get_neighbor(neighbor_array, idx, NEIGHBOR_BOTTOM_LEFT);
-    int below_right = get_neighbor(neighbor_array, idx, NEIGHBOR_BOTTOM_RIGHT);
-    int left = get_neighbor(neighbor_array, idx, NEIGHBOR_LEFT);
-    int right = get_neighbor(neighbor_array, idx, NEIGHBOR_RIGHT);
-
-    // FLOW STATE
-    // Check if cell can flow in each direction (1 = can flow, 0 = blocked)
-    int flow_left = (left != -1 && !new_grid[left].updated_this_frame && 
-                    new_grid[left].type == NONE) ? 1 : 0;
-
-    int flow_right = (right != -1 && !new_grid[right].updated_this_frame && 
-                     new_grid[right].type == NONE) ? 1 : 0;
-
-    int flow_down = (below != -1 && !new_grid[below].updated_this_frame && 
-                    new_grid[below].type == NONE) ? 1 : 0;
-
-    int flow_down_left = (below_left != -1 && !new_grid[below_left].updated_this_frame && 
-                         new_grid[below_left].type == NONE) ? 1 : 0;
-    
-    int flow_down_right = (below_right != -1 && !new_grid[below_right].updated_this_frame && 
-                          new_grid[below_right].type == NONE) ? 1 : 0;
-
-    // PRIMARY MOVEMENT LOGIC
-    if (flow_down) {
-        // Fall straight down
-        swap_cells(&new_grid[idx], &new_grid[below]);
-        new_grid[below].updated_this_frame = true;
-        new_grid[idx].updated_this_frame = true;
-    }
-    else if (flow_down_left || flow_down_right) {
-        // Try to flow diagonally
-        int target;
-        if (flow_down_left && flow_down_right) {
-            // Randomize between left and right when both are available
-            target = (rand() % 2) ? below_left : below_right;
-        } else {
-            // Flow to whichever side is available
-            target = flow_down_left ? below_left : below_right;
-        }
-        swap_cells(&new_grid[idx], &new_grid[target]);
-        new_grid[target].updated_this_frame = true;
-        new_grid[idx].updated_this_frame = true;
+    for (int z = 0; z < PROFILE_ZONE_COUNT; z++) {
+        const ProfileZoneStats *s = &profile_second.zones[z];
+        if (!s->calls) continue;
+        DrawText(TextFormat("%s  %.2f ms  x%llu", profile_zone_name(z), s->total_ns / 1e6 / s->calls,
+                            (unsigned long long)s->calls), x, y, 10, DARKGRAY);
+        y += 12;
     }
-    else if (flow_left || flow_right) {
-        // Horizontal flow with momentum
-        int target;
-        if (flow_left && flow_right) {
-            // If both sides open, pick random but bias based on existing velocity
-            target = (rand() % 2) ? left : right;
-        } else {
-            // Flow to whichever side is open
-            target = flow_left ? left : right;
-        }
-        
-        swap_cells(&new_grid[idx], &new_grid[target]);
-        new_grid[target].updated_this_frame = true;
-        new_grid[idx].updated_this_frame = true;
-        
-        // Update momentum based on flow direction
-        new_grid[target].velocity_x = (target == left) ? -1.0f : 1.0f;
-    }
-
-    // Temperature effects - evaporation
-    if (new_grid[idx].temperature >= 100) {
-        float evaporation_chance = (new_grid[idx].temperature - 100.0f) / 20.0f;
-        if ((float)rand() / RAND_MAX < evaporation_chance) {
-            new_grid[idx].type = NONE;
-            new_grid[idx].temperature = 100.0f;
-        }
+    uint64_t ticks = profile_second.zones[PROFILE_STEP].calls;
+    if (!ticks) return;
+    y += 4;
+    DrawText("per tick: visited moved skipped us", x, y, 10, GRAY);
+    y += 12;
+    for (int e = 0; e < ELEMENT_COUNT; e++) {
+        const ProfileElementStats *s = &profile_second.elements[e];
+        if (!s->visited && !s->skipped) continue;
+        DrawText(TextFormat("%s %llu %llu %llu %.0f", element_info[e].name, (unsigned long long)(s->visited / ticks),
+                            (unsigned long long)(s->moved / ticks), (unsigned long long)(s->skipped / ticks),
+                            s->cycles * profile_second.ns_per_cycle / 1e3 / ticks), x, y, 10, DARKGRAY);
+        y += 12;
     }
 }
-void update_fire(Cell *grid, Cell *new_grid, int idx, int rows, int cols, int *neighbor_array) {
-    int heat_radius = 2;
-    
-    // Natural fire decay
-    if (rand() % 100 < 5) {
-        new_grid[idx].type = NONE;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~    UI    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void handle_mouse_drag(SimRunner *runner, LifeGrid *life) {
+    if (!IsMouseButtonDown(MOUSE_LEFT_BUTTON)) {
+        brush_down = false;
         return;
     }
 
-    // Heat propagation within radius
-    for (int n = 0; n < 8; n++) {
-        int neighbor_idx = neighbor_array[idx * 8 + n];
-        if (neighbor_idx == -1) continue;
-
-        // Heat transfer to neighbors
-        new_grid[neighbor_idx].temperature += (50 / (heat_radius * heat_radius));
-
-        // Interaction with other elements
-        switch (grid[neighbor_idx].type) {
-            case WATER:
-                new_grid[idx].type = NONE;
-                return;
-            case SAND:
-                if (new_grid[neighbor_idx].temperature > 800 && rand() % 100 < 10) {
-                    new_grid[neighbor_idx].type = NONE;
-                }
-                break;
-            case ROCK:
-                if (new_grid[neighbor_idx].temperature > 900) {
-                    new_grid[neighbor_idx].type = FIRE;
-                }
-                break;
-            case FIRE:
-            case NONE:
-                break;
-        }
+    // Only the drawn part of the grid takes paint: the window reaches past
+    // the view, and clicks on the panel would land in unseen cells.
+    // Leaving the view ends the stroke.
+    Vector2 mouse_pos = GetMousePosition();
+    Rectangle view = {
+        GRID_PADDING, GRID_PADDING,
+        (int)(GRID_W / CELL_SIZE) * CELL_SIZE, (int)(GRID_H / CELL_SIZE) * CELL_SIZE
+    };
+    if (!CheckCollisionPointRec(mouse_pos, view)) {
+        brush_down = false;
+        return;
     }
 
-    // Fire movement
-    int above = neighbor_array[idx * 8 + 1];
-    if (above != -1 && grid[above].type == NONE && rand() % 100 < 70) {
-        swap_cells(&new_grid[idx], &new_grid[above]);
-        new_grid[above].updated_this_frame = true;
+    // The sim thread paints it; convert to plane cells for it
+    Vector2 pos = {
+        camera_x + (mouse_pos.x - GRID_PADDING) / CELL_SIZE,
+        camera_y + (mouse_pos.y - GRID_PADDING) / CELL_SIZE
+    };
+    if (!brush_down) last_brush_pos = pos;
+
+    // Sweep from where the last frame left off so fast drags stay connected
+    BrushStroke stroke = {
+        last_brush_pos.x, last_brush_pos.y,
+        pos.x, pos.y,
+        brush_radius / CELL_SIZE,
+        selected_element
+    };
+    if (life_mode) {
+        // The Life grid lives on this thread, paint it directly
+        stroke.x0 -= life_origin_x;
+        stroke.x1 -= life_origin_x;
+        stroke.y0 -= life_origin_y;
+        stroke.y1 -= life_origin_y;
+        if (brush_spans(&stroke, life->rows, life->cols, life_paint_span, life) > 0) life_changed = true;
+    } else if (!runner_push_brush(runner, &stroke)) {
+        TraceLog(LOG_WARNING, "Brush queue full, stroke dropped");
     }
+    last_brush_pos = pos;
+    brush_down = true;
 }
 
-void update_rock(Cell *grid, Cell *new_grid, int idx, int rows, int cols, int *neighbor_array) {
-    // Rocks only move if unsupported
-    int below = neighbor_array[idx * 8 + 4];
-    if (below == -1) return;
-
-    bool is_supported = false;
-    
-    // Check for support (including diagonals)
-    for (int n = 3; n <= 5; n++) {  // Check bottom-left, bottom, bottom-right
-        int support_idx = neighbor_array[idx * 8 + n];
-        if (support_idx != -1 && (grid[support_idx].type == ROCK || grid[support_idx].type == SAND)) {
-            is_supported = true;
-            break;
-        }
-    }
-
-    if (!is_supported && grid[below].type == NONE) {
-        swap_cells(&new_grid[idx], &new_grid[below]);
-        new_grid[below].updated_this_frame = true;
-    }
-
-    // Temperature effects - rocks melt at very high temperatures
-    if (new_grid[idx].temperature > 900) {
-        new_grid[idx].type = FIRE;
+// Arrow keys pan the view; the sim window follows it a sector at a time
+void handle_camera(SimRunner *runner) {
+    if (IsKeyDown(KEY_LEFT)) camera_x -= PAN_SPEED;
+    if (IsKeyDown(KEY_RIGHT)) camera_x += PAN_SPEED;
+    if (IsKeyDown(KEY_UP)) camera_y -= PAN_SPEED;
+    if (IsKeyDown(KEY_DOWN)) camera_y += PAN_SPEED;
+
+    // One spare sector on every side, see window_sectors. Asking only on a
+    // change leaves a window a load has moved alone until the view follows.
+    int32_t sx = sector_floor_div(camera_x, SECTOR_SIZE) - 1;
+    int32_t sy = sector_floor_div(camera_y, SECTOR_SIZE) - 1;
+    if (!life_mode && (sx != requested_sx || sy != requested_sy)) {
+        runner_set_window(runner, sx, sy);
+        requested_sx = sx;
+        requested_sy = sy;
     }
 }
 
-void update_grid(Cell *grid, Cell *new_grid, int rows, int cols, int *neighbor_array) {
-    // Reset update flags
-    for (int i = 0; i < rows * cols; i++) {
-        grid[i].updated_this_frame = false;
-        new_grid[i] = grid[i];
-    }
-
-    // Update from bottom to top for gravity-based elements
-    for (int i = rows - 1; i >= 0; i--) {
-        for (int j = 0; j < cols; j++) {
-            int idx = i * cols + j;
-            if (grid[idx].updated_this_frame) continue;
-
-            switch (grid[idx].type) {
-                case SAND: {
-                    update_sand(grid, new_grid, idx, rows, cols, neighbor_array);
-                    break;
-                }
-                case WATER: {
-                    update_water(grid, new_grid, idx, rows, cols, neighbor_array);
-                    break;
-                }
-                case FIRE: {
-                    update_fire(grid, new_grid, idx, rows, cols, neighbor_array);
-                    break;
-                }
-                case ROCK: {
-                    update_rock(grid, new_grid, idx, rows, cols, neighbor_array);
-                    break;
-                }
-                case NONE: {
-                    break; // Empty cells don't need updating
-                }
-            }
-        }
-    }
+// Sectors the window needs so that, starting a sector before the one the
+// view's corner is in, it always covers the view
+int window_sectors(int view_cells) {
+    return (view_cells + SECTOR_SIZE - 1) / SECTOR_SIZE + 2;
 }
 
+// A loaded snapshot brings its own window; put the view back where it was
+void follow_load(const Snapshot *snap) {
+    if (snap->loads == seen_loads) return;
+    seen_loads = snap->loads;
+    camera_x = snap->origin_x + SECTOR_SIZE;
+    camera_y = snap->origin_y + SECTOR_SIZE;
+}
 
-// ~~~~~~~~~~~~~~~~~~~~~~~~~~    UI    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-void handle_mouse_drag(Cell *grid, int *cell_x_positions, int *cell_y_positions, int rows, int cols) {
-    if (IsMouseButtonDown(MOUSE_LEFT_BUTTON)) {
-        Vector2 mouse_pos = GetMousePosition();
+void draw_camera_position(float x, float y) {
+    DrawText(TextFormat("%lld, %lld", (long long)camera_x, (long long)camera_y), x, y, 10, GRAY);
+}
 
-        for (int i = 0; i < rows; i++) {
-            for (int j = 0; j < cols; j++) {
-                int idx = i * cols + j;
-                float cell_center_x = cell_x_positions[idx] + CELL_SIZE / 2.0f;
-                float cell_center_y = cell_y_positions[idx] + CELL_SIZE / 2.0f;
-
-                float distance = sqrtf((mouse_pos.x - cell_center_x) * (mouse_pos.x - cell_center_x) +
-                                    (mouse_pos.y - cell_center_y) * (mouse_pos.y - cell_center_y));
-
-                if (distance <= brush_radius) {
-                    grid[idx].type = selected_element;
-                    grid[idx].temperature = 20;
-                    grid[idx].velocity_x = 0;
-                    grid[idx].velocity_y = 0;
-                    grid[idx].updated_this_frame = false;
-                }
-            }
-        }
-    }
+void draw_save_status(SimRunner *runner, float x, float y) {
+    static const char *labels[] = { "F5 save  F9 load", "saving...", "saved", "loaded", "save failed" };
+    DrawText(labels[runner_save_status(runner)], x, y, 10, GRAY);
 }
 
 void sand_button_pressed() {
@@ -525,83 +356,152 @@ void draw_brush_slider() {
     }
 }
 
-int main(void) {
-    InitWindow(WND_W, WND_H, "Falling Sand");
+// game [--record file]: --record logs every input for `bench -R file`
+int main(int argc, char **argv) {
+    const char *record_path = NULL;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0) record_path = argv[++i];
+    }
 
-    int fps = 30;
-    float update_interval = 1.0f / fps;
-    float time_since_last_update = 0.0f; 
-
-    // setup CA grid
-    int cols = (int)(GRID_W / CELL_SIZE);
-    int rows = (int)(GRID_H / CELL_SIZE);
-
-    Cell *grid = (Cell *)malloc(rows * cols * sizeof(Cell));
-    Cell *new_grid = (Cell *)malloc(rows * cols * sizeof(Cell));
-
-    // Initialize all cells
-    for (int i = 0; i < rows * cols; i++) {
-        grid[i] = (Cell){
-            .type = NONE,
-            .temperature = 20, // room temperature
-            .velocity_x = 0,
-            .velocity_y = 0,
-            .updated_this_frame = false
-        };
-        new_grid[i] = grid[i];
+    InitWindow(WND_W, WND_H, "Falling Sand");
+    SetTargetFPS(60);
+
+    int tick_hz = 30;
+
+    // setup CA grid: the view onto the plane, and the window of sectors
+    // around it that is simulated
+    int view_cols = (int)(GRID_W / CELL_SIZE);
+    int view_rows = (int)(GRID_H / CELL_SIZE);
+    int window_w = window_sectors(view_cols);
+    int window_h = window_sectors(view_rows);
+    int cols = window_w * SECTOR_SIZE;
+    int rows = window_h * SECTOR_SIZE;
+
+    World *world = world_create(rows, cols, (unsigned int)time(NULL));
+    SectorMap *sectors = sector_map_create(window_w, window_h, NULL);
+    if (!world || !sectors) {
+        TraceLog(LOG_ERROR, "Failed to create world");
+        sector_map_destroy(sectors);
+        world_destroy(world);
+        CloseWindow();
+        return 1;
     }
+    sectors->window_sx = requested_sx = sector_floor_div(camera_x, SECTOR_SIZE) - 1;
+    sectors->window_sy = requested_sy = sector_floor_div(camera_y, SECTOR_SIZE) - 1;
 
-    int *cell_x_positions = (int *)malloc(rows * cols * sizeof(int));
-    int *cell_y_positions = (int *)malloc(rows * cols * sizeof(int));
+    Renderer *renderer = renderer_create(rows, cols);
+    if (!renderer) {
+        sector_map_destroy(sectors);
+        world_destroy(world);
+        CloseWindow();
+        return 1;
+    }
 
-    initialize_cell_layout(cell_x_positions, cell_y_positions, rows, cols);
+    Recorder *recorder = NULL;
+    if (record_path) {
+        recorder = recorder_create(record_path, world, sectors, SCENARIO_EMPTY, RECORD_CHECKSUM_TICKS);
+        if (!recorder) TraceLog(LOG_WARNING, "Not recording");
+    }
 
-    int *neighbor_array = generate_neighbor_array(rows, cols);
-    if (!neighbor_array) {
-        TraceLog(LOG_ERROR, "Failed to generate neighbor array");
-        free(grid);
-        free(new_grid);
-        free(cell_x_positions);
-        free(cell_y_positions);
+    // From here on the world, its sectors and the recorder belong to the sim thread
+    SimRunner *runner = runner_create(world, sectors, recorder, tick_hz);
+    if (!runner) {
+        TraceLog(LOG_ERROR, "Failed to start simulation");
+        recorder_close(recorder, world);
+        renderer_destroy(renderer);
+        sector_map_destroy(sectors);
+        world_destroy(world);
         CloseWindow();
         return 1;
     }
+    if (!runner_enable_saves(runner, SAVE_PATH, (uint64_t)AUTOSAVE_SECONDS * tick_hz)) {
+        TraceLog(LOG_WARNING, "Saving disabled");
+    }
+
+    LifeGrid *life = life_create(rows, cols, (LifeRule){ 0, 0 });
+    int tiles = renderer->tiles_x * renderer->tiles_y;
+    Snapshot life_snap = {
+        .type = (uint8_t *)calloc((size_t)rows * cols, 1),
+        .temperature = (int16_t *)calloc((size_t)rows * cols, sizeof(int16_t)),
+        .tile_seq = (uint64_t *)calloc(tiles, sizeof(uint64_t)),
+    };
+    if (!life || !life_snap.type || !life_snap.temperature || !life_snap.tile_seq) {
+        TraceLog(LOG_ERROR, "Failed to create life grid");
+        life_destroy(life);
+        life = NULL;
+    } else {
+        life_select_preset(life, 0);
+        life_randomize(life, (uint64_t)time(NULL), 25);
+    }
 
     while (!WindowShouldClose()) {
-        if (IsKeyReleased(KEY_SPACE)) {
-            is_running = !is_running;
+        if (IsKeyReleased(KEY_L) && life) toggle_life_mode(runner, renderer);
+        if (life_mode) {
+            if (IsKeyReleased(KEY_SPACE)) life_running = !life_running;
+            if (IsKeyReleased(KEY_R)) life_select_preset(life, life_preset + 1);
+            if (IsKeyReleased(KEY_J)) life_jump(life);
+            if (IsKeyReleased(KEY_N)) {
+                life_randomize(life, (uint64_t)time(NULL) + life->generation, 25);
+                life_changed = true;
+            }
+        } else {
+            if (IsKeyReleased(KEY_SPACE)) runner_set_running(runner, !runner_is_running(runner));
+            if (IsKeyReleased(KEY_F5)) runner_request_save(runner);
+            if (IsKeyReleased(KEY_F9)) runner_request_load(runner);
         }
-
-        float delta_time = GetFrameTime();
-        time_since_last_update += delta_time;
-        if (time_since_last_update >= update_interval && is_running) {
-            update_grid(grid, new_grid, rows, cols, neighbor_array);
-
-            Cell *temp = grid;
-            grid = new_grid;
-            new_grid = temp;
-
-            time_since_last_update = 0.0f;
-            handle_mouse_drag(grid, cell_x_positions, cell_y_positions, rows, cols);
+        if (IsKeyReleased(KEY_F3)) profile_overlay = !profile_overlay;
+        if (IsKeyReleased(KEY_F4)) profile_export();
+        profile_sample();
+        handle_camera(runner);
+        handle_mouse_drag(runner, life);
+
+        if (life_mode && life_running) {
+            life_step(life);
+            life_changed = true;
+        }
+        if (life_mode && life_changed) {
+            life_publish(life, &life_snap, tiles);
+            life_changed = false;
         }
 
         BeginDrawing();
         ClearBackground(RAYWHITE);
-        draw_grid(grid, cell_x_positions, cell_y_positions, rows, cols);
-
+        const Snapshot *snap = life_mode ? &life_snap : runner_acquire_snapshot(runner);
+        if (!life_mode) follow_load(snap);
+        PROFILE_BEGIN(PROFILE_RENDER);
+        renderer_update(renderer, snap);
+        PROFILE_END(PROFILE_RENDER);
+        PROFILE_BEGIN(PROFILE_DRAW);
+        renderer_draw_region(renderer, (int)(camera_x - snap->origin_x), (int)(camera_y - snap->origin_y),
+                             view_cols, view_rows, GRID_PADDING, GRID_PADDING, CELL_SIZE);
+        PROFILE_END(PROFILE_DRAW);
+
+        PROFILE_BEGIN(PROFILE_UI);
         draw_buttons(GRID_W + 30, UI_PANEL_W - 50);
+        if (life_mode) {
+            draw_life_panel(GRID_W + 30, 300);
+        } else if (profile_overlay) {
+            draw_profile_overlay(GRID_W + 30, 300);
+        }
+        draw_camera_position(GRID_W + 30, WND_H - 80);
+        draw_save_status(runner, GRID_W + 30, WND_H - 65);
         draw_brush_outline();
         draw_brush_slider();
+        PROFILE_END(PROFILE_UI);
         EndDrawing();
 
         handle_button_input(GRID_W, UI_PANEL_W);
     }
 
-    free(grid);
-    free(new_grid);
-    free(cell_x_positions);
-    free(cell_y_positions);
+    runner_destroy(runner);
+    recorder_close(recorder, world);
+    sector_map_destroy(sectors);
+    life_destroy(life);
+    free(life_snap.type);
+    free(life_snap.temperature);
+    free(life_snap.tile_seq);
+    renderer_destroy(renderer);
+    world_destroy(world);
     CloseWindow();
     return 0;
 }
-
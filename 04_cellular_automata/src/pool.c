@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "pool.h"
+
+static void drain(ThreadPool *pool) {
+    for (;;) {
+        int index = __atomic_fetch_add(&pool->next_index, 1, __ATOMIC_RELAXED);
+        if (index >= pool->count) break;
+        pool->task(pool->arg, index);
+    }
+}
+
+static void *worker_main(void *arg) {
+    ThreadPool *pool = (ThreadPool *)arg;
+    uint64_t seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == seen && !pool->shutdown) {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        drain(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) pthread_cond_signal(&pool->work_done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+ThreadPool *pool_create(int threads) {
+    ThreadPool *pool = (ThreadPool *)calloc(1, sizeof(ThreadPool));
+    if (!pool) return NULL;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    int workers = threads > 1 ? threads - 1 : 0;
+    pool->threads = (pthread_t *)malloc((workers ? workers : 1) * sizeof(pthread_t));
+    if (!pool->threads) {
+        pool_destroy(pool);
+        return NULL;
+    }
+
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0) {
+            fprintf(stderr, "Failed to start worker %d\n", i);
+            pool_destroy(pool);
+            return NULL;
+        }
+        pool->thread_count++;
+    }
+    return pool;
+}
+
+void pool_destroy(ThreadPool *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->work_done);
+    free(pool->threads);
+    free(pool);
+}
+
+void pool_run(ThreadPool *pool, int count, PoolTask task, void *arg) {
+    if (count <= 0) return;
+
+    if (pool->thread_count == 0 || count == 1) {
+        for (int i = 0; i < count; i++) task(arg, i);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->arg = arg;
+    pool->count = count;
+    pool->next_index = 0;
+    pool->busy = pool->thread_count;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    drain(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,36 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Persistent worker pool. pool_run hands out indices [0, count) to the
+// workers and the calling thread, and returns once all of them are done.
+
+typedef void (*PoolTask)(void *arg, int index);
+
+typedef struct ThreadPool {
+    int thread_count;  // workers, not counting the thread that calls pool_run
+    pthread_t *threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    uint64_t generation;
+    bool shutdown;
+
+    PoolTask task;
+    void *arg;
+    int count;
+    int next_index;  // claimed with atomic fetch-add
+    int busy;        // workers still inside the current batch
+} ThreadPool;
+
+// `threads` is the total parallelism including the caller, so 1 means no
+// workers are started and pool_run runs everything inline.
+ThreadPool *pool_create(int threads);
+void pool_destroy(ThreadPool *pool);
+void pool_run(ThreadPool *pool, int count, PoolTask task, void *arg);
+
+#endif
@@ -0,0 +1,180 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include "profile.h"
+
+static const char *zone_names[PROFILE_ZONE_COUNT] = {
+    "step", "sweep", "support", "depth", "levelling", "thermal", "brush", "window", "publish", "render", "draw", "ui",
+};
+
+const char *profile_zone_name(ProfileZone zone) {
+    return zone_names[zone];
+}
+
+#ifdef PROFILE
+
+// Trace ring. A slot's seq is written last, so a reader that sees the same
+// seq before and after reading the fields got a whole event.
+typedef struct {
+    uint64_t seq;  // event number + 1, 0 while empty
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    uint32_t zone;
+    uint32_t thread;
+} TraceEvent;
+
+static ProfileZoneStats zones[PROFILE_ZONE_COUNT];
+static ProfileElementStats elements[ELEMENT_COUNT];
+static TraceEvent trace[PROFILE_TRACE_EVENTS];
+static uint64_t trace_next;
+static uint32_t thread_count;
+static __thread uint32_t thread_id;  // 1-based, 0 until the thread's first event
+
+static uint64_t origin_ns;      // first reading of the clock, trace time 0
+static uint64_t origin_cycles;
+
+uint64_t profile_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    uint64_t expected = 0;
+    if (!__atomic_load_n(&origin_ns, __ATOMIC_RELAXED) &&
+        __atomic_compare_exchange_n(&origin_ns, &expected, now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&origin_cycles, profile_cycles(), __ATOMIC_RELAXED);
+    }
+    return now;
+}
+
+static inline void add(uint64_t *total, uint64_t value) {
+    if (value) __atomic_fetch_add(total, value, __ATOMIC_RELAXED);
+}
+
+void profile_zone(ProfileZone zone, uint64_t start_ns) {
+    uint64_t duration = profile_now() - start_ns;
+    ProfileZoneStats *stats = &zones[zone];
+    add(&stats->calls, 1);
+    add(&stats->total_ns, duration);
+    uint64_t max = __atomic_load_n(&stats->max_ns, __ATOMIC_RELAXED);
+    while (duration > max &&
+           !__atomic_compare_exchange_n(&stats->max_ns, &max, duration, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+    if (!thread_id) thread_id = __atomic_add_fetch(&thread_count, 1, __ATOMIC_RELAXED);
+    uint64_t n = __atomic_fetch_add(&trace_next, 1, __ATOMIC_RELAXED);
+    TraceEvent *event = &trace[n & (PROFILE_TRACE_EVENTS - 1)];
+    __atomic_store_n(&event->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&event->start_ns, start_ns, __ATOMIC_RELAXED);
+    __atomic_store_n(&event->duration_ns, duration, __ATOMIC_RELAXED);
+    __atomic_store_n(&event->zone, (uint32_t)zone, __ATOMIC_RELAXED);
+    __atomic_store_n(&event->thread, thread_id, __ATOMIC_RELAXED);
+    __atomic_store_n(&event->seq, n + 1, __ATOMIC_RELEASE);
+}
+
+void profile_add_elements(const ProfileElementStats *span) {
+    for (int e = 0; e < ELEMENT_COUNT; e++) {
+        add(&elements[e].visited, span[e].visited);
+        add(&elements[e].moved, span[e].moved);
+        add(&elements[e].skipped, span[e].skipped);
+        add(&elements[e].cycles, span[e].cycles);
+    }
+}
+
+void profile_read(ProfileTotals *out) {
+    for (int z = 0; z < PROFILE_ZONE_COUNT; z++) {
+        out->zones[z].calls = __atomic_load_n(&zones[z].calls, __ATOMIC_RELAXED);
+        out->zones[z].total_ns = __atomic_load_n(&zones[z].total_ns, __ATOMIC_RELAXED);
+        out->zones[z].max_ns = __atomic_load_n(&zones[z].max_ns, __ATOMIC_RELAXED);
+    }
+    for (int e = 0; e < ELEMENT_COUNT; e++) {
+        out->elements[e].visited = __atomic_load_n(&elements[e].visited, __ATOMIC_RELAXED);
+        out->elements[e].moved = __atomic_load_n(&elements[e].moved, __ATOMIC_RELAXED);
+        out->elements[e].skipped = __atomic_load_n(&elements[e].skipped, __ATOMIC_RELAXED);
+        out->elements[e].cycles = __atomic_load_n(&elements[e].cycles, __ATOMIC_RELAXED);
+    }
+    uint64_t ns = profile_now();
+    uint64_t cycles = profile_cycles();
+    uint64_t start_ns = __atomic_load_n(&origin_ns, __ATOMIC_RELAXED);
+    uint64_t start_cycles = __atomic_load_n(&origin_cycles, __ATOMIC_RELAXED);
+    out->ns_per_cycle = cycles > start_cycles && start_cycles ? (double)(ns - start_ns) / (double)(cycles - start_cycles) : 0.0;
+}
+
+bool profile_write_trace(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "Failed to write trace %s\n", path);
+        return false;
+    }
+    uint64_t start_ns = __atomic_load_n(&origin_ns, __ATOMIC_RELAXED);
+    uint64_t next = __atomic_load_n(&trace_next, __ATOMIC_ACQUIRE);
+    uint64_t first = next > PROFILE_TRACE_EVENTS ? next - PROFILE_TRACE_EVENTS : 0;
+    bool comma = false;
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (uint64_t n = first; n < next; n++) {
+        TraceEvent *slot = &trace[n & (PROFILE_TRACE_EVENTS - 1)];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != n + 1) continue;
+        uint64_t start = __atomic_load_n(&slot->start_ns, __ATOMIC_RELAXED);
+        uint64_t duration = __atomic_load_n(&slot->duration_ns, __ATOMIC_RELAXED);
+        uint32_t zone = __atomic_load_n(&slot->zone, __ATOMIC_RELAXED);
+        uint32_t thread = __atomic_load_n(&slot->thread, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != n + 1 || zone >= PROFILE_ZONE_COUNT) continue;
+        fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                comma ? ",\n" : "", zone_names[zone], thread, (start - start_ns) / 1e3, duration / 1e3);
+        comma = true;
+    }
+    fprintf(out, "\n]}\n");
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Failed to write trace %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+bool profile_write_csv(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return false;
+    }
+    ProfileTotals totals;
+    profile_read(&totals);
+    fprintf(out, "kind,name,calls,total_ms,mean_us,max_us,visited,moved,skipped\n");
+    for (int z = 0; z < PROFILE_ZONE_COUNT; z++) {
+        const ProfileZoneStats *s = &totals.zones[z];
+        fprintf(out, "zone,%s,%llu,%.3f,%.3f,%.3f,,,\n", zone_names[z], (unsigned long long)s->calls,
+                s->total_ns / 1e6, s->calls ? s->total_ns / 1e3 / s->calls : 0.0, s->max_ns / 1e3);
+    }
+    for (int e = 0; e < ELEMENT_COUNT; e++) {
+        const ProfileElementStats *s = &totals.elements[e];
+        double ns = s->cycles * totals.ns_per_cycle;
+        fprintf(out, "element,%s,%llu,%.3f,%.3f,,%llu,%llu,%llu\n", element_info[e].name,
+                (unsigned long long)s->visited, ns / 1e6, s->visited ? ns / 1e3 / s->visited : 0.0,
+                (unsigned long long)s->visited, (unsigned long long)s->moved, (unsigned long long)s->skipped);
+    }
+    if (fclose(out) != 0) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+#else
+
+void profile_read(ProfileTotals *out) {
+    memset(out, 0, sizeof(*out));
+}
+
+bool profile_write_trace(const char *path) {
+    (void)path;
+    return false;
+}
+
+bool profile_write_csv(const char *path) {
+    (void)path;
+    return false;
+}
+
+#endif
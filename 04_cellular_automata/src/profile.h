@@ -0,0 +1,105 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "elements.h"
+
+// Instrumentation, built only with -DPROFILE (make PROFILE=1). Zones are
+// timed with PROFILE_BEGIN/PROFILE_END pairs in one scope, which also land
+// in a ring of trace events; the cell sweep counts, per element, cells
+// visited, cells that moved or changed, cells skipped as already updated,
+// and the cycles spent in their kernel. Without PROFILE the macros expand
+// to nothing and the functions below are stubs that report nothing.
+//
+// Totals only grow; readers take differences between two reads.
+
+typedef enum {
+    PROFILE_STEP,       // whole world_step
+    PROFILE_SWEEP,      // cell kernels, every element
+    PROFILE_SUPPORT,    // labelling and dropping unsupported solid bodies
+    PROFILE_DEPTH,
+    PROFILE_LEVELLING,
+    PROFILE_THERMAL,
+    PROFILE_BRUSH,      // brush strokes applied on the sim thread
+    PROFILE_WINDOW,     // sector window moves
+    PROFILE_PUBLISH,    // copying changed tiles into a snapshot
+    PROFILE_RENDER,     // snapshot into the grid texture
+    PROFILE_DRAW,       // grid texture onto the screen
+    PROFILE_UI,
+    PROFILE_ZONE_COUNT
+} ProfileZone;
+
+typedef struct {
+    uint64_t calls;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} ProfileZoneStats;
+
+typedef struct {
+    uint64_t visited;   // kernel run (or found inert)
+    uint64_t moved;     // the cell held something else afterwards
+    uint64_t skipped;   // stamp already matched: moved in this tick
+    uint64_t cycles;    // in the kernel
+} ProfileElementStats;
+
+typedef struct {
+    ProfileZoneStats zones[PROFILE_ZONE_COUNT];
+    ProfileElementStats elements[ELEMENT_COUNT];
+    double ns_per_cycle;  // calibrated against the clock so far
+} ProfileTotals;
+
+const char *profile_zone_name(ProfileZone zone);
+void profile_read(ProfileTotals *out);
+// Chrome trace JSON (chrome://tracing, Perfetto) of the newest events, and
+// a CSV of the totals. False if profiling is compiled out or on I/O error.
+bool profile_write_trace(const char *path);
+bool profile_write_csv(const char *path);
+
+#ifdef PROFILE
+
+#define PROFILE_ENABLED 1
+#define PROFILE_TRACE_EVENTS (1 << 16)  // ring size, power of two
+
+uint64_t profile_now(void);
+void profile_zone(ProfileZone zone, uint64_t start_ns);
+void profile_add_elements(const ProfileElementStats *span);
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t profile_cycles(void) { return __rdtsc(); }
+#else
+static inline uint64_t profile_cycles(void) { return profile_now(); }
+#endif
+
+#define PROFILE_BEGIN(zone) uint64_t profile_start_##zone = profile_now()
+#define PROFILE_END(zone) profile_zone(zone, profile_start_##zone)
+
+// Per-span element counters, flushed to the totals once per span
+#define PROFILE_SPAN_BEGIN() ProfileElementStats profile_span[ELEMENT_COUNT] = { { 0 } }
+#define PROFILE_SPAN_END() profile_add_elements(profile_span)
+#define PROFILE_SKIP(type) (profile_span[(type)].skipped++)
+#define PROFILE_CELL_BEGIN(type) \
+    uint8_t profile_type = (type); \
+    uint64_t profile_cycles_start = profile_cycles()
+#define PROFILE_CELL_END(type_after) do { \
+    ProfileElementStats *profile_element = &profile_span[profile_type]; \
+    profile_element->cycles += profile_cycles() - profile_cycles_start; \
+    profile_element->visited++; \
+    profile_element->moved += (type_after) != profile_type; \
+} while (0)
+
+#else
+
+#define PROFILE_ENABLED 0
+#define PROFILE_BEGIN(zone) ((void)0)
+#define PROFILE_END(zone) ((void)0)
+#define PROFILE_SPAN_BEGIN() ((void)0)
+#define PROFILE_SPAN_END() ((void)0)
+#define PROFILE_SKIP(type) ((void)0)
+#define PROFILE_CELL_BEGIN(type) ((void)0)
+#define PROFILE_CELL_END(type_after) ((void)0)
+
+#endif
+
+#endif
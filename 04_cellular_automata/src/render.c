@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include "render.h"
+#include "chunk.h"
+
+#define min(a,b) ((a) < (b) ? (a) : (b))
+
+// Base colour from the element table, reddened with temperature above the
+// element's glow point
+static Color cell_color(Element type, int temperature) {
+    const ElementInfo *info = &element_info[type];
+    Color color = { info->r, info->g, info->b, 255 };
+    if (info->glow_point && temperature > info->glow_point) {
+        color.r = min(255, color.r + (temperature - info->glow_point) / 2);
+    }
+    return color;
+}
+
+Renderer *renderer_create(int rows, int cols) {
+    Renderer *renderer = (Renderer *)calloc(1, sizeof(Renderer));
+    if (!renderer) return NULL;
+
+    renderer->rows = rows;
+    renderer->cols = cols;
+    renderer->tiles_x = (cols + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    renderer->tiles_y = (rows + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    renderer->band = (Color *)malloc((size_t)cols * CHUNK_SIZE * sizeof(Color));
+    if (!renderer->band) {
+        TraceLog(LOG_ERROR, "Failed to allocate render buffer");
+        free(renderer);
+        return NULL;
+    }
+
+    for (int e = 0; e < ELEMENT_COUNT; e++) {
+        for (int t = 0; t < COLOR_LUT_TEMPS; t++) {
+            renderer->lut[e][t] = cell_color((Element)e, t + MIN_TEMPERATURE);
+        }
+    }
+
+    Image image = GenImageColor(cols, rows, WHITE);
+    renderer->texture = LoadTextureFromImage(image);
+    UnloadImage(image);
+    return renderer;
+}
+
+void renderer_destroy(Renderer *renderer) {
+    if (!renderer) return;
+    UnloadTexture(renderer->texture);
+    free(renderer->band);
+    free(renderer);
+}
+
+void renderer_update(Renderer *renderer, const Snapshot *snap) {
+    if (snap->seq == renderer->drawn_seq && !renderer->invalid) return;
+
+    for (int ty = 0; ty < renderer->tiles_y; ty++) {
+        const uint64_t *tile_seq = &snap->tile_seq[ty * renderer->tiles_x];
+
+        // One upload per tile row, covering the first to the last changed tile
+        int tx0 = 0;
+        int tx1 = renderer->tiles_x - 1;
+        if (!renderer->invalid) {
+            while (tx0 <= tx1 && tile_seq[tx0] <= renderer->drawn_seq) tx0++;
+            while (tx1 >= tx0 && tile_seq[tx1] <= renderer->drawn_seq) tx1--;
+            if (tx0 > tx1) continue;
+        }
+
+        int x0 = tx0 * CHUNK_SIZE;
+        int x1 = min((tx1 + 1) * CHUNK_SIZE, renderer->cols);
+        int y0 = ty * CHUNK_SIZE;
+        int y1 = min(y0 + CHUNK_SIZE, renderer->rows);
+        int width = x1 - x0;
+
+        for (int y = y0; y < y1; y++) {
+            Color *out = &renderer->band[(y - y0) * width];
+            int idx = y * renderer->cols + x0;
+            for (int x = 0; x < width; x++, idx++) {
+                out[x] = renderer->lut[snap->type[idx]][snap->temperature[idx] - MIN_TEMPERATURE];
+            }
+        }
+
+        Rectangle rec = { (float)x0, (float)y0, (float)width, (float)(y1 - y0) };
+        UpdateTextureRec(renderer->texture, rec, renderer->band);
+    }
+    renderer->drawn_seq = snap->seq;
+    renderer->invalid = false;
+}
+
+void renderer_update_tile(Renderer *renderer, int tile, const uint8_t *type, const int16_t *temperature) {
+    int x0 = tile % renderer->tiles_x * CHUNK_SIZE;
+    int y0 = tile / renderer->tiles_x * CHUNK_SIZE;
+    int width = min(CHUNK_SIZE, renderer->cols - x0);
+    int height = min(CHUNK_SIZE, renderer->rows - y0);
+
+    // Planes come from another process, so clamp instead of trusting them
+    for (int y = 0; y < height; y++) {
+        Color *out = &renderer->band[y * width];
+        for (int x = 0; x < width; x++) {
+            int i = y * CHUNK_SIZE + x;
+            int e = type[i] < ELEMENT_COUNT ? type[i] : NONE;
+            int t = temperature[i] < MIN_TEMPERATURE ? MIN_TEMPERATURE
+                  : temperature[i] > MAX_TEMPERATURE ? MAX_TEMPERATURE : temperature[i];
+            out[x] = renderer->lut[e][t - MIN_TEMPERATURE];
+        }
+    }
+
+    Rectangle rec = { (float)x0, (float)y0, (float)width, (float)height };
+    UpdateTextureRec(renderer->texture, rec, renderer->band);
+}
+
+void renderer_invalidate(Renderer *renderer) {
+    renderer->invalid = true;
+}
+
+void renderer_draw(const Renderer *renderer, int x, int y, int cell_size) {
+    DrawTextureEx(renderer->texture, (Vector2){ (float)x, (float)y }, 0.0f, (float)cell_size, WHITE);
+}
+
+void renderer_draw_region(const Renderer *renderer, int src_x, int src_y, int width, int height,
+                          int x, int y, int cell_size) {
+    int x0 = src_x < 0 ? 0 : src_x;
+    int y0 = src_y < 0 ? 0 : src_y;
+    int x1 = min(src_x + width, renderer->cols);
+    int y1 = min(src_y + height, renderer->rows);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    Rectangle source = { (float)x0, (float)y0, (float)(x1 - x0), (float)(y1 - y0) };
+    Rectangle dest = { (float)(x + (x0 - src_x) * cell_size), (float)(y + (y0 - src_y) * cell_size),
+                       (float)((x1 - x0) * cell_size), (float)((y1 - y0) * cell_size) };
+    DrawTexturePro(renderer->texture, source, dest, (Vector2){ 0.0f, 0.0f }, 0.0f, WHITE);
+}
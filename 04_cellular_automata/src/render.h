@@ -0,0 +1,43 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "raylib.h"
+#include "sim.h"
+#include "runner.h"
+
+// Draws the grid as one texture with a texel per cell. Colours come from a
+// lookup table indexed by element and temperature, and only tiles that
+// changed since the last drawn snapshot are rebuilt and re-uploaded.
+
+#define COLOR_LUT_TEMPS (MAX_TEMPERATURE - MIN_TEMPERATURE + 1)
+
+typedef struct Renderer {
+    int rows;
+    int cols;
+    int tiles_x;
+    int tiles_y;
+    uint64_t drawn_seq;  // snapshot sequence currently in the texture
+    bool invalid;        // texture shows another source, redraw every tile
+    Texture2D texture;
+    Color *band;       // pixels for one row of tiles, packed to the dirty span
+    Color lut[ELEMENT_COUNT][COLOR_LUT_TEMPS];
+} Renderer;
+
+Renderer *renderer_create(int rows, int cols);
+void renderer_destroy(Renderer *renderer);
+
+// Re-uploads the tiles the snapshot changed after drawn_seq
+void renderer_update(Renderer *renderer, const Snapshot *snap);
+// Recolours and uploads one tile from packed CHUNK_SIZE x CHUNK_SIZE planes,
+// as carried by a frame stream (stream.h)
+void renderer_update_tile(Renderer *renderer, int tile, const uint8_t *type, const int16_t *temperature);
+// Call when switching to snapshots from another source; the next update
+// then redraws every tile
+void renderer_invalidate(Renderer *renderer);
+void renderer_draw(const Renderer *renderer, int x, int y, int cell_size);
+// Draws only the width x height cells starting at grid cell (src_x, src_y),
+// clipped to the grid
+void renderer_draw_region(const Renderer *renderer, int src_x, int src_y, int width, int height,
+                          int x, int y, int cell_size);
+
+#endif
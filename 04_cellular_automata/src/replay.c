@@ -0,0 +1,283 @@
+#include <stdlib.h>
+#include <string.h>
+#include "replay.h"
+
+#define STROKE_CONTINUES 0x10  // starts where the previous stroke ended
+#define STROKE_SAME_PEN 0x20   // same radius and element as the previous one
+#define KIND_MASK 0x0F
+#define EVENT_BOUND 48         // largest encoded event
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    ENCODING    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static size_t put_varint(uint8_t *out, uint64_t v) {
+    size_t n = 0;
+    for (; v >= 0x80; v >>= 7) out[n++] = (uint8_t)(v | 0x80);
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static size_t put_zigzag(uint8_t *out, int64_t v) {
+    return put_varint(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static size_t put_u32(uint8_t *out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out[i] = (uint8_t)(v >> (8 * i));
+    return 4;
+}
+
+static size_t put_float(uint8_t *out, float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return put_u32(out, bits);
+}
+
+static bool get_varint(FILE *in, uint64_t *v) {
+    *v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc(in);
+        if (byte == EOF) return false;
+        *v |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+static bool get_zigzag(FILE *in, int64_t *v) {
+    uint64_t u;
+    if (!get_varint(in, &u)) return false;
+    *v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+    return true;
+}
+
+static bool get_u32(FILE *in, uint32_t *v) {
+    uint8_t b[4];
+    if (fread(b, 1, 4, in) != 4) return false;
+    *v = (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+    return true;
+}
+
+static bool get_float(FILE *in, float *f) {
+    uint32_t bits;
+    if (!get_u32(in, &bits)) return false;
+    memcpy(f, &bits, sizeof(bits));
+    return true;
+}
+
+static bool same_bits(float a, float b) {
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    RECORDING    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Recorder *recorder_create(const char *path, const World *world, const SectorMap *sectors,
+                          Scenario scenario, uint32_t checksum_interval) {
+    Recorder *recorder = (Recorder *)calloc(1, sizeof(Recorder));
+    if (!recorder) return NULL;
+    recorder->file = fopen(path, "wb");
+    if (!recorder->file) {
+        fprintf(stderr, "Failed to open %s for recording\n", path);
+        free(recorder);
+        return NULL;
+    }
+    recorder->checksum_interval = checksum_interval;
+    recorder->tick = world->tick;
+
+    ReplayHeader h = { 0 };
+    memcpy(h.magic, REPLAY_MAGIC, sizeof(h.magic));
+    h.version = REPLAY_VERSION;
+    h.header_bytes = sizeof(ReplayHeader);
+    h.seed = world->seed;
+    h.rows = world->rows;
+    h.cols = world->cols;
+    h.scenario = scenario;
+    h.threads = world->threads;
+    h.chunking = world->chunking;
+    h.levelling = world->levelling;
+    if (sectors) {
+        h.sectors = 1;
+        h.window_w = sectors->window_w;
+        h.window_h = sectors->window_h;
+        h.window_sx = sectors->window_sx;
+        h.window_sy = sectors->window_sy;
+    }
+    h.checksum_interval = checksum_interval;
+    h.start_tick = world->tick;
+    if (fwrite(&h, sizeof(h), 1, recorder->file) != 1) recorder->failed = true;
+    return recorder;
+}
+
+static void write_event(Recorder *recorder, uint8_t kind, uint64_t tick, const uint8_t *payload, size_t bytes) {
+    if (recorder->failed) return;
+    uint8_t event[EVENT_BOUND];
+    size_t n = 0;
+    event[n++] = kind;
+    n += put_zigzag(&event[n], (int64_t)(tick - recorder->tick));
+    if (bytes) memcpy(&event[n], payload, bytes);
+    n += bytes;
+    if (fwrite(event, 1, n, recorder->file) != n) {
+        fprintf(stderr, "Recording stopped, write failed\n");
+        recorder->failed = true;
+        return;
+    }
+    recorder->tick = tick;
+    recorder->events++;
+}
+
+void recorder_brush(Recorder *recorder, uint64_t tick, const BrushStroke *s) {
+    uint8_t payload[EVENT_BOUND];
+    size_t n = 0;
+    uint8_t kind = REPLAY_BRUSH;
+    const BrushStroke *last = &recorder->last;
+    if (recorder->has_last && same_bits(s->x0, last->x1) && same_bits(s->y0, last->y1)) {
+        kind |= STROKE_CONTINUES;
+    } else {
+        n += put_float(&payload[n], s->x0);
+        n += put_float(&payload[n], s->y0);
+    }
+    n += put_float(&payload[n], s->x1);
+    n += put_float(&payload[n], s->y1);
+    if (recorder->has_last && same_bits(s->radius, last->radius) && s->element == last->element) {
+        kind |= STROKE_SAME_PEN;
+    } else {
+        n += put_float(&payload[n], s->radius);
+        payload[n++] = (uint8_t)s->element;
+    }
+    write_event(recorder, kind, tick, payload, n);
+    recorder->last = *s;
+    recorder->has_last = true;
+}
+
+void recorder_running(Recorder *recorder, uint64_t tick, bool running) {
+    uint8_t payload = running;
+    write_event(recorder, REPLAY_RUNNING, tick, &payload, 1);
+}
+
+void recorder_window(Recorder *recorder, uint64_t tick, int32_t sx, int32_t sy) {
+    uint8_t payload[20];
+    size_t n = put_zigzag(payload, sx);
+    n += put_zigzag(&payload[n], sy);
+    write_event(recorder, REPLAY_WINDOW, tick, payload, n);
+}
+
+void recorder_load(Recorder *recorder, uint64_t tick) {
+    write_event(recorder, REPLAY_LOAD, tick, NULL, 0);
+}
+
+static void write_checksum(Recorder *recorder, uint8_t kind, const World *world) {
+    uint64_t sum = world_checksum(world);
+    uint8_t payload[8];
+    put_u32(payload, (uint32_t)sum);
+    put_u32(&payload[4], (uint32_t)(sum >> 32));
+    write_event(recorder, kind, world->tick, payload, sizeof(payload));
+}
+
+void recorder_step(Recorder *recorder, const World *world) {
+    if (recorder->checksum_interval && world->tick % recorder->checksum_interval == 0) {
+        write_checksum(recorder, REPLAY_CHECKSUM, world);
+    }
+}
+
+void recorder_close(Recorder *recorder, const World *world) {
+    if (!recorder) return;
+    write_checksum(recorder, REPLAY_END, world);
+    if (fclose(recorder->file) != 0 && !recorder->failed) fprintf(stderr, "Failed to finish recording\n");
+    free(recorder);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    REPLAY    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ReplayLog *replay_open(const char *path) {
+    ReplayLog *log = (ReplayLog *)calloc(1, sizeof(ReplayLog));
+    if (!log) return NULL;
+    log->file = fopen(path, "rb");
+    if (!log->file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        free(log);
+        return NULL;
+    }
+    ReplayHeader *h = &log->header;
+    bool ok = fread(h, sizeof(*h), 1, log->file) == 1 && memcmp(h->magic, REPLAY_MAGIC, sizeof(h->magic)) == 0;
+    if (ok && (h->version != REPLAY_VERSION || h->header_bytes < sizeof(*h))) {
+        fprintf(stderr, "%s is recording version %u, this build reads version %d\n", path, h->version, REPLAY_VERSION);
+        replay_close(log);
+        return NULL;
+    }
+    ok = ok && h->rows > 0 && h->cols > 0 && h->scenario >= 0 && h->scenario < SCENARIO_COUNT &&
+         fseek(log->file, (long)h->header_bytes, SEEK_SET) == 0;
+    if (!ok) {
+        fprintf(stderr, "%s is not a recording\n", path);
+        replay_close(log);
+        return NULL;
+    }
+    log->tick = h->start_tick;
+    return log;
+}
+
+void replay_close(ReplayLog *log) {
+    if (!log) return;
+    fclose(log->file);
+    free(log);
+}
+
+static bool read_stroke(ReplayLog *log, int flags, BrushStroke *s) {
+    bool ok = true;
+    if (flags & STROKE_CONTINUES) {
+        s->x0 = log->last.x1;
+        s->y0 = log->last.y1;
+    } else {
+        ok = get_float(log->file, &s->x0) && get_float(log->file, &s->y0);
+    }
+    ok = ok && get_float(log->file, &s->x1) && get_float(log->file, &s->y1);
+    if (flags & STROKE_SAME_PEN) {
+        s->radius = log->last.radius;
+        s->element = log->last.element;
+    } else {
+        int element;
+        ok = ok && get_float(log->file, &s->radius) && (element = fgetc(log->file)) != EOF &&
+             element < ELEMENT_COUNT;
+        if (ok) s->element = (Element)element;
+    }
+    if (ok) log->last = *s;
+    return ok;
+}
+
+bool replay_next(ReplayLog *log, ReplayEvent *event) {
+    int kind = fgetc(log->file);
+    if (kind == EOF) return false;
+
+    int64_t delta;
+    bool ok = get_zigzag(log->file, &delta) && (kind & KIND_MASK) < REPLAY_KIND_COUNT;
+    memset(event, 0, sizeof(*event));
+    event->kind = (ReplayKind)(kind & KIND_MASK);
+    event->tick = log->tick + (uint64_t)delta;
+    int64_t sx = 0, sy = 0;
+    uint32_t lo = 0, hi = 0;
+    int running = 0;
+    switch (ok ? event->kind : REPLAY_KIND_COUNT) {
+        case REPLAY_BRUSH:
+            ok = read_stroke(log, kind, &event->stroke);
+            break;
+        case REPLAY_RUNNING:
+            ok = (running = fgetc(log->file)) != EOF;
+            event->running = running == 1;
+            break;
+        case REPLAY_WINDOW:
+            ok = get_zigzag(log->file, &sx) && get_zigzag(log->file, &sy);
+            event->sx = (int32_t)sx;
+            event->sy = (int32_t)sy;
+            break;
+        case REPLAY_CHECKSUM:
+        case REPLAY_END:
+            ok = get_u32(log->file, &lo) && get_u32(log->file, &hi);
+            event->checksum = (uint64_t)hi << 32 | lo;
+            break;
+        case REPLAY_LOAD:
+            break;
+        default:
+            ok = false;
+            break;
+    }
+    if (!ok) {
+        log->failed = true;
+        return false;
+    }
+    log->tick = event->tick;
+    return true;
+}
@@ -0,0 +1,103 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim.h"
+#include "brush.h"
+#include "sector.h"
+
+// Input recording. Everything that changes a world from outside world_step
+// is logged on the sim thread, tagged with the tick it was applied before:
+// brush strokes exactly as painted, pause toggles and window moves. Given
+// the header's seed and setup, the log replays to the same grid, and the
+// grid checksum logged every checksum_interval ticks pins down the first
+// tick where a replay diverges.
+//
+// Layout: ReplayHeader, then events of one kind byte, a zigzag varint tick
+// delta and a payload. Strokes carry only what differs from the previous
+// one: a drag's start is where the last stroke ended, and radius and
+// element rarely change.
+
+#define REPLAY_MAGIC "FSANDREC"
+#define REPLAY_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_bytes;  // sizeof(ReplayHeader) when written
+    uint32_t seed;
+    int32_t rows;
+    int32_t cols;
+    int32_t scenario;       // what the world was loaded with before tick 0
+    int32_t threads;        // world_set_threads argument
+    uint8_t chunking;
+    uint8_t levelling;
+    uint8_t sectors;        // 1 if the world is a window onto a SectorMap
+    uint8_t reserved;
+    int32_t window_w;
+    int32_t window_h;
+    int32_t window_sx;
+    int32_t window_sy;
+    uint32_t checksum_interval;
+    uint64_t start_tick;
+} ReplayHeader;
+
+typedef enum {
+    REPLAY_BRUSH,
+    REPLAY_RUNNING,   // pause toggle
+    REPLAY_WINDOW,    // window moved to (sx, sy)
+    REPLAY_CHECKSUM,  // world_checksum once `tick` ticks are done
+    REPLAY_LOAD,      // a snapshot was loaded; the log cannot go past this
+    REPLAY_END,
+    REPLAY_KIND_COUNT
+} ReplayKind;
+
+typedef struct {
+    ReplayKind kind;
+    uint64_t tick;
+    BrushStroke stroke;
+    bool running;
+    int32_t sx, sy;
+    uint64_t checksum;
+} ReplayEvent;
+
+typedef struct {
+    FILE *file;
+    uint32_t checksum_interval;
+    uint64_t tick;      // tick of the last event
+    BrushStroke last;   // previous stroke, for delta coding
+    bool has_last;
+    uint64_t events;
+    bool failed;        // a write failed, the rest is dropped
+} Recorder;
+
+// Starts a log of `world`, which must be as `scenario` left it at its
+// current tick. `sectors` may be NULL.
+Recorder *recorder_create(const char *path, const World *world, const SectorMap *sectors,
+                          Scenario scenario, uint32_t checksum_interval);
+// Writes the final checksum and closes the log
+void recorder_close(Recorder *recorder, const World *world);
+
+void recorder_brush(Recorder *recorder, uint64_t tick, const BrushStroke *stroke);
+void recorder_running(Recorder *recorder, uint64_t tick, bool running);
+void recorder_window(Recorder *recorder, uint64_t tick, int32_t sx, int32_t sy);
+void recorder_load(Recorder *recorder, uint64_t tick);
+// Call after every world_step
+void recorder_step(Recorder *recorder, const World *world);
+
+typedef struct {
+    FILE *file;
+    ReplayHeader header;
+    uint64_t tick;
+    BrushStroke last;
+    bool failed;  // the log is corrupt or cut short
+} ReplayLog;
+
+ReplayLog *replay_open(const char *path);
+void replay_close(ReplayLog *log);
+// False at the end of the log, or on a bad event (then log->failed)
+bool replay_next(ReplayLog *log, ReplayEvent *event);
+
+#endif
@@ -0,0 +1,41 @@
+#include <string.h>
+#include "rle.h"
+
+size_t rle_encode(const void *src, size_t count, size_t width, uint8_t *out) {
+    const uint8_t *in = (const uint8_t *)src;
+    size_t n = 0;
+    size_t i = 0;
+    while (i < count) {
+        size_t run = 1;
+        while (i + run < count && memcmp(&in[(i + run) * width], &in[i * width], width) == 0) run++;
+
+        for (size_t r = run; ; r >>= 7) {
+            out[n++] = (uint8_t)((r & 0x7F) | (r >= 0x80 ? 0x80 : 0));
+            if (r < 0x80) break;
+        }
+        memcpy(&out[n], &in[i * width], width);
+        n += width;
+        i += run;
+    }
+    return n;
+}
+
+size_t rle_decode(const uint8_t *src, size_t src_bytes, void *dst, size_t count, size_t width) {
+    uint8_t *out = (uint8_t *)dst;
+    size_t n = 0;
+    size_t i = 0;
+    while (i < count) {
+        size_t run = 0;
+        for (int shift = 0; ; shift += 7) {
+            if (n >= src_bytes || shift > 28) return 0;
+            uint8_t byte = src[n++];
+            run |= (size_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        if (run == 0 || run > count - i || n + width > src_bytes) return 0;
+        for (size_t r = 0; r < run; r++) memcpy(&out[(i + r) * width], &src[n], width);
+        n += width;
+        i += run;
+    }
+    return n;
+}
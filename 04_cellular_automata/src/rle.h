@@ -0,0 +1,23 @@
+#ifndef RLE_H
+#define RLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Run-length coding of fixed-width elements. The output is a list of
+// (varint run length, element bytes) pairs, which suits the cell planes:
+// long runs of empty space, ambient temperature and zero velocity.
+
+// Largest output rle_encode can produce for `count` elements
+static inline size_t rle_bound(size_t count, size_t width) {
+    return count * (width + 5);
+}
+
+// Returns the number of bytes written to `out`
+size_t rle_encode(const void *src, size_t count, size_t width, uint8_t *out);
+// Decodes exactly `count` elements. Returns the number of input bytes
+// consumed, or 0 if `src` is truncated or does not add up to `count`.
+size_t rle_decode(const uint8_t *src, size_t src_bytes, void *dst, size_t count, size_t width);
+
+#endif
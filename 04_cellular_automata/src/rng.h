@@ -0,0 +1,53 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// Counter-based RNG. Every draw is a pure function of (seed, tick, cell,
+// draw), so kernels need no shared state, any visiting order or thread
+// count gives the same numbers, and a vectorised kernel can compute a whole
+// row of draws at once.
+//
+// The mixer is Widynski's Squares (four rounds, 32-bit output). The seed is
+// turned into a key once, and that key is combined with the tick once per
+// tick, leaving one squaring chain per draw.
+
+static inline uint64_t rng_splitmix(uint64_t z) {
+    z += 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Squares wants an odd key with well-mixed nibbles
+static inline uint64_t rng_key(uint64_t seed) {
+    return rng_splitmix(seed) | 1;
+}
+
+static inline uint64_t rng_tick_key(uint64_t key, uint64_t tick) {
+    return rng_splitmix(key ^ rng_splitmix(tick)) | 1;
+}
+
+// `draw` tells apart several decisions made for the same cell in one tick
+static inline uint32_t rng_u32(uint64_t tick_key, uint32_t cell, uint32_t draw) {
+    uint64_t ctr = ((uint64_t)cell << 8) | (draw & 0xFF);
+    uint64_t x = ctr * tick_key;
+    uint64_t y = x;
+    uint64_t z = y + tick_key;
+    x = x * x + y; x = (x >> 32) | (x << 32);
+    x = x * x + z; x = (x >> 32) | (x << 32);
+    x = x * x + y; x = (x >> 32) | (x << 32);
+    return (uint32_t)((x * x + z) >> 32);
+}
+
+// Uniform in [0, 1)
+static inline float rng_unit(uint64_t tick_key, uint32_t cell, uint32_t draw) {
+    return (rng_u32(tick_key, cell, draw) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Uniform in [0, n), multiply-shift instead of a modulo
+static inline uint32_t rng_below(uint64_t tick_key, uint32_t cell, uint32_t draw, uint32_t n) {
+    return (uint32_t)(((uint64_t)rng_u32(tick_key, cell, draw) * n) >> 32);
+}
+
+#endif
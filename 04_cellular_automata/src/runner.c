@@ -0,0 +1,322 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "runner.h"
+#include "chunk.h"
+#include "profile.h"
+
+#define SNAPSHOT_FRESH 4         // set in `latest` until the reader takes it
+#define POLL_NS 4000000ULL       // longest the sim thread sleeps between brush drains
+#define MAX_CATCH_UP_TICKS 4     // beyond this the clock is reset instead of bursting
+#define PAGE_CHECK_TICKS 64      // how often settled sectors are considered for paging
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_ns(uint64_t ns) {
+    struct timespec ts = { (time_t)(ns / 1000000000ULL), (long)(ns % 1000000000ULL) };
+    nanosleep(&ts, NULL);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~    BRUSH QUEUE    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool runner_push_brush(SimRunner *runner, const BrushStroke *stroke) {
+    BrushQueue *queue = &runner->brushes;
+    uint32_t head = queue->head;
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= BRUSH_QUEUE_SIZE) return false;
+
+    queue->events[head & (BRUSH_QUEUE_SIZE - 1)] = *stroke;
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static void drain_brushes(SimRunner *runner) {
+    BrushQueue *queue = &runner->brushes;
+    uint32_t tail = queue->tail;
+    uint32_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    if (tail == head) return;
+    PROFILE_BEGIN(PROFILE_BRUSH);
+
+    // Strokes come in plane cells, the world starts at the window's corner
+    float origin_x = 0.0f;
+    float origin_y = 0.0f;
+    if (runner->sectors) {
+        origin_x = (float)runner->sectors->window_sx * SECTOR_SIZE;
+        origin_y = (float)runner->sectors->window_sy * SECTOR_SIZE;
+    }
+    for (; tail != head; tail++) {
+        BrushStroke stroke = queue->events[tail & (BRUSH_QUEUE_SIZE - 1)];
+        stroke.x0 -= origin_x;
+        stroke.x1 -= origin_x;
+        stroke.y0 -= origin_y;
+        stroke.y1 -= origin_y;
+        if (runner->recorder) recorder_brush(runner->recorder, runner->world->tick, &stroke);
+        brush_paint(runner->world, &stroke);
+    }
+    __atomic_store_n(&queue->tail, tail, __ATOMIC_RELEASE);
+    PROFILE_END(PROFILE_BRUSH);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~    WINDOW    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static inline uint64_t pack_window(int32_t sx, int32_t sy) {
+    return (uint64_t)(uint32_t)sx << 32 | (uint32_t)sy;
+}
+
+void runner_set_window(SimRunner *runner, int32_t sx, int32_t sy) {
+    __atomic_store_n(&runner->window_request, pack_window(sx, sy), __ATOMIC_RELAXED);
+}
+
+static void apply_window(SimRunner *runner) {
+    SectorMap *sectors = runner->sectors;
+    uint64_t request = __atomic_load_n(&runner->window_request, __ATOMIC_RELAXED);
+    if (request == pack_window(sectors->window_sx, sectors->window_sy)) return;
+
+    if (runner->recorder) {
+        recorder_window(runner->recorder, runner->world->tick, (int32_t)(request >> 32), (int32_t)(uint32_t)request);
+    }
+    PROFILE_BEGIN(PROFILE_WINDOW);
+    sector_map_move_window(sectors, runner->world, (int32_t)(request >> 32), (int32_t)(uint32_t)request);
+    sector_map_page_out(sectors, runner->world->tick);
+    PROFILE_END(PROFILE_WINDOW);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~    SAVING    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool runner_enable_saves(SimRunner *runner, const char *path, uint64_t autosave_ticks) {
+    if (!runner->sectors || runner->save_path) return false;
+    runner->save_path = strdup(path);
+    if (!runner->save_path) return false;
+    runner->autosave_ticks = autosave_ticks;
+    __atomic_store_n(&runner->saves_enabled, true, __ATOMIC_RELEASE);
+    return true;
+}
+
+void runner_request_save(SimRunner *runner) {
+    __atomic_store_n(&runner->save_request, true, __ATOMIC_RELAXED);
+}
+
+void runner_request_load(SimRunner *runner) {
+    __atomic_store_n(&runner->load_request, true, __ATOMIC_RELAXED);
+}
+
+SaveStatus runner_save_status(SimRunner *runner) {
+    return (SaveStatus)__atomic_load_n(&runner->save_status, __ATOMIC_RELAXED);
+}
+
+static void set_save_status(SimRunner *runner, SaveStatus status) {
+    __atomic_store_n(&runner->save_status, (int)status, __ATOMIC_RELAXED);
+}
+
+static void finish_save(SimRunner *runner) {
+    bool ok = save_end(runner->sectors, runner->save_job);
+    runner->save_job = NULL;
+    set_save_status(runner, ok ? SAVE_STATUS_SAVED : SAVE_STATUS_FAILED);
+}
+
+// Reaps a finished save and starts requested ones. Only a load waits for a
+// save still being written, since it replaces the map under it.
+static void service_saves(SimRunner *runner) {
+    World *world = runner->world;
+    SectorMap *sectors = runner->sectors;
+    if (runner->save_job && save_finished(runner->save_job)) finish_save(runner);
+
+    if (__atomic_exchange_n(&runner->load_request, false, __ATOMIC_RELAXED)) {
+        if (runner->save_job) finish_save(runner);
+        if (runner->recorder) recorder_load(runner->recorder, world->tick);
+        bool ok = save_load(runner->save_path, sectors, world);
+        __atomic_store_n(&runner->window_request, pack_window(sectors->window_sx, sectors->window_sy),
+                         __ATOMIC_RELAXED);
+        runner->last_save_tick = world->tick;
+        set_save_status(runner, ok ? SAVE_STATUS_LOADED : SAVE_STATUS_FAILED);
+        if (ok) runner->loads++;
+    }
+
+    if (runner->save_job) return;
+    bool due = runner->autosave_ticks && world->tick - runner->last_save_tick >= runner->autosave_ticks;
+    if (__atomic_exchange_n(&runner->save_request, false, __ATOMIC_RELAXED) || due) {
+        runner->save_job = save_begin(sectors, world, runner->save_path);
+        runner->last_save_tick = world->tick;
+        set_save_status(runner, runner->save_job ? SAVE_STATUS_SAVING : SAVE_STATUS_FAILED);
+    }
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~    SNAPSHOTS    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void copy_tile(SimRunner *runner, Snapshot *snap, int tile) {
+    const World *world = runner->world;
+    int x0 = tile % runner->tiles_x * CHUNK_SIZE;
+    int y0 = tile / runner->tiles_x * CHUNK_SIZE;
+    int width = x0 + CHUNK_SIZE <= runner->cols ? CHUNK_SIZE : runner->cols - x0;
+    int y1 = y0 + CHUNK_SIZE <= runner->rows ? y0 + CHUNK_SIZE : runner->rows;
+
+    for (int y = y0; y < y1; y++) {
+        int src = world_index(world, x0, y);
+        int dst = y * runner->cols + x0;
+        memcpy(&snap->type[dst], &world->grid.type[src], width * sizeof(uint8_t));
+        memcpy(&snap->temperature[dst], &world->grid.temperature[src], width * sizeof(int16_t));
+    }
+}
+
+// Stamps the tiles changed since the last publish, brings the back buffer up
+// to date by copying only tiles newer than what it already holds, and swaps
+// it with the shared slot.
+static void publish(SimRunner *runner) {
+    ChunkMap *chunks = runner->world->chunks;
+    int tiles = runner->tiles_x * runner->tiles_y;
+
+    bool changed = false;
+    for (int t = 0; t < tiles; t++) {
+        if (!(chunks->render_dirty[t] & CHUNK_DIRTY_RENDER)) continue;
+        chunks->render_dirty[t] &= ~CHUNK_DIRTY_RENDER;
+        runner->tile_seq[t] = runner->seq + 1;
+        changed = true;
+    }
+    if (!changed) return;
+    runner->seq++;
+    PROFILE_BEGIN(PROFILE_PUBLISH);
+
+    Snapshot *snap = &runner->snapshots[runner->back];
+    for (int t = 0; t < tiles; t++) {
+        if (runner->tile_seq[t] > snap->seq) copy_tile(runner, snap, t);
+    }
+    memcpy(snap->tile_seq, runner->tile_seq, tiles * sizeof(uint64_t));
+    snap->seq = runner->seq;
+    snap->tick = runner->world->tick;
+    snap->loads = runner->loads;
+    if (runner->sectors) {
+        snap->origin_x = (int64_t)runner->sectors->window_sx * SECTOR_SIZE;
+        snap->origin_y = (int64_t)runner->sectors->window_sy * SECTOR_SIZE;
+    }
+
+    int previous = __atomic_exchange_n(&runner->latest, runner->back | SNAPSHOT_FRESH, __ATOMIC_ACQ_REL);
+    runner->back = previous & ~SNAPSHOT_FRESH;
+    PROFILE_END(PROFILE_PUBLISH);
+}
+
+const Snapshot *runner_acquire_snapshot(SimRunner *runner) {
+    if (__atomic_load_n(&runner->latest, __ATOMIC_ACQUIRE) & SNAPSHOT_FRESH) {
+        int previous = __atomic_exchange_n(&runner->latest, runner->front, __ATOMIC_ACQ_REL);
+        runner->front = previous & ~SNAPSHOT_FRESH;
+    }
+    return &runner->snapshots[runner->front];
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~    SIM THREAD    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void *sim_main(void *arg) {
+    SimRunner *runner = (SimRunner *)arg;
+    uint64_t next_tick = now_ns();
+
+    while (!__atomic_load_n(&runner->quit, __ATOMIC_ACQUIRE)) {
+        if (__atomic_load_n(&runner->saves_enabled, __ATOMIC_ACQUIRE)) service_saves(runner);
+        if (runner->sectors) apply_window(runner);
+        drain_brushes(runner);
+
+        uint64_t now = now_ns();
+        bool running = __atomic_load_n(&runner->running, __ATOMIC_RELAXED);
+        if (runner->recorder && running != runner->was_running) {
+            recorder_running(runner->recorder, runner->world->tick, running);
+        }
+        runner->was_running = running;
+        if (!running) {
+            next_tick = now;
+        } else if (now >= next_tick) {
+            world_step(runner->world);
+            if (runner->recorder) recorder_step(runner->recorder, runner->world);
+            if (runner->sectors && runner->world->tick % PAGE_CHECK_TICKS == 0) {
+                sector_map_page_out(runner->sectors, runner->world->tick);
+            }
+            next_tick += runner->tick_ns;
+            // A slow tick is absorbed by the following ones; a long stall
+            // restarts the clock rather than bursting through the backlog
+            if (now > next_tick + MAX_CATCH_UP_TICKS * runner->tick_ns) next_tick = now;
+        }
+        publish(runner);
+
+        now = now_ns();
+        if (next_tick > now) {
+            uint64_t wait = next_tick - now;
+            sleep_ns(wait < POLL_NS ? wait : POLL_NS);
+        } else if (!__atomic_load_n(&runner->running, __ATOMIC_RELAXED)) {
+            sleep_ns(POLL_NS);
+        }
+    }
+    return NULL;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~    LIFECYCLE    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+SimRunner *runner_create(World *world, SectorMap *sectors, Recorder *recorder, int tick_hz) {
+    SimRunner *runner = (SimRunner *)calloc(1, sizeof(SimRunner));
+    if (!runner) return NULL;
+
+    runner->world = world;
+    runner->sectors = sectors;
+    runner->recorder = recorder;
+    if (sectors) runner->window_request = pack_window(sectors->window_sx, sectors->window_sy);
+    runner->rows = world->rows;
+    runner->cols = world->cols;
+    runner->tiles_x = world->chunks->tiles_x;
+    runner->tiles_y = world->chunks->tiles_y;
+    runner->tick_ns = 1000000000ULL / (uint64_t)(tick_hz > 0 ? tick_hz : 1);
+    runner->running = true;
+    runner->was_running = true;
+
+    size_t cells = (size_t)world->rows * world->cols;
+    int tiles = runner->tiles_x * runner->tiles_y;
+    bool ok = (runner->tile_seq = (uint64_t *)calloc(tiles, sizeof(uint64_t))) != NULL;
+    for (int i = 0; i < 3 && ok; i++) {
+        Snapshot *snap = &runner->snapshots[i];
+        snap->type = (uint8_t *)malloc(cells * sizeof(uint8_t));
+        snap->temperature = (int16_t *)malloc(cells * sizeof(int16_t));
+        snap->tile_seq = (uint64_t *)calloc(tiles, sizeof(uint64_t));
+        ok = snap->type && snap->temperature && snap->tile_seq;
+    }
+    if (!ok) {
+        fprintf(stderr, "Failed to allocate snapshots\n");
+        runner_destroy(runner);
+        return NULL;
+    }
+
+    // Publish the starting state so the reader always has a frame
+    runner->back = 0;
+    runner->front = 1;
+    runner->latest = 2;
+    chunks_mark_all(world->chunks);
+    publish(runner);
+
+    if (pthread_create(&runner->thread, NULL, sim_main, runner) != 0) {
+        fprintf(stderr, "Failed to start simulation thread\n");
+        runner_destroy(runner);
+        return NULL;
+    }
+    runner->started = true;
+    return runner;
+}
+
+void runner_destroy(SimRunner *runner) {
+    if (!runner) return;
+    if (runner->started) {
+        __atomic_store_n(&runner->quit, true, __ATOMIC_RELEASE);
+        pthread_join(runner->thread, NULL);
+    }
+    if (runner->save_job) finish_save(runner);
+    free(runner->save_path);
+    for (int i = 0; i < 3; i++) {
+        free(runner->snapshots[i].type);
+        free(runner->snapshots[i].temperature);
+        free(runner->snapshots[i].tile_seq);
+    }
+    free(runner->tile_seq);
+    free(runner);
+}
+
+void runner_set_running(SimRunner *runner, bool running) {
+    __atomic_store_n(&runner->running, running, __ATOMIC_RELAXED);
+}
+
+bool runner_is_running(SimRunner *runner) {
+    return __atomic_load_n(&runner->running, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,121 @@
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim.h"
+#include "brush.h"
+#include "sector.h"
+#include "save.h"
+#include "replay.h"
+
+// Runs a World on its own thread at a fixed timestep. Finished ticks are
+// published through a triple buffer of snapshots, so the render thread can
+// always grab the newest complete frame without locking or waiting, and
+// brush strokes travel the other way through a single-producer queue.
+//
+// With a SectorMap the world is a window onto an unbounded plane; the render
+// thread asks for the window to move and the sim thread moves it between
+// ticks. Brush strokes are then in plane cells. Such a world can also be
+// saved and loaded (save.h): saves are written by a background thread, so
+// neither a save nor an autosave ever holds up a tick. With a Recorder every
+// input the sim thread applies is logged (replay.h).
+
+#define BRUSH_QUEUE_SIZE 256  // power of two
+
+// Single producer (render thread), single consumer (sim thread)
+typedef struct {
+    BrushStroke events[BRUSH_QUEUE_SIZE];
+    uint32_t head;  // next slot to write, owned by the producer
+    uint32_t tail;  // next slot to read, owned by the consumer
+} BrushQueue;
+
+// Compact copy of the drawable planes, rows x cols without the WALL border
+typedef struct {
+    uint8_t *type;
+    int16_t *temperature;
+    uint64_t *tile_seq;  // publish sequence that last changed each chunk tile
+    uint64_t seq;        // publish sequence this snapshot reflects
+    uint64_t tick;
+    int64_t origin_x;    // plane cell of the window's top-left
+    int64_t origin_y;
+    uint32_t loads;      // snapshots loaded so far; the window jumps on each
+} Snapshot;
+
+typedef enum {
+    SAVE_STATUS_IDLE,
+    SAVE_STATUS_SAVING,
+    SAVE_STATUS_SAVED,
+    SAVE_STATUS_LOADED,
+    SAVE_STATUS_FAILED
+} SaveStatus;
+
+typedef struct SimRunner {
+    World *world;
+    int rows;
+    int cols;
+    int tiles_x;
+    int tiles_y;
+    uint64_t tick_ns;
+
+    pthread_t thread;
+    bool started;
+    bool quit;     // atomic
+    bool running;  // atomic, false pauses ticking but still applies brushes
+
+    BrushQueue brushes;
+
+    SectorMap *sectors;       // NULL for a bounded world
+    Recorder *recorder;       // NULL when not recording
+    bool was_running;         // sim thread's view of `running`, for the log
+    uint64_t window_request;  // atomic, packed sector coordinates to move to
+
+    // Saving, sim thread only once saves_enabled is published
+    bool saves_enabled;       // atomic
+    char *save_path;
+    uint64_t autosave_ticks;  // 0 saves only on request
+    uint64_t last_save_tick;
+    SaveJob *save_job;
+    bool save_request;        // atomic
+    bool load_request;        // atomic
+    int save_status;          // atomic, SaveStatus
+    uint32_t loads;
+
+    Snapshot snapshots[3];
+    int back;      // sim thread only
+    int front;     // render thread only
+    int latest;    // atomic, index of the newest snapshot | SNAPSHOT_FRESH
+    uint64_t seq;  // sim thread only
+    uint64_t *tile_seq;
+} SimRunner;
+
+// Takes ownership of driving `world` (and `sectors` and `recorder`, which
+// may be NULL) until runner_destroy; the caller must not touch them in
+// between, and closes the recorder afterwards.
+SimRunner *runner_create(World *world, SectorMap *sectors, Recorder *recorder, int tick_hz);
+void runner_destroy(SimRunner *runner);
+
+void runner_set_running(SimRunner *runner, bool running);
+bool runner_is_running(SimRunner *runner);
+
+// Moves the window to the sectors starting at (sx, sy), soon; needs sectors
+void runner_set_window(SimRunner *runner, int32_t sx, int32_t sy);
+
+// Saves to and loads from `path`, autosaving every `autosave_ticks` ticks
+// (0 never). Needs sectors; call once.
+bool runner_enable_saves(SimRunner *runner, const char *path, uint64_t autosave_ticks);
+// Saves or loads at the next tick. A save requested while one is still
+// being written starts once it is done.
+void runner_request_save(SimRunner *runner);
+void runner_request_load(SimRunner *runner);
+SaveStatus runner_save_status(SimRunner *runner);
+
+// Returns false when the queue is full and the stroke was dropped
+bool runner_push_brush(SimRunner *runner, const BrushStroke *stroke);
+
+// Newest published snapshot. It stays valid and unchanged until the next
+// call, which is the render thread's cue that it is done with it.
+const Snapshot *runner_acquire_snapshot(SimRunner *runner);
+
+#endif
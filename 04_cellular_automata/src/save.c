@@ -0,0 +1,397 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#ifdef _WIN32
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600  // ReOpenFile
+#endif
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "save.h"
+#include "rle.h"
+#include "rng.h"
+
+_Static_assert(sizeof(SaveHeader) == 64, "SaveHeader layout is part of the file format");
+_Static_assert(sizeof(SaveSector) == 40, "SaveSector layout is part of the file format");
+
+static const size_t plane_offset[SAVE_PLANES] = {
+    offsetof(SectorData, type), offsetof(SectorData, temperature),
+    offsetof(SectorData, velocity_x), offsetof(SectorData, velocity_y),
+};
+static const size_t plane_width[SAVE_PLANES] = { 1, sizeof(int16_t), 1, 1 };
+
+// Largest encoded plane; also fits a whole page of the page file
+#define ENCODE_BOUND (rle_bound(SECTOR_CELLS, 1) * 3 + rle_bound(SECTOR_CELLS, 2))
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    PLATFORM    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#ifdef _WIN32
+// A mapped file could not be replaced by the next save, so it is read whole
+static const uint8_t *map_file(const char *path, size_t *size) {
+    FILE *in = fopen(path, "rb");
+    if (!in) return NULL;
+    uint8_t *base = NULL;
+    if (fseek(in, 0, SEEK_END) == 0) {
+        long length = ftell(in);
+        base = length > 0 ? (uint8_t *)malloc((size_t)length) : NULL;
+        if (base && (fseek(in, 0, SEEK_SET) != 0 || fread(base, 1, (size_t)length, in) != (size_t)length)) {
+            free(base);
+            base = NULL;
+        }
+        *size = (size_t)length;
+    }
+    fclose(in);
+    return base;
+}
+
+static void unmap_file(const uint8_t *base, size_t size) {
+    (void)size;
+    free((void *)base);
+}
+
+// Reads on the pager's own handle would move the file pointer its seeks and
+// writes share, even at an explicit offset. The saver gets a handle of its
+// own, opened for overlapped reads, which never touch a file pointer.
+static intptr_t open_reader(FILE *file) {
+    HANDLE reader = ReOpenFile((HANDLE)_get_osfhandle(_fileno(file)), GENERIC_READ,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, FILE_FLAG_OVERLAPPED);
+    return reader == INVALID_HANDLE_VALUE ? -1 : (intptr_t)reader;
+}
+
+static void close_reader(intptr_t reader) {
+    CloseHandle((HANDLE)reader);
+}
+
+static bool read_at(intptr_t reader, void *buffer, uint32_t bytes, int64_t offset) {
+    OVERLAPPED at = { 0 };
+    at.Offset = (DWORD)offset;
+    at.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD got = 0;
+    if (!ReadFile((HANDLE)reader, buffer, bytes, NULL, &at) && GetLastError() != ERROR_IO_PENDING) return false;
+    return GetOverlappedResult((HANDLE)reader, &at, &got, TRUE) && got == bytes;
+}
+
+static bool sync_file(FILE *file) {
+    return fflush(file) == 0 && _commit(_fileno(file)) == 0;
+}
+
+static bool replace_file(const char *from, const char *to) {
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+#else
+static const uint8_t *map_file(const char *path, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        *size = (size_t)st.st_size;
+        base = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);  // the mapping keeps the file
+    return base == MAP_FAILED ? NULL : (const uint8_t *)base;
+}
+
+static void unmap_file(const uint8_t *base, size_t size) {
+    munmap((void *)base, size);
+}
+
+// pread leaves the file offset alone, so the pager's descriptor will do
+static intptr_t open_reader(FILE *file) {
+    return fileno(file);
+}
+
+static void close_reader(intptr_t reader) {
+    (void)reader;
+}
+
+static bool read_at(intptr_t reader, void *buffer, uint32_t bytes, int64_t offset) {
+    return pread((int)reader, buffer, bytes, (off_t)offset) == (ssize_t)bytes;
+}
+
+static bool sync_file(FILE *file) {
+    return fflush(file) == 0 && fsync(fileno(file)) == 0;
+}
+
+static bool replace_file(const char *from, const char *to) {
+    return rename(from, to) == 0;
+}
+#endif
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    READING    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Checks everything decoding relies on, so a sector can later be decoded
+// straight from the mapping without further bounds checks
+static bool check_file(const SaveFile *file, const char *path) {
+    const SaveHeader *h = file->header;
+    if (memcmp(h->magic, SAVE_MAGIC, sizeof(h->magic)) != 0) {
+        fprintf(stderr, "%s is not a snapshot\n", path);
+        return false;
+    }
+    if (h->version != SAVE_VERSION || h->header_bytes < sizeof(SaveHeader)) {
+        fprintf(stderr, "%s is snapshot version %u, this build reads version %d\n", path, h->version, SAVE_VERSION);
+        return false;
+    }
+    if (h->sector_size != SECTOR_SIZE || h->window_w <= 0 || h->window_h <= 0) {
+        fprintf(stderr, "%s has %u-cell sectors, this build uses %d\n", path, h->sector_size, SECTOR_SIZE);
+        return false;
+    }
+    if (h->index_offset % 8 != 0 || h->index_offset > file->size ||
+        (file->size - h->index_offset) / sizeof(SaveSector) < h->sector_count) {
+        fprintf(stderr, "%s is truncated\n", path);
+        return false;
+    }
+
+    const SaveSector *index = (const SaveSector *)(file->base + h->index_offset);
+    for (uint32_t i = 0; i < h->sector_count; i++) {
+        const SaveSector *e = &index[i];
+        uint64_t end = e->offset;
+        bool ok = e->offset >= h->header_bytes;
+        for (int p = 0; p < SAVE_PLANES && ok; p++) {
+            end += e->bytes[p];
+            ok = e->codec[p] == SAVE_RLE ||
+                 (e->codec[p] == SAVE_RAW && e->bytes[p] == SECTOR_CELLS * plane_width[p]);
+        }
+        if (!ok || end > h->index_offset) {
+            fprintf(stderr, "%s has a bad entry for sector %d,%d\n", path, e->sx, e->sy);
+            return false;
+        }
+    }
+    return true;
+}
+
+SaveFile *save_open(const char *path) {
+    size_t size = 0;
+    const uint8_t *base = map_file(path, &size);
+    if (!base) {
+        fprintf(stderr, "Failed to open snapshot %s\n", path);
+        return NULL;
+    }
+
+    SaveFile *file = (SaveFile *)calloc(1, sizeof(SaveFile));
+    if (!file) {
+        unmap_file(base, size);
+        return NULL;
+    }
+    file->base = base;
+    file->size = size;
+    file->header = (const SaveHeader *)base;
+    if (size < sizeof(SaveHeader)) {
+        fprintf(stderr, "%s is truncated\n", path);
+        save_close(file);
+        return NULL;
+    }
+    if (!check_file(file, path)) {
+        save_close(file);
+        return NULL;
+    }
+    file->index = (const SaveSector *)(file->base + file->header->index_offset);
+    return file;
+}
+
+void save_close(SaveFile *file) {
+    if (!file) return;
+    unmap_file(file->base, file->size);
+    free(file);
+}
+
+bool save_decode_sector(const SaveFile *file, const SaveSector *sector, SectorData *out) {
+    const uint8_t *in = file->base + sector->offset;
+    for (int p = 0; p < SAVE_PLANES; p++) {
+        uint8_t *dst = (uint8_t *)out + plane_offset[p];
+        if (sector->codec[p] == SAVE_RAW) {
+            memcpy(dst, in, sector->bytes[p]);
+        } else if (rle_decode(in, sector->bytes[p], dst, SECTOR_CELLS, plane_width[p]) != sector->bytes[p]) {
+            return false;
+        }
+        in += sector->bytes[p];
+    }
+    return true;
+}
+
+bool save_load(const char *path, SectorMap *map, World *world) {
+    if (map->saving) {
+        fprintf(stderr, "Cannot load %s while a save is in progress\n", path);
+        return false;
+    }
+    SaveFile *file = save_open(path);
+    if (!file) return false;
+    const SaveHeader *h = file->header;
+    if (h->window_w != map->window_w || h->window_h != map->window_h) {
+        fprintf(stderr, "%s has a %dx%d sector window, this world needs %dx%d\n", path,
+                h->window_w, h->window_h, map->window_w, map->window_h);
+        save_close(file);
+        return false;
+    }
+
+    sector_map_reset(map, file);
+    bool ok = true;
+    for (uint32_t i = 0; i < h->sector_count; i++) {
+        ok &= sector_map_insert_saved(map, file->index[i].sx, file->index[i].sy, &file->index[i]) != NULL;
+    }
+    world->seed = h->seed;
+    world->rng_key = rng_key(h->seed);
+    world->tick = h->tick;
+    world_clear(world);  // derived planes and update stamps for the new tick
+    ok &= sector_map_load_window(map, world, h->window_sx, h->window_sy);
+    return ok;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    WRITING    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static bool item_data(const SaveJob *job, const SaveItem *item, uint8_t *buffer, SectorData *scratch) {
+    if (item->saved) return save_decode_sector(job->backing, item->saved, scratch);
+    return read_at(job->page_reader, buffer, item->page_bytes, item->page_offset) &&
+           sector_decode_page(buffer, item->page_bytes, scratch);
+}
+
+static bool write_sectors(SaveJob *job, FILE *out, SaveSector *index) {
+    uint8_t *buffer = (uint8_t *)malloc(ENCODE_BOUND);
+    SectorData *scratch = (SectorData *)malloc(sizeof(SectorData));
+    bool ok = buffer && scratch;
+    uint64_t offset = sizeof(SaveHeader);
+
+    for (uint32_t i = 0; i < job->item_count && ok; i++) {
+        const SaveItem *item = &job->items[i];
+        const SectorData *d = item->data;
+        if (!d) {
+            if (!item_data(job, item, buffer, scratch)) {
+                fprintf(stderr, "Failed to read sector %d,%d for %s\n", item->sx, item->sy, job->path);
+                ok = false;
+                break;
+            }
+            d = scratch;
+        }
+
+        SaveSector *e = &index[i];
+        e->sx = item->sx;
+        e->sy = item->sy;
+        e->offset = offset;
+        for (int p = 0; p < SAVE_PLANES && ok; p++) {
+            const uint8_t *src = (const uint8_t *)d + plane_offset[p];
+            size_t raw = SECTOR_CELLS * plane_width[p];
+            size_t n = rle_encode(src, SECTOR_CELLS, plane_width[p], buffer);
+            bool rle = n < raw;
+            if (!rle) n = raw;
+            ok = fwrite(rle ? buffer : src, 1, n, out) == n;
+            e->codec[p] = rle ? SAVE_RLE : SAVE_RAW;
+            e->bytes[p] = (uint32_t)n;
+            offset += n;
+        }
+    }
+
+    // The index is read in place from the mapping, keep it aligned
+    static const uint8_t zeros[8];
+    size_t pad = (size_t)(-offset & 7);
+    ok = ok && fwrite(zeros, 1, pad, out) == pad;
+    job->header.index_offset = offset + pad;
+    free(buffer);
+    free(scratch);
+    return ok;
+}
+
+// Writes to a temporary file and renames it over `path`, so an interrupted
+// save never replaces a good snapshot. A map loaded from `path` keeps
+// reading the old file through its mapping.
+static bool write_snapshot(SaveJob *job) {
+    size_t length = strlen(job->path) + sizeof(".tmp");
+    char *tmp = (char *)malloc(length);
+    SaveSector *index = (SaveSector *)calloc(job->item_count ? job->item_count : 1, sizeof(SaveSector));
+    FILE *out = NULL;
+    if (tmp) {
+        snprintf(tmp, length, "%s.tmp", job->path);
+        out = fopen(tmp, "wb");
+    }
+    bool ok = tmp && index && out &&
+              fwrite(&job->header, sizeof(SaveHeader), 1, out) == 1 &&  // placeholder until the index is known
+              write_sectors(job, out, index) &&
+              fwrite(index, sizeof(SaveSector), job->item_count, out) == job->item_count &&
+              fseek(out, 0, SEEK_SET) == 0 &&
+              fwrite(&job->header, sizeof(SaveHeader), 1, out) == 1 &&
+              sync_file(out);
+    job->bytes_written = (size_t)job->header.index_offset + (size_t)job->item_count * sizeof(SaveSector);
+    if (out && fclose(out) != 0) ok = false;
+    if (ok && !replace_file(tmp, job->path)) ok = false;
+    if (!ok) {
+        fprintf(stderr, "Failed to save %s\n", job->path);
+        if (out) remove(tmp);
+    }
+    free(tmp);
+    free(index);
+    return ok;
+}
+
+static void *save_thread(void *arg) {
+    SaveJob *job = (SaveJob *)arg;
+    job->ok = write_snapshot(job);
+    __atomic_store_n(&job->done, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+SaveJob *save_begin(SectorMap *map, const World *world, const char *path) {
+    if (map->saving || !sector_map_store_window(map, world)) return NULL;
+
+    SaveJob *job = (SaveJob *)calloc(1, sizeof(SaveJob));
+    if (!job) return NULL;
+    job->path = strdup(path);
+    job->items = (SaveItem *)malloc((map->count ? map->count : 1) * sizeof(SaveItem));
+    if (!job->path || !job->items || !sector_map_pin(map)) {
+        free(job->path);
+        free(job->items);
+        free(job);
+        return NULL;
+    }
+
+    // Only the map's bookkeeping is copied here; the planes are read by the
+    // saver from the pinned blocks, the page file or the old snapshot
+    for (uint32_t b = 0; b <= map->bucket_mask; b++) {
+        for (const Sector *s = map->buckets[b]; s; s = s->next) {
+            job->items[job->item_count++] = (SaveItem){
+                .sx = s->sx, .sy = s->sy, .data = s->data,
+                .page_offset = s->page_offset, .page_bytes = s->page_bytes, .saved = s->saved,
+            };
+        }
+    }
+    SaveHeader *h = &job->header;
+    memcpy(h->magic, SAVE_MAGIC, sizeof(h->magic));
+    h->version = SAVE_VERSION;
+    h->header_bytes = sizeof(SaveHeader);
+    h->sector_size = SECTOR_SIZE;
+    h->sector_count = job->item_count;
+    h->window_sx = map->window_sx;
+    h->window_sy = map->window_sy;
+    h->window_w = map->window_w;
+    h->window_h = map->window_h;
+    h->seed = world->seed;
+    h->tick = world->tick;
+    job->backing = map->backing;
+    job->page_reader = open_reader(map->page_file);
+
+    if (job->page_reader < 0 || pthread_create(&job->thread, NULL, save_thread, job) != 0) {
+        fprintf(stderr, "Failed to start saving %s\n", path);
+        if (job->page_reader >= 0) close_reader(job->page_reader);
+        sector_map_unpin(map);
+        free(job->path);
+        free(job->items);
+        free(job);
+        return NULL;
+    }
+    return job;
+}
+
+bool save_end(SectorMap *map, SaveJob *job) {
+    pthread_join(job->thread, NULL);
+    close_reader(job->page_reader);
+    sector_map_unpin(map);
+    bool ok = job->ok;
+    free(job->path);
+    free(job->items);
+    free(job);
+    return ok;
+}
@@ -0,0 +1,111 @@
+#ifndef SAVE_H
+#define SAVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "sim.h"
+#include "sector.h"
+
+// World snapshots. A file holds every stored sector of a SectorMap plus the
+// window, one record per sector and plane:
+//
+//   SaveHeader
+//   sector planes, back to back: type, temperature, velocity_x, velocity_y,
+//     each raw or run-length coded, whichever is smaller
+//   SaveSector index, header.sector_count entries at header.index_offset
+//
+// Integers are stored in host byte order (little-endian everywhere the game
+// runs). Loading maps the file (reads it, on Windows) and checks only the
+// index; a sector's planes are decoded the first time the window reaches it.
+//
+// Saving runs on a background thread from a copy-on-write view of the map:
+// starting a save pins the sectors' current blocks, and the sim thread only
+// copies a block if it changes that sector before the save is done. Nothing
+// on the sim thread waits for the disk.
+
+#define SAVE_MAGIC "FSANDSAV"
+#define SAVE_VERSION 1
+#define SAVE_PLANES 4
+
+typedef enum {
+    SAVE_RAW,
+    SAVE_RLE
+} SaveCodec;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_bytes;  // sizeof(SaveHeader) when written, for later growth
+    uint32_t sector_size;
+    uint32_t sector_count;
+    int32_t window_sx;
+    int32_t window_sy;
+    int32_t window_w;
+    int32_t window_h;
+    uint32_t seed;
+    uint32_t reserved;
+    uint64_t tick;
+    uint64_t index_offset;
+} SaveHeader;
+
+typedef struct SaveSector {
+    int32_t sx, sy;
+    uint64_t offset;                // first plane; the others follow
+    uint32_t bytes[SAVE_PLANES];
+    uint8_t codec[SAVE_PLANES];     // SaveCodec
+    uint8_t reserved[4];
+} SaveSector;
+
+// A snapshot file mapped into memory
+typedef struct SaveFile {
+    const uint8_t *base;
+    size_t size;
+    const SaveHeader *header;
+    const SaveSector *index;
+} SaveFile;
+
+SaveFile *save_open(const char *path);
+void save_close(SaveFile *file);
+bool save_decode_sector(const SaveFile *file, const SaveSector *sector, SectorData *out);
+
+// Replaces the map and the world with the snapshot at `path`. The map keeps
+// the file mapped and decodes sectors as they are needed. The world must
+// match the saved window size. Must not run while a save is in progress.
+bool save_load(const char *path, SectorMap *map, World *world);
+
+// One sector as the saver sees it: pinned planes, a page file extent or an
+// undecoded sector of the snapshot the map was loaded from
+typedef struct {
+    int32_t sx, sy;
+    const SectorData *data;
+    int64_t page_offset;
+    uint32_t page_bytes;
+    const SaveSector *saved;
+} SaveItem;
+
+typedef struct SaveJob {
+    pthread_t thread;
+    char *path;
+    SaveHeader header;
+    SaveItem *items;
+    uint32_t item_count;
+    const SaveFile *backing;
+    intptr_t page_reader;  // what the saver reads the page file through
+    size_t bytes_written;
+    bool done;  // atomic, set by the saver thread last
+    bool ok;
+} SaveJob;
+
+// Stores the window into the map, pins it and starts writing `path` in the
+// background. Returns NULL if a save is already running or it cannot start.
+SaveJob *save_begin(SectorMap *map, const World *world, const char *path);
+static inline bool save_finished(const SaveJob *job) {
+    return __atomic_load_n(&job->done, __ATOMIC_ACQUIRE);
+}
+// Waits for the saver if needed, unpins the map and frees the job. Returns
+// whether the file was written.
+bool save_end(SectorMap *map, SaveJob *job);
+
+#endif
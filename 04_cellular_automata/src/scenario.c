@@ -0,0 +1,95 @@
+#include <string.h>
+#include <stdlib.h>
+#include "sim.h"
+
+static const char *scenario_names[SCENARIO_COUNT] = {
+    [SCENARIO_EMPTY]      = "empty",
+    [SCENARIO_SAND_PILE]  = "sand_pile",
+    [SCENARIO_WATER_TANK] = "water_tank",
+    [SCENARIO_FIRE_STORM] = "fire_storm",
+    [SCENARIO_MIXED]      = "mixed",
+};
+
+const char *scenario_name(Scenario scenario) {
+    if (scenario < 0 || scenario >= SCENARIO_COUNT) return "unknown";
+    return scenario_names[scenario];
+}
+
+int scenario_from_name(const char *name) {
+    for (int i = 0; i < SCENARIO_COUNT; i++) {
+        if (strcmp(name, scenario_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static void fill_rect(World *world, int x0, int y0, int x1, int y1, Element type) {
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > world->cols) x1 = world->cols;
+    if (y1 > world->rows) y1 = world->rows;
+
+    for (int i = y0; i < y1; i++) {
+        for (int j = x0; j < x1; j++) {
+            world->grid.type[world_index(world, j, i)] = type;
+        }
+    }
+}
+
+// Scatter `type` over a rectangle with the given fill ratio (0-100)
+static void scatter_rect(World *world, int x0, int y0, int x1, int y1, Element type, int percent) {
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > world->cols) x1 = world->cols;
+    if (y1 > world->rows) y1 = world->rows;
+
+    for (int i = y0; i < y1; i++) {
+        for (int j = x0; j < x1; j++) {
+            if (rand() % 100 < percent) world->grid.type[world_index(world, j, i)] = type;
+        }
+    }
+}
+
+void world_load_scenario(World *world, Scenario scenario) {
+    int rows = world->rows;
+    int cols = world->cols;
+
+    world_clear(world);
+
+    switch (scenario) {
+        case SCENARIO_EMPTY:
+            break;
+        case SCENARIO_SAND_PILE: {
+            // A dense block of sand in the upper middle that collapses into a pile
+            fill_rect(world, cols / 4, rows / 8, cols * 3 / 4, rows / 2, SAND);
+            scatter_rect(world, 0, 0, cols, rows / 8, SAND, 20);
+            break;
+        }
+        case SCENARIO_WATER_TANK: {
+            // Rock tank with a raised block of water poured in from one side
+            fill_rect(world, 0, rows - 2, cols, rows, ROCK);
+            fill_rect(world, cols / 8, rows / 2, cols / 8 + 2, rows - 2, ROCK);
+            fill_rect(world, cols * 7 / 8 - 2, rows / 2, cols * 7 / 8, rows - 2, ROCK);
+            fill_rect(world, cols / 8 + 2, rows / 8, cols / 2, rows / 2, WATER);
+            break;
+        }
+        case SCENARIO_FIRE_STORM: {
+            // Sand bed under a rock shelf on two legs, fire raining from above
+            fill_rect(world, 0, rows * 3 / 4, cols, rows, SAND);
+            fill_rect(world, cols / 4, rows / 2, cols * 3 / 4, rows / 2 + 2, ROCK);
+            fill_rect(world, cols / 4, rows / 2 + 2, cols / 4 + 2, rows * 3 / 4, ROCK);
+            fill_rect(world, cols * 3 / 4 - 2, rows / 2 + 2, cols * 3 / 4, rows * 3 / 4, ROCK);
+            scatter_rect(world, 0, 0, cols, rows / 2, FIRE, 15);
+            break;
+        }
+        case SCENARIO_MIXED: {
+            fill_rect(world, 0, rows - 2, cols, rows, ROCK);
+            fill_rect(world, 0, rows / 2, cols / 3, rows * 3 / 4, SAND);
+            fill_rect(world, cols / 3, rows / 4, cols * 2 / 3, rows / 2, WATER);
+            scatter_rect(world, cols * 2 / 3, 0, cols, rows / 2, FIRE, 10);
+            scatter_rect(world, 0, 0, cols, rows / 4, SAND, 10);
+            break;
+        }
+        default:
+            break;
+    }
+}
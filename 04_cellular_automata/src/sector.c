@@ -0,0 +1,497 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "sector.h"
+#include "chunk.h"
+#include "thermal.h"
+#include "rle.h"
+#include "save.h"
+
+#define SLAB_BLOCKS 16
+#define INITIAL_BUCKETS 256
+#define DEFAULT_PAGE_DISTANCE 2
+#define DEFAULT_PAGE_AFTER 600  // ticks, 20 s at the game's 30 Hz
+
+#if SECTOR_SIZE % CHUNK_SIZE != 0
+#error "SECTOR_SIZE must be a multiple of CHUNK_SIZE"
+#endif
+
+// Page layout: the four planes one after the other, each run-length coded
+#define PAGE_BOUND (rle_bound(SECTOR_CELLS, 1) * 3 + rle_bound(SECTOR_CELLS, 2))
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    POOL    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static SectorData *pool_take(SectorMap *map) {
+    if (map->free_count > 0) return map->free_blocks[--map->free_count];
+
+    if (map->block_count % SLAB_BLOCKS == 0) {
+        if (map->slab_count == map->slab_capacity) {
+            int capacity = map->slab_capacity ? map->slab_capacity * 2 : 16;
+            SectorData **slabs = (SectorData **)realloc(map->slabs, capacity * sizeof(SectorData *));
+            SectorData **free_blocks = (SectorData **)realloc(map->free_blocks,
+                                                              (size_t)capacity * SLAB_BLOCKS * sizeof(SectorData *));
+            if (slabs) map->slabs = slabs;
+            if (free_blocks) map->free_blocks = free_blocks;
+            if (!slabs || !free_blocks) return NULL;
+            map->slab_capacity = capacity;
+        }
+        SectorData *slab = (SectorData *)malloc(SLAB_BLOCKS * sizeof(SectorData));
+        if (!slab) return NULL;
+        map->slabs[map->slab_count++] = slab;
+    }
+    SectorData *slab = map->slabs[map->block_count / SLAB_BLOCKS];
+    return &slab[map->block_count++ % SLAB_BLOCKS];
+}
+
+static void pool_give(SectorMap *map, SectorData *block) {
+    map->free_blocks[map->free_count++] = block;
+}
+
+// Gives up a sector's block: back to the pool, or to the saver if pinned.
+// sector_map_pin reserved room for every pinned block among the orphans.
+static void retire_block(SectorMap *map, Sector *s) {
+    if (s->pinned) {
+        map->orphans[map->orphan_count++] = s->data;
+        s->pinned = false;
+    } else {
+        pool_give(map, s->data);
+    }
+    s->data = NULL;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    MAP    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static inline uint32_t hash_sector(int32_t sx, int32_t sy) {
+    uint64_t h = ((uint64_t)(uint32_t)sx << 32 | (uint32_t)sy) * 0x9E3779B97F4A7C15ULL;
+    return (uint32_t)(h >> 32);
+}
+
+Sector *sector_map_find(const SectorMap *map, int32_t sx, int32_t sy) {
+    for (Sector *s = map->buckets[hash_sector(sx, sy) & map->bucket_mask]; s; s = s->next) {
+        if (s->sx == sx && s->sy == sy) return s;
+    }
+    return NULL;
+}
+
+static void rehash(SectorMap *map, uint32_t bucket_count) {
+    Sector **buckets = (Sector **)calloc(bucket_count, sizeof(Sector *));
+    if (!buckets) return;  // keep the old table, chains just get longer
+    for (uint32_t b = 0; b <= map->bucket_mask; b++) {
+        Sector *s = map->buckets[b];
+        while (s) {
+            Sector *next = s->next;
+            uint32_t slot = hash_sector(s->sx, s->sy) & (bucket_count - 1);
+            s->next = buckets[slot];
+            buckets[slot] = s;
+            s = next;
+        }
+    }
+    free(map->buckets);
+    map->buckets = buckets;
+    map->bucket_mask = bucket_count - 1;
+}
+
+static Sector *insert(SectorMap *map, int32_t sx, int32_t sy, const SaveSector *saved) {
+    Sector *s = (Sector *)calloc(1, sizeof(Sector));
+    if (!s) return NULL;
+    s->saved = saved;
+    s->data = saved ? NULL : pool_take(map);
+    if (!s->data && !saved) {
+        free(s);
+        return NULL;
+    }
+    s->sx = sx;
+    s->sy = sy;
+    uint32_t slot = hash_sector(sx, sy) & map->bucket_mask;
+    s->next = map->buckets[slot];
+    map->buckets[slot] = s;
+    if (++map->count > map->bucket_mask + 1) rehash(map, (map->bucket_mask + 1) * 2);
+    return s;
+}
+
+static void push_extent(PageExtent **list, int *count, int *capacity, PageExtent extent) {
+    if (*count == *capacity) {
+        int grown = *capacity ? *capacity * 2 : 64;
+        PageExtent *extents = (PageExtent *)realloc(*list, grown * sizeof(PageExtent));
+        if (!extents) return;  // the extent is simply never reused
+        *list = extents;
+        *capacity = grown;
+    }
+    (*list)[(*count)++] = extent;
+}
+
+static void release_page(SectorMap *map, Sector *s) {
+    if (s->data || s->saved) return;
+    // A save in progress may still be reading the extent
+    PageExtent extent = { s->page_offset, s->page_bytes };
+    if (map->saving) {
+        push_extent(&map->deferred, &map->deferred_count, &map->deferred_capacity, extent);
+    } else {
+        push_extent(&map->holes, &map->hole_count, &map->hole_capacity, extent);
+    }
+    map->paged--;
+}
+
+static void remove_sector(SectorMap *map, Sector *sector) {
+    Sector **link = &map->buckets[hash_sector(sector->sx, sector->sy) & map->bucket_mask];
+    while (*link != sector) link = &(*link)->next;
+    *link = sector->next;
+    if (sector->data) {
+        retire_block(map, sector);
+    } else {
+        release_page(map, sector);
+    }
+    free(sector);
+    map->count--;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    LIFETIME    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+SectorMap *sector_map_create(int window_w, int window_h, const char *page_path) {
+    SectorMap *map = (SectorMap *)calloc(1, sizeof(SectorMap));
+    if (!map) return NULL;
+
+    map->window_w = window_w;
+    map->window_h = window_h;
+    map->page_distance = DEFAULT_PAGE_DISTANCE;
+    map->page_after = DEFAULT_PAGE_AFTER;
+    map->buckets = (Sector **)calloc(INITIAL_BUCKETS, sizeof(Sector *));
+    map->bucket_mask = INITIAL_BUCKETS - 1;
+    map->scratch = (uint8_t *)malloc(PAGE_BOUND);
+    map->page_file = page_path ? fopen(page_path, "w+b") : tmpfile();
+    if (!map->buckets || !map->scratch || !map->page_file) {
+        fprintf(stderr, "Failed to create sector map%s%s\n", page_path ? " paging to " : "", page_path ? page_path : "");
+        sector_map_destroy(map);
+        return NULL;
+    }
+    return map;
+}
+
+void sector_map_destroy(SectorMap *map) {
+    if (!map) return;
+    if (map->buckets) {
+        for (uint32_t b = 0; b <= map->bucket_mask; b++) {
+            Sector *s = map->buckets[b];
+            while (s) {
+                Sector *next = s->next;
+                free(s);
+                s = next;
+            }
+        }
+    }
+    for (int i = 0; i < map->slab_count; i++) free(map->slabs[i]);
+    if (map->page_file) fclose(map->page_file);
+    save_close(map->backing);
+    free(map->slabs);
+    free(map->free_blocks);
+    free(map->orphans);
+    free(map->deferred);
+    free(map->holes);
+    free(map->scratch);
+    free(map->buckets);
+    free(map);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    PAGING    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static int64_t claim_extent(SectorMap *map, uint32_t bytes) {
+    for (int i = 0; i < map->hole_count; i++) {
+        PageExtent *hole = &map->holes[i];
+        if (hole->bytes < bytes) continue;
+        int64_t offset = hole->offset;
+        hole->offset += bytes;
+        hole->bytes -= bytes;
+        if (hole->bytes == 0) map->holes[i] = map->holes[--map->hole_count];
+        return offset;
+    }
+    int64_t offset = map->page_end;
+    map->page_end += bytes;
+    return offset;
+}
+
+static bool page_out(SectorMap *map, Sector *s) {
+    const SectorData *d = s->data;
+    size_t n = 0;
+    n += rle_encode(d->type, SECTOR_CELLS, 1, &map->scratch[n]);
+    n += rle_encode(d->temperature, SECTOR_CELLS, 2, &map->scratch[n]);
+    n += rle_encode(d->velocity_x, SECTOR_CELLS, 1, &map->scratch[n]);
+    n += rle_encode(d->velocity_y, SECTOR_CELLS, 1, &map->scratch[n]);
+
+    int64_t offset = claim_extent(map, (uint32_t)n);
+    if (fseeko(map->page_file, (off_t)offset, SEEK_SET) != 0 ||
+        fwrite(map->scratch, 1, n, map->page_file) != n) {
+        fprintf(stderr, "Failed to page out sector %d,%d\n", s->sx, s->sy);
+        // Nothing valid was stored there and no save reads it, so it is free again
+        if (offset + (int64_t)n == map->page_end) {
+            map->page_end = offset;
+        } else {
+            PageExtent extent = { offset, (uint32_t)n };
+            push_extent(&map->holes, &map->hole_count, &map->hole_capacity, extent);
+        }
+        return false;
+    }
+    s->page_offset = offset;
+    s->page_bytes = (uint32_t)n;
+    retire_block(map, s);
+    map->paged++;
+    return true;
+}
+
+bool sector_decode_page(const uint8_t *in, size_t left, SectorData *d) {
+    size_t used;
+    bool ok = (used = rle_decode(in, left, d->type, SECTOR_CELLS, 1)) != 0;
+    ok = ok && (in += used, left -= used, used = rle_decode(in, left, d->temperature, SECTOR_CELLS, 2)) != 0;
+    ok = ok && (in += used, left -= used, used = rle_decode(in, left, d->velocity_x, SECTOR_CELLS, 1)) != 0;
+    ok = ok && (in += used, left -= used, used = rle_decode(in, left, d->velocity_y, SECTOR_CELLS, 1)) != 0;
+    return ok;
+}
+
+SectorData *sector_map_data(SectorMap *map, Sector *s) {
+    if (s->data) return s->data;
+
+    SectorData *d = pool_take(map);
+    if (!d) return NULL;
+    bool ok;
+    if (s->saved) {
+        ok = save_decode_sector(map->backing, s->saved, d);
+    } else {
+        ok = fseeko(map->page_file, (off_t)s->page_offset, SEEK_SET) == 0 &&
+             fread(map->scratch, 1, s->page_bytes, map->page_file) == s->page_bytes &&
+             sector_decode_page(map->scratch, s->page_bytes, d);
+    }
+    if (!ok) {
+        fprintf(stderr, "Failed to %s sector %d,%d\n", s->saved ? "decode" : "page in", s->sx, s->sy);
+        pool_give(map, d);
+        return NULL;
+    }
+    release_page(map, s);
+    s->saved = NULL;
+    s->data = d;
+    return d;
+}
+
+// Chebyshev distance in sectors from the window
+static int window_distance(const SectorMap *map, int32_t sx, int32_t sy) {
+    int64_t dx = sx < map->window_sx ? (int64_t)map->window_sx - sx
+               : sx >= map->window_sx + map->window_w ? (int64_t)sx - (map->window_sx + map->window_w - 1) : 0;
+    int64_t dy = sy < map->window_sy ? (int64_t)map->window_sy - sy
+               : sy >= map->window_sy + map->window_h ? (int64_t)sy - (map->window_sy + map->window_h - 1) : 0;
+    int64_t d = dx > dy ? dx : dy;
+    return d > INT32_MAX ? INT32_MAX : (int)d;
+}
+
+int sector_map_page_out(SectorMap *map, uint64_t tick) {
+    int paged = 0;
+    for (uint32_t b = 0; b <= map->bucket_mask; b++) {
+        for (Sector *s = map->buckets[b]; s; s = s->next) {
+            if (!s->data || tick - s->stored_tick < map->page_after) continue;
+            if (window_distance(map, s->sx, s->sy) < map->page_distance) continue;
+            if (!page_out(map, s)) return paged;
+            paged++;
+        }
+    }
+    return paged;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    WINDOW    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static bool window_sector_blank(const World *world, int x0, int y0) {
+    for (int y = y0; y < y0 + SECTOR_SIZE; y++) {
+        int idx = world_index(world, x0, y);
+        for (int x = 0; x < SECTOR_SIZE; x++, idx++) {
+            if (world->grid.type[idx] != NONE || world->grid.temperature[idx] != AMBIENT_TEMPERATURE ||
+                world->grid.velocity_x[idx] || world->grid.velocity_y[idx]) return false;
+        }
+    }
+    return true;
+}
+
+static bool window_sector_differs(const SectorData *d, const World *world, int x0, int y0) {
+    for (int y = 0; y < SECTOR_SIZE; y++) {
+        int idx = world_index(world, x0, y0 + y);
+        int row = y * SECTOR_SIZE;
+        if (memcmp(&d->type[row], &world->grid.type[idx], SECTOR_SIZE) ||
+            memcmp(&d->temperature[row], &world->grid.temperature[idx], SECTOR_SIZE * sizeof(int16_t)) ||
+            memcmp(&d->velocity_x[row], &world->grid.velocity_x[idx], SECTOR_SIZE) ||
+            memcmp(&d->velocity_y[row], &world->grid.velocity_y[idx], SECTOR_SIZE)) return true;
+    }
+    return false;
+}
+
+// Copies a row of a plane into a sector, noting whether its copy differed
+static inline void store_row(void *dst, const void *src, size_t bytes, bool *changed) {
+    if (!*changed) *changed = memcmp(dst, src, bytes) != 0;
+    memcpy(dst, src, bytes);
+}
+
+static bool store_sector(SectorMap *map, const World *world, int i, int j) {
+    int32_t sx = map->window_sx + i;
+    int32_t sy = map->window_sy + j;
+    int x0 = i * SECTOR_SIZE;
+    int y0 = j * SECTOR_SIZE;
+    Sector *s = sector_map_find(map, sx, sy);
+
+    if (window_sector_blank(world, x0, y0)) {
+        if (s) remove_sector(map, s);
+        return true;
+    }
+
+    bool changed = false;
+    if (s && s->pinned) {
+        // The saver is reading this block: leave it be unless the sector
+        // changed, then leave it to the saver and carry on with a new one
+        if (!window_sector_differs(s->data, world, x0, y0)) return true;
+        SectorData *fresh = pool_take(map);
+        if (!fresh) {
+            fprintf(stderr, "Failed to store sector %d,%d\n", sx, sy);
+            return false;
+        }
+        retire_block(map, s);
+        s->data = fresh;
+        changed = true;
+    }
+    if (!s) {
+        s = insert(map, sx, sy, NULL);
+        changed = true;
+    } else if (!s->data) {
+        // Overwritten in full, no need to read the old page or snapshot back
+        release_page(map, s);
+        s->saved = NULL;
+        s->data = pool_take(map);
+        changed = true;
+        if (!s->data) {
+            remove_sector(map, s);
+            s = NULL;
+        }
+    }
+    if (!s) {
+        fprintf(stderr, "Failed to store sector %d,%d\n", sx, sy);
+        return false;
+    }
+
+    SectorData *d = s->data;
+    for (int y = 0; y < SECTOR_SIZE; y++) {
+        int idx = world_index(world, x0, y0 + y);
+        int row = y * SECTOR_SIZE;
+        store_row(&d->type[row], &world->grid.type[idx], SECTOR_SIZE, &changed);
+        store_row(&d->temperature[row], &world->grid.temperature[idx], SECTOR_SIZE * sizeof(int16_t), &changed);
+        store_row(&d->velocity_x[row], &world->grid.velocity_x[idx], SECTOR_SIZE, &changed);
+        store_row(&d->velocity_y[row], &world->grid.velocity_y[idx], SECTOR_SIZE, &changed);
+    }
+    if (changed) s->stored_tick = world->tick;
+    return true;
+}
+
+static bool load_sector(SectorMap *map, World *world, int i, int j) {
+    int x0 = i * SECTOR_SIZE;
+    int y0 = j * SECTOR_SIZE;
+    Sector *s = sector_map_find(map, map->window_sx + i, map->window_sy + j);
+    SectorData *d = s ? sector_map_data(map, s) : NULL;
+
+    for (int y = 0; y < SECTOR_SIZE; y++) {
+        int idx = world_index(world, x0, y0 + y);
+        if (d) {
+            int row = y * SECTOR_SIZE;
+            memcpy(&world->grid.type[idx], &d->type[row], SECTOR_SIZE);
+            memcpy(&world->grid.temperature[idx], &d->temperature[row], SECTOR_SIZE * sizeof(int16_t));
+            memcpy(&world->grid.velocity_x[idx], &d->velocity_x[row], SECTOR_SIZE);
+            memcpy(&world->grid.velocity_y[idx], &d->velocity_y[row], SECTOR_SIZE);
+        } else {
+            memset(&world->grid.type[idx], NONE, SECTOR_SIZE);
+            for (int x = 0; x < SECTOR_SIZE; x++) world->grid.temperature[idx + x] = AMBIENT_TEMPERATURE;
+            memset(&world->grid.velocity_x[idx], 0, SECTOR_SIZE);
+            memset(&world->grid.velocity_y[idx], 0, SECTOR_SIZE);
+        }
+    }
+    // The world holds the only copy from now on
+    if (s) remove_sector(map, s);
+    return !s || d;
+}
+
+static bool window_fits(const SectorMap *map, const World *world) {
+    if (world->cols == map->window_w * SECTOR_SIZE && world->rows == map->window_h * SECTOR_SIZE) return true;
+    fprintf(stderr, "World is %dx%d, sector window needs %dx%d\n", world->cols, world->rows,
+            map->window_w * SECTOR_SIZE, map->window_h * SECTOR_SIZE);
+    return false;
+}
+
+bool sector_map_store_window(SectorMap *map, const World *world) {
+    if (!window_fits(map, world)) return false;
+    bool ok = true;
+    for (int j = 0; j < map->window_h; j++) {
+        for (int i = 0; i < map->window_w; i++) {
+            ok &= store_sector(map, world, i, j);
+        }
+    }
+    return ok;
+}
+
+bool sector_map_move_window(SectorMap *map, World *world, int32_t sx, int32_t sy) {
+    if (!window_fits(map, world)) return false;
+    bool ok = sector_map_store_window(map, world);
+    return sector_map_load_window(map, world, sx, sy) && ok;
+}
+
+bool sector_map_load_window(SectorMap *map, World *world, int32_t sx, int32_t sy) {
+    if (!window_fits(map, world)) return false;
+    bool ok = true;
+    map->window_sx = sx;
+    map->window_sy = sy;
+    for (int j = 0; j < map->window_h; j++) {
+        for (int i = 0; i < map->window_w; i++) {
+            ok &= load_sector(map, world, i, j);
+        }
+    }
+    world_mark_all(world);
+    return ok;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    SNAPSHOTS    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void sector_map_reset(SectorMap *map, SaveFile *backing) {
+    for (uint32_t b = 0; b <= map->bucket_mask; b++) {
+        while (map->buckets[b]) remove_sector(map, map->buckets[b]);
+    }
+    if (map->backing != backing) save_close(map->backing);
+    map->backing = backing;
+}
+
+Sector *sector_map_insert_saved(SectorMap *map, int32_t sx, int32_t sy, const SaveSector *saved) {
+    Sector *s = sector_map_find(map, sx, sy);
+    if (s) remove_sector(map, s);
+    return insert(map, sx, sy, saved);
+}
+
+bool sector_map_pin(SectorMap *map) {
+    // Every pinned block may become an orphan, so make room for all of them
+    uint32_t resident = map->count - map->paged;
+    if (map->orphan_capacity < resident) {
+        SectorData **orphans = (SectorData **)realloc(map->orphans, resident * sizeof(SectorData *));
+        if (!orphans) return false;
+        map->orphans = orphans;
+        map->orphan_capacity = resident;
+    }
+    for (uint32_t b = 0; b <= map->bucket_mask; b++) {
+        for (Sector *s = map->buckets[b]; s; s = s->next) s->pinned = s->data != NULL;
+    }
+    fflush(map->page_file);  // the saver reads pages around the FILE buffer
+    map->saving = true;
+    return true;
+}
+
+void sector_map_unpin(SectorMap *map) {
+    for (uint32_t b = 0; b <= map->bucket_mask; b++) {
+        for (Sector *s = map->buckets[b]; s; s = s->next) s->pinned = false;
+    }
+    while (map->orphan_count > 0) pool_give(map, map->orphans[--map->orphan_count]);
+    for (int i = 0; i < map->deferred_count; i++) {
+        push_extent(&map->holes, &map->hole_count, &map->hole_capacity, map->deferred[i]);
+    }
+    map->deferred_count = 0;
+    map->saving = false;
+}
+
+size_t sector_map_memory_bytes(const SectorMap *map) {
+    return sizeof(SectorMap) + (size_t)(map->bucket_mask + 1) * sizeof(Sector *) +
+           (size_t)map->count * sizeof(Sector) +
+           (size_t)map->slab_count * SLAB_BLOCKS * sizeof(SectorData) +
+           (size_t)map->slab_capacity * (sizeof(SectorData *) * (SLAB_BLOCKS + 1)) +
+           (size_t)map->orphan_capacity * sizeof(SectorData *) +
+           (size_t)(map->hole_capacity + map->deferred_capacity) * sizeof(PageExtent) + PAGE_BOUND;
+}
@@ -0,0 +1,140 @@
+#ifndef SECTOR_H
+#define SECTOR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim.h"
+
+// Unbounded world. The plane is cut into SECTOR_SIZE x SECTOR_SIZE sectors
+// kept in a hash map, and the World being simulated is a window of
+// window_w x window_h sectors onto it, chosen by the camera. Sectors outside
+// the window are frozen; the window's edge is the WALL border as before.
+//
+// Only sectors holding something are stored: one that is nothing but empty,
+// still, ambient cells is dropped and its block goes back to the pool.
+// Sector planes come from a pooled arena of fixed-size blocks. Sectors that
+// have sat unchanged outside the window for a while, far from it, are
+// run-length coded and paged out to a file, leaving only their map entry in
+// memory. So memory follows the occupied area near the camera, not the
+// extent of the world.
+//
+// A map loaded from a snapshot (save.h) keeps the file mapped, and its
+// sectors stay undecoded in the file until something needs their planes.
+// While a save is in progress the map's blocks are pinned: a pinned block
+// that would be changed or freed is handed to the saver instead, and the
+// map carries on with a fresh one.
+
+#define SECTOR_SIZE 64  // a multiple of CHUNK_SIZE so windows align with tiles
+#define SECTOR_CELLS (SECTOR_SIZE * SECTOR_SIZE)
+
+typedef struct {
+    uint8_t type[SECTOR_CELLS];
+    int16_t temperature[SECTOR_CELLS];
+    int8_t velocity_x[SECTOR_CELLS];
+    int8_t velocity_y[SECTOR_CELLS];
+} SectorData;
+
+struct SaveFile;
+struct SaveSector;
+
+typedef struct Sector {
+    int32_t sx, sy;
+    SectorData *data;      // NULL while paged out or still in the snapshot
+    int64_t page_offset;   // extent in the page file while paged out
+    uint32_t page_bytes;
+    const struct SaveSector *saved;  // undecoded in the loaded snapshot
+    uint64_t stored_tick;  // tick its contents last changed
+    bool pinned;           // data is being read by a save in progress
+    struct Sector *next;   // hash chain
+} Sector;
+
+typedef struct {
+    int64_t offset;
+    uint32_t bytes;
+} PageExtent;
+
+typedef struct SectorMap {
+    Sector **buckets;
+    uint32_t bucket_mask;
+    uint32_t count;          // sectors stored, resident or paged
+
+    // Block pool
+    SectorData **slabs;
+    int slab_count;
+    int slab_capacity;
+    SectorData **free_blocks;
+    uint32_t free_count;
+    uint32_t block_count;    // blocks carved from slabs so far
+
+    // Paging
+    FILE *page_file;
+    int64_t page_end;
+    PageExtent *holes;       // freed extents, reused first fit
+    int hole_count;
+    int hole_capacity;
+    uint32_t paged;          // sectors currently on disk
+    int page_distance;       // sectors from the window before paging out
+    uint64_t page_after;     // ticks unchanged before paging out
+    uint8_t *scratch;        // encode/decode buffer
+
+    // Snapshots
+    struct SaveFile *backing;  // snapshot the map was loaded from, or NULL
+    bool saving;               // a save holds pinned blocks and page extents
+    SectorData **orphans;      // pinned blocks replaced while saving
+    uint32_t orphan_count;
+    uint32_t orphan_capacity;
+    PageExtent *deferred;      // extents freed while saving, reusable after
+    int deferred_count;
+    int deferred_capacity;
+
+    // Window, in sectors
+    int32_t window_sx;
+    int32_t window_sy;
+    int window_w;
+    int window_h;
+} SectorMap;
+
+// `page_path` names the page file; NULL uses an anonymous temporary file
+SectorMap *sector_map_create(int window_w, int window_h, const char *page_path);
+void sector_map_destroy(SectorMap *map);
+
+// The world must be window_w * SECTOR_SIZE by window_h * SECTOR_SIZE cells.
+// Stores the window into the map, keeping the world as it is.
+bool sector_map_store_window(SectorMap *map, const World *world);
+// Stores the window and replaces it with the sectors at (sx, sy). Sectors
+// loaded into the world leave the map; the world is their only copy.
+bool sector_map_move_window(SectorMap *map, World *world, int32_t sx, int32_t sy);
+// Replaces the window with the sectors at (sx, sy) without storing it first
+bool sector_map_load_window(SectorMap *map, World *world, int32_t sx, int32_t sy);
+// Pages out resident sectors that are far enough from the window and have
+// not changed for page_after ticks. Returns how many went to disk.
+int sector_map_page_out(SectorMap *map, uint64_t tick);
+
+Sector *sector_map_find(const SectorMap *map, int32_t sx, int32_t sy);
+// Planes of a stored sector, paging it back in if needed; NULL on I/O error
+SectorData *sector_map_data(SectorMap *map, Sector *sector);
+
+// Decodes a page (the four planes, run-length coded); false if malformed
+bool sector_decode_page(const uint8_t *page, size_t bytes, SectorData *out);
+
+// Drops every sector and takes `backing` (may be NULL) as the snapshot to
+// decode from, closing the previous one. Not while saving.
+void sector_map_reset(SectorMap *map, struct SaveFile *backing);
+// Adds a sector whose planes are still in the backing snapshot
+Sector *sector_map_insert_saved(SectorMap *map, int32_t sx, int32_t sy, const struct SaveSector *saved);
+
+// Pins every resident block and holds back freed page extents for a save,
+// and releases them again once the save is done. Pinning fails only if it
+// cannot reserve room to hand over the blocks.
+bool sector_map_pin(SectorMap *map);
+void sector_map_unpin(SectorMap *map);
+
+size_t sector_map_memory_bytes(const SectorMap *map);
+
+// Floor division, for turning cell coordinates into sectors
+static inline int32_t sector_floor_div(int64_t a, int32_t b) {
+    return (int32_t)(a >= 0 ? a / b : -((-a + b - 1) / b));
+}
+
+#endif
@@ -0,0 +1,1052 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "chunk.h"
+#include "pool.h"
+#include "rng.h"
+#include "thermal.h"
+#include "support.h"
+#include "profile.h"
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~    LAYOUT    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The grid carries a one-cell WALL border, so every neighbour of an interior
+// cell is a fixed offset away and never out of bounds.
+static void init_neighbor_offsets(World *world) {
+    int stride = world->stride;
+    world->neighbor_offset[NEIGHBOR_TOP_LEFT]     = -stride - 1;
+    world->neighbor_offset[NEIGHBOR_TOP]          = -stride;
+    world->neighbor_offset[NEIGHBOR_TOP_RIGHT]    = -stride + 1;
+    world->neighbor_offset[NEIGHBOR_LEFT]         = -1;
+    world->neighbor_offset[NEIGHBOR_RIGHT]        = 1;
+    world->neighbor_offset[NEIGHBOR_BOTTOM_LEFT]  = stride - 1;
+    world->neighbor_offset[NEIGHBOR_BOTTOM]       = stride;
+    world->neighbor_offset[NEIGHBOR_BOTTOM_RIGHT] = stride + 1;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~    STORAGE    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Flag words are shared by neighbouring tiles, and tile mode runs those on
+// different threads, so every flag access goes through relaxed atomics.
+static inline bool flag_get(const uint64_t *plane, int idx) {
+    return (__atomic_load_n(&plane[idx >> 6], __ATOMIC_RELAXED) >> (idx & 63)) & 1;
+}
+
+static inline void flag_put(uint64_t *plane, int idx, bool value) {
+    uint64_t bit = 1ULL << (idx & 63);
+    if (value) {
+        __atomic_fetch_or(&plane[idx >> 6], bit, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_and(&plane[idx >> 6], ~bit, __ATOMIC_RELAXED);
+    }
+}
+
+static void flag_fill_range(uint64_t *plane, int start, int count, bool value) {
+    int end = start + count;  // exclusive
+    while (start < end) {
+        int bit = start & 63;
+        int span = 64 - bit < end - start ? 64 - bit : end - start;
+        uint64_t mask = (span == 64 ? ~0ULL : ((1ULL << span) - 1)) << bit;
+        if (value) {
+            __atomic_fetch_or(&plane[start >> 6], mask, __ATOMIC_RELAXED);
+        } else {
+            __atomic_fetch_and(&plane[start >> 6], ~mask, __ATOMIC_RELAXED);
+        }
+        start += span;
+    }
+}
+
+// The grid is updated in place. A particle counts as updated this tick when
+// its flag bit equals the tick's parity, so the flags never need a clearing
+// pass: moving to the next tick flips the meaning of every bit at once.
+// Flags only guard against processing a particle twice; whether a cell can be
+// moved into is decided by its type alone.
+static inline bool tick_parity(const World *world) {
+    return world->tick & 1;
+}
+
+static inline bool is_updated(const World *world, int idx) {
+    return flag_get(world->grid.updated, idx) == tick_parity(world);
+}
+
+static inline void set_updated(World *world, int idx) {
+    flag_put(world->grid.updated, idx, tick_parity(world));
+}
+
+static bool planes_alloc(CellPlanes *planes, int count) {
+    planes->type = (uint8_t *)malloc(count * sizeof(uint8_t));
+    planes->temperature = (int16_t *)malloc(count * sizeof(int16_t));
+    planes->velocity_x = (int8_t *)malloc(count * sizeof(int8_t));
+    planes->velocity_y = (int8_t *)malloc(count * sizeof(int8_t));
+    planes->updated = (uint64_t *)calloc((count + 63) / 64, sizeof(uint64_t));
+    return planes->type && planes->temperature && planes->velocity_x &&
+           planes->velocity_y && planes->updated;
+}
+
+static void planes_free(CellPlanes *planes) {
+    free(planes->type);
+    free(planes->temperature);
+    free(planes->velocity_x);
+    free(planes->velocity_y);
+    free(planes->updated);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~    PHYSICS    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void swap_cells(CellPlanes *planes, int a, int b) {
+    uint8_t type = planes->type[a];
+    planes->type[a] = planes->type[b];
+    planes->type[b] = type;
+
+    int16_t temperature = planes->temperature[a];
+    planes->temperature[a] = planes->temperature[b];
+    planes->temperature[b] = temperature;
+
+    int8_t velocity_x = planes->velocity_x[a];
+    planes->velocity_x[a] = planes->velocity_x[b];
+    planes->velocity_x[b] = velocity_x;
+
+    int8_t velocity_y = planes->velocity_y[a];
+    planes->velocity_y[a] = planes->velocity_y[b];
+    planes->velocity_y[b] = velocity_y;
+
+    bool updated_a = flag_get(planes->updated, a);
+    bool updated_b = flag_get(planes->updated, b);
+    if (updated_a != updated_b) {
+        flag_put(planes->updated, a, updated_b);
+        flag_put(planes->updated, b, updated_a);
+    }
+}
+
+static inline int8_t velocity_add(int8_t velocity, int delta, int limit) {
+    int v = velocity + delta;
+    return (int8_t)(v > limit ? limit : v);
+}
+
+// Follows a falling particle's velocity through empty cells. The path is
+// traced with a DDA over whole cells and ends on the last empty cell before
+// the first obstacle, at most MAX_TRAVEL rows down. Only the destination is
+// returned, the cells passed over stay empty. *travelled gets the rows made.
+// The cell straight below must be empty. The border row below the grid is
+// as far as it goes: it is a WALL, or a neighbour's halo (world_set_halo).
+static int trace_fall(const World *world, int idx, int velocity_x, int velocity_y, int *travelled) {
+    const uint8_t *type = world->grid.type;
+    int rows = velocity_y / VELOCITY_ONE;
+    int room = world->rows - idx / world->stride + 1;
+    if (rows < 1) rows = 1;
+    if (rows > MAX_TRAVEL) rows = MAX_TRAVEL;
+    if (rows > room) rows = room;
+    // Horizontal drift over the same time, truncated toward zero
+    int cols = velocity_x * rows / (velocity_y > 0 ? velocity_y : VELOCITY_ONE);
+    if (cols > MAX_TRAVEL) cols = MAX_TRAVEL;
+    if (cols < -MAX_TRAVEL) cols = -MAX_TRAVEL;
+
+    int step_x = cols < 0 ? -1 : 1;
+    int span_x = cols < 0 ? -cols : cols;
+    int error = 0;
+    int dest = idx;
+    for (int row = 1; row <= rows; row++) {
+        int next = dest + world->stride;
+        // Bresenham: rows always dominate, columns advance on overflow
+        error += span_x;
+        if (2 * error >= rows) {
+            next += step_x;
+            error -= rows;
+        }
+        if (type[next] != NONE) break;
+        dest = next;
+        *travelled = row;
+    }
+    // A blocked diagonal first step still leaves the straight drop, which
+    // callers have already checked is empty
+    if (dest == idx) {
+        *travelled = 1;
+        return idx + world->stride;
+    }
+    return dest;
+}
+
+static inline bool rect_holds(const DirtyRect *rect, int x, int y) {
+    return x >= rect->x0 && x <= rect->x1 && y >= rect->y0 && y <= rect->y1;
+}
+
+static inline bool rect_same(const DirtyRect *a, const DirtyRect *b) {
+    return a->x0 == b->x0 && a->y0 == b->y0 && a->x1 == b->x1 && a->y1 == b->y1;
+}
+
+// A flag matching the parity may also be a stamp from an even number of
+// ticks ago, left while its tile slept. None may be inside a rect the sweep
+// visits: update_grid resets every rect as the tick starts, and area a rect
+// takes in during the sweep is reset here before anything can move into it.
+// Kernels therefore mark a destination before stamping it.
+//
+// Resets the flags of the cells in `area` outside every rect of `keep`.
+static void reset_stamps(World *world, const DirtyRect *area, const DirtyRect *const *keep, int keep_count) {
+    bool value = !tick_parity(world);
+    for (int y = area->y0; y <= area->y1; y++) {
+        int x = area->x0;
+        while (x <= area->x1) {
+            // Step past the rects covering x, then clear up to the next one
+            for (int k = 0; k < keep_count; k++) {
+                if (rect_holds(keep[k], x, y)) {
+                    x = keep[k]->x1 + 1;
+                    k = -1;
+                }
+            }
+            if (x > area->x1) break;
+            int end = area->x1;
+            for (int k = 0; k < keep_count; k++) {
+                const DirtyRect *r = keep[k];
+                if (y >= r->y0 && y <= r->y1 && r->x0 > x && r->x0 <= end) end = r->x0 - 1;
+            }
+            flag_fill_range(world->grid.updated, world_index(world, x, y), end - x + 1, value);
+            x = end + 1;
+        }
+    }
+}
+
+// Wakes the tiles around a cell that changed this tick. The 3x3 mark lands
+// in at most 2x2 tiles; whatever their rects take in is reset. A rect in an
+// outbox keeps the tile's own rect too: that area is reset already and may
+// hold cells moved in by an earlier phase.
+static inline void mark_changed(World *world, UpdateCtx *ctx, int idx) {
+    ChunkMap *chunks = world->chunks;
+    int x = idx % world->stride - 1;
+    int y = idx / world->stride - 1;
+    int x0 = x > 0 ? x - 1 : 0;
+    int y0 = y > 0 ? y - 1 : 0;
+    int x1 = x + 1 < world->cols ? x + 1 : world->cols - 1;
+    int y1 = y + 1 < world->rows ? y + 1 : world->rows - 1;
+
+    int tiles[4];
+    DirtyRect *rects[4];
+    DirtyRect before[4];
+    int n = 0;
+    for (int ty = y0 / CHUNK_SIZE; ty <= y1 / CHUNK_SIZE; ty++) {
+        for (int tx = x0 / CHUNK_SIZE; tx <= x1 / CHUNK_SIZE; tx++) {
+            tiles[n] = ty * chunks->tiles_x + tx;
+            rects[n] = chunks_sweep_rect(chunks, ctx->outbox, tiles[n]);
+            before[n] = *rects[n];
+            n++;
+        }
+    }
+    if (ctx->outbox) {
+        chunks_mark_local(chunks, ctx->outbox, x, y);
+    } else {
+        chunks_mark(chunks, x, y);
+    }
+    for (int k = 0; k < n; k++) {
+        if (rect_same(rects[k], &before[k])) continue;
+        const DirtyRect *keep[2] = { &before[k], &chunks->current[tiles[k]] };
+        reset_stamps(world, rects[k], keep, rects[k] == keep[1] ? 1 : 2);
+    }
+}
+
+// Draw slots for rng_*. A cell runs one kernel per tick, so slots only have
+// to be distinct within a kernel.
+enum {
+    DRAW_SLIDE,       // powder/liquid: pick a diagonal
+    DRAW_SPREAD,      // liquid: pick a side
+    DRAW_EVAPORATE,
+    DRAW_DECAY,       // fire
+    DRAW_RISE,
+    DRAW_SCORCH       // fire, one per neighbour direction
+};
+
+// Depth comes from the prefix pass of the previous tick, see update_depth
+float calculate_water_pressure(const World *world, int idx) {
+    return 1.0f + (world->depth[idx] * 0.2f);
+}
+
+// Kernels are written once per movement class and take the element they run
+// for as a constant, so every element_info[self] lookup folds away. The
+// table at the end of this section stamps out one specialised function per
+// element and cell_kernels dispatches on the type byte alone.
+
+static inline bool is_solid(uint8_t type) {
+    return element_info[type].move == MOVE_SOLID;
+}
+
+// A powder left idx, so a solid resting on it may have lost its support
+static inline void support_vacated(World *world, UpdateCtx *ctx, int idx) {
+    const uint8_t *type = world->grid.type;
+    if (is_solid(type[get_neighbor(world, idx, NEIGHBOR_TOP_LEFT)]) ||
+        is_solid(type[get_neighbor(world, idx, NEIGHBOR_TOP)]) ||
+        is_solid(type[get_neighbor(world, idx, NEIGHBOR_TOP_RIGHT)])) {
+        support_push(ctx->seeds, idx);
+    }
+}
+
+// Whether a powder/liquid of element self may move into a cell of other
+static inline bool can_displace(Element self, uint8_t other) {
+    return other == NONE ||
+           (element_info[other].move == MOVE_LIQUID && element_info[other].density < element_info[self].density);
+}
+
+static inline void powder_step(World *world, UpdateCtx *ctx, int idx, Element self) {
+    CellPlanes *grid = &world->grid;
+    const uint8_t *type = grid->type;
+
+    int below = get_neighbor(world, idx, NEIGHBOR_BOTTOM);
+    int below_left = get_neighbor(world, idx, NEIGHBOR_BOTTOM_LEFT);
+    int below_right = get_neighbor(world, idx, NEIGHBOR_BOTTOM_RIGHT);
+
+    // FLOW STATE - same pattern as liquids for consistency
+    int flow_down = can_displace(self, type[below]);
+    int flow_down_left = can_displace(self, type[below_left]);
+    int flow_down_right = can_displace(self, type[below_right]);
+
+    // PRIMARY MOVEMENT LOGIC
+    if (flow_down) {
+        // Direct fall - increase velocity and cover that many empty cells
+        int8_t velocity_y = velocity_add(grid->velocity_y[idx], VELOCITY_ONE / 2, MAX_TRAVEL * VELOCITY_ONE);
+        int target = below;
+        int travelled = 1;
+        if (type[below] == NONE) {
+            target = trace_fall(world, idx, grid->velocity_x[idx], velocity_y, &travelled);
+        }
+        swap_cells(grid, idx, target);
+        // Stopped short by an obstacle: keep only the speed actually made
+        if (travelled < velocity_y / VELOCITY_ONE) velocity_y = (int8_t)(travelled * VELOCITY_ONE);
+        grid->velocity_y[target] = velocity_y;
+        mark_changed(world, ctx, idx);
+        mark_changed(world, ctx, target);
+        set_updated(world, target);
+        support_vacated(world, ctx, idx);
+        return;
+    }
+
+    // More aggressive diagonal movement
+    if (flow_down_left || flow_down_right) {
+        int target;
+
+        // If both sides available, use velocity and randomness
+        if (flow_down_left && flow_down_right) {
+            // Bias based on horizontal velocity
+            float left_chance = world->params.slide_left;
+
+            target = (rng_unit(world->tick_key, idx, DRAW_SLIDE) < left_chance) ? below_left : below_right;
+        } else {
+            target = flow_down_left ? below_left : below_right;
+        }
+
+        swap_cells(grid, idx, target);
+        mark_changed(world, ctx, idx);
+        mark_changed(world, ctx, target);
+        set_updated(world, target);
+        support_vacated(world, ctx, idx);
+
+        // Update velocity for next frame
+        grid->velocity_y[target] = velocity_add(grid->velocity_y[target], VELOCITY_ONE * 3 / 10, VELOCITY_ONE * 3 / 2);
+        grid->velocity_x[target] = (target == below_left) ? -VELOCITY_ONE / 2 : VELOCITY_ONE / 2;
+
+        return;
+    }
+
+    // If we can't move, slowly reset velocities
+    grid->velocity_x[idx] = grid->velocity_x[idx] * 4 / 5;
+    grid->velocity_y[idx] = grid->velocity_y[idx] * 4 / 5;
+}
+
+static inline void liquid_step(World *world, UpdateCtx *ctx, int idx, Element self) {
+    CellPlanes *grid = &world->grid;
+    const uint8_t *type = grid->type;
+    int boil_point = element_info[self].boil_point;
+    if (boil_point) boil_point += world->params.boil_offset;
+
+    // Neighbours are fixed offsets thanks to the WALL border
+    int below = get_neighbor(world, idx, NEIGHBOR_BOTTOM);
+    int below_left = get_neighbor(world, idx, NEIGHBOR_BOTTOM_LEFT);
+    int below_right = get_neighbor(world, idx, NEIGHBOR_BOTTOM_RIGHT);
+    int left = get_neighbor(world, idx, NEIGHBOR_LEFT);
+    int right = get_neighbor(world, idx, NEIGHBOR_RIGHT);
+
+    // FLOW STATE
+    // Check if cell can flow in each direction (1 = can flow, 0 = blocked)
+    int flow_left = (type[left] == NONE) ? 1 : 0;
+
+    int flow_right = (type[right] == NONE) ? 1 : 0;
+
+    int flow_down = (type[below] == NONE) ? 1 : 0;
+
+    int flow_down_left = (type[below_left] == NONE) ? 1 : 0;
+    
+    int flow_down_right = (type[below_right] == NONE) ? 1 : 0;
+
+    // PRIMARY MOVEMENT LOGIC
+    if (flow_down) {
+        // Fall, accelerating like powders do
+        int8_t velocity_y = velocity_add(grid->velocity_y[idx], VELOCITY_ONE / 2, MAX_TRAVEL * VELOCITY_ONE);
+        int travelled = 1;
+        int target = trace_fall(world, idx, grid->velocity_x[idx], velocity_y, &travelled);
+        swap_cells(grid, idx, target);
+        if (travelled < velocity_y / VELOCITY_ONE) velocity_y = (int8_t)(travelled * VELOCITY_ONE);
+        grid->velocity_y[target] = velocity_y;
+        mark_changed(world, ctx, idx);
+        mark_changed(world, ctx, target);
+        set_updated(world, target);
+    }
+    else if (flow_down_left || flow_down_right) {
+        // Try to flow diagonally
+        int target;
+        if (flow_down_left && flow_down_right) {
+            // Randomize between left and right when both are available
+            target = rng_below(world->tick_key, idx, DRAW_SLIDE, 2) ? below_left : below_right;
+        } else {
+            // Flow to whichever side is available
+            target = flow_down_left ? below_left : below_right;
+        }
+        swap_cells(grid, idx, target);
+        grid->velocity_y[target] = 0;
+        mark_changed(world, ctx, idx);
+        mark_changed(world, ctx, target);
+        set_updated(world, target);
+    }
+    else if (flow_left || flow_right) {
+        // Horizontal flow with momentum
+        int target;
+        if (flow_left && flow_right) {
+            // If both sides open, pick random but bias based on existing velocity
+            target = rng_below(world->tick_key, idx, DRAW_SPREAD, 2) ? left : right;
+        } else {
+            // Flow to whichever side is open
+            target = flow_left ? left : right;
+        }
+        
+        swap_cells(grid, idx, target);
+        mark_changed(world, ctx, idx);
+        mark_changed(world, ctx, target);
+        set_updated(world, target);
+        
+        // Update momentum based on flow direction
+        grid->velocity_x[target] = (target == left) ? -VELOCITY_ONE : VELOCITY_ONE;
+        grid->velocity_y[target] = 0;
+    }
+
+    // Temperature effects - evaporation
+    if (boil_point && grid->temperature[idx] >= boil_point) {
+        // Hot liquid rolls the dice every tick, so it has to stay awake
+        mark_changed(world, ctx, idx);
+        float evaporation_chance = (grid->temperature[idx] - (float)boil_point) / (float)world->params.evaporation_span;
+        if (rng_unit(world->tick_key, idx, DRAW_EVAPORATE) < evaporation_chance) {
+            grid->type[idx] = NONE;
+            grid->temperature[idx] = (int16_t)boil_point;
+        }
+    }
+}
+
+static inline void fire_step(World *world, UpdateCtx *ctx, int idx, Element self) {
+    CellPlanes *grid = &world->grid;
+    (void)self;
+
+    // Fire rolls the dice every tick, so it has to stay awake
+    mark_changed(world, ctx, idx);
+
+    // Natural fire decay
+    if (rng_below(world->tick_key, idx, DRAW_DECAY, 100) < (uint32_t)world->params.fire_decay_pct) {
+        grid->type[idx] = NONE;
+        return;
+    }
+
+    // Interaction with other elements. The heat itself is spread by the
+    // thermal stage (thermal.c), these only read the temperature plane.
+    for (int n = 0; n < 8; n++) {
+        int neighbor_idx = get_neighbor(world, idx, n);
+        const ElementInfo *other = &element_info[grid->type[neighbor_idx]];
+        int temperature = grid->temperature[neighbor_idx];
+
+        // Liquids put the fire out
+        if (other->move == MOVE_LIQUID) {
+            grid->type[idx] = NONE;
+            return;
+        }
+        if (other->burn_pct && temperature > other->burn_point &&
+            rng_below(world->tick_key, idx, DRAW_SCORCH + n, 100) < (uint32_t)other->burn_pct) {
+            grid->type[neighbor_idx] = NONE;
+            mark_changed(world, ctx, neighbor_idx);
+            support_push(ctx->seeds, neighbor_idx);
+        } else if (other->melt_point && temperature > other->melt_point) {
+            grid->type[neighbor_idx] = FIRE;
+            mark_changed(world, ctx, neighbor_idx);
+            support_push(ctx->seeds, neighbor_idx);
+        }
+    }
+
+    // Fire movement
+    int above = get_neighbor(world, idx, NEIGHBOR_TOP);
+    if (grid->type[above] == NONE && rng_below(world->tick_key, idx, DRAW_RISE, 100) < 70) {
+        swap_cells(grid, idx, above);
+        mark_changed(world, ctx, above);
+        set_updated(world, above);
+    }
+}
+
+// Solids only melt here. Whether they are held up is a property of the
+// whole body they belong to, see support.h.
+static inline void solid_step(World *world, UpdateCtx *ctx, int idx, Element self) {
+    CellPlanes *grid = &world->grid;
+    const int melt_point = element_info[self].melt_point;
+
+    if (melt_point && grid->temperature[idx] > melt_point) {
+        grid->type[idx] = FIRE;
+        mark_changed(world, ctx, idx);
+        support_push(ctx->seeds, idx);
+    }
+}
+
+typedef void (*CellKernel)(World *world, UpdateCtx *ctx, int idx);
+
+// One specialised kernel per non-inert element; inert elements get no entry
+#define KERNEL_inert(name)
+#define KERNEL_powder(name) KERNEL_DEFINE(name, powder_step)
+#define KERNEL_liquid(name) KERNEL_DEFINE(name, liquid_step)
+#define KERNEL_solid(name)  KERNEL_DEFINE(name, solid_step)
+#define KERNEL_fire(name)   KERNEL_DEFINE(name, fire_step)
+#define KERNEL_DEFINE(name, step) \
+    static void update_##name(World *world, UpdateCtx *ctx, int idx) { step(world, ctx, idx, name); }
+#define ELEMENT_KERNEL(name, density, move, ...) KERNEL_##move(name)
+ELEMENT_TABLE(ELEMENT_KERNEL)
+
+#define ENTRY_inert(name)  NULL
+#define ENTRY_powder(name) update_##name
+#define ENTRY_liquid(name) update_##name
+#define ENTRY_solid(name)  update_##name
+#define ENTRY_fire(name)   update_##name
+#define ELEMENT_ENTRY(name, density, move, ...) [name] = ENTRY_##move(name),
+static const CellKernel cell_kernels[ELEMENT_COUNT] = {
+    ELEMENT_TABLE(ELEMENT_ENTRY)
+};
+
+static inline void update_cell(World *world, UpdateCtx *ctx, int idx) {
+    CellKernel kernel = cell_kernels[world->grid.type[idx]];
+    if (kernel) kernel(world, ctx, idx); // Inert cells don't need updating
+}
+
+// Visits one row span of a tile. Moving particles stamp their destination;
+// afterwards the whole span is stamped with the current parity, whether its
+// cells moved or not, so next tick sees all of them as not yet updated.
+//
+// A cell whose bit already matches the parity moved here this tick (stale
+// stamps never survive inside a rect, see reset_stamps). It is skipped and
+// kept awake for the next tick.
+static inline void update_span(World *world, UpdateCtx *ctx, int row, DirtyRect *rect) {
+    int base = (row + 1) * world->stride + 1;
+    PROFILE_SPAN_BEGIN();
+
+    for (int j = rect->x0; j <= rect->x1; j++) {
+        int idx = base + j;
+        if (is_updated(world, idx)) {
+            PROFILE_SKIP(world->grid.type[idx]);
+            mark_changed(world, ctx, idx);
+            continue;
+        }
+        PROFILE_CELL_BEGIN(world->grid.type[idx]);
+        update_cell(world, ctx, idx);
+        PROFILE_CELL_END(world->grid.type[idx]);
+    }
+    PROFILE_SPAN_END();
+    flag_fill_range(world->grid.updated, base + rect->x0, rect->x1 - rect->x0 + 1, tick_parity(world));
+}
+
+static void update_grid_rows(World *world) {
+    ChunkMap *chunks = world->chunks;
+    UpdateCtx ctx = { .outbox = NULL, .seeds = support_main_queue(world->support) };
+
+    // Update from bottom to top for gravity-based elements. Rects may grow
+    // while the sweep runs, so bounds are re-read on every step.
+    for (int i = world->rows - 1; i >= 0; i--) {
+        DirtyRect *tile_row = &chunks->current[(i / CHUNK_SIZE) * chunks->tiles_x];
+
+        for (int tx = 0; tx < chunks->tiles_x; tx++) {
+            DirtyRect *rect = &tile_row[tx];
+            if (i < rect->y0 || i > rect->y1) continue;
+            update_span(world, &ctx, i, rect);
+        }
+    }
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~    TILE PHASES    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Tiles run in four checkerboard phases. Kernels reach at most MAX_TRAVEL + 1
+// cells past their own tile, less than a tile, so two tiles of the same
+// phase (at least one tile apart) never read or write the same cell and can
+// run on different threads.
+#if MAX_TRAVEL + 1 >= CHUNK_SIZE
+#error "MAX_TRAVEL must stay below CHUNK_SIZE - 1 for the tile phases"
+#endif
+
+typedef struct {
+    World *world;
+    int *tiles;
+} PhaseJob;
+
+static void sweep_tile_task(void *arg, int index) {
+    PhaseJob *job = (PhaseJob *)arg;
+    World *world = job->world;
+    int t = job->tiles[index];
+
+    ChunkOutbox *box = &world->outboxes[t];
+    chunks_outbox_reset(box, world->chunks, t);
+    UpdateCtx ctx = { .outbox = box, .seeds = &world->support->queues[t] };
+
+    // Own rect only grows from this thread; re-read bounds like the row sweep
+    DirtyRect *rect = &world->chunks->current[t];
+    for (int i = rect->y1; i >= rect->y0; i--) {
+        update_span(world, &ctx, i, rect);
+    }
+}
+
+// The up to 8 tiles around `tile`
+static int tiles_around(const ChunkMap *chunks, int tile, int *out) {
+    int tx = tile % chunks->tiles_x;
+    int ty = tile / chunks->tiles_x;
+    int n = 0;
+    for (int y = ty - 1; y <= ty + 1; y++) {
+        for (int x = tx - 1; x <= tx + 1; x++) {
+            if (x < 0 || y < 0 || x >= chunks->tiles_x || y >= chunks->tiles_y || (x == tx && y == ty)) continue;
+            out[n++] = y * chunks->tiles_x + x;
+        }
+    }
+    return n;
+}
+
+// Merges the outboxes of a phase's tiles. A merged rect is the bounding box
+// of the tile's rect and the marks, so it can take in area nobody marked,
+// which may hold stale stamps and is reset. The outboxes' own area is spared:
+// their tiles reset it when marking and may have moved cells into it since.
+// Outboxes are left empty, so those of tiles that did not run never count.
+static void merge_phase(World *world, const int *tiles, int count) {
+    ChunkMap *chunks = world->chunks;
+    DirtyRect *before = world->phase_rects;
+    int around[8];
+
+    for (int k = 0; k < count; k++) {
+        int n = tiles_around(chunks, tiles[k], around);
+        for (int i = 0; i < n; i++) before[around[i]] = chunks->current[around[i]];
+    }
+    for (int k = 0; k < count; k++) chunks_flush_outbox(chunks, &world->outboxes[tiles[k]]);
+
+    for (int k = 0; k < count; k++) {
+        int n = tiles_around(chunks, tiles[k], around);
+        for (int i = 0; i < n; i++) {
+            int t = around[i];
+            if (rect_same(&chunks->current[t], &before[t])) continue;
+            // Marks into t only come from this phase's tiles next to it
+            int homes[8];
+            int h = tiles_around(chunks, t, homes);
+            const DirtyRect *keep[9] = { &before[t] };
+            for (int j = 0; j < h; j++) keep[j + 1] = chunks_sweep_rect(chunks, &world->outboxes[homes[j]], t);
+            reset_stamps(world, &chunks->current[t], keep, h + 1);
+            before[t] = chunks->current[t];
+        }
+    }
+    for (int k = 0; k < count; k++) chunks_outbox_reset(&world->outboxes[tiles[k]], chunks, tiles[k]);
+}
+
+static void update_grid_tiles(World *world) {
+
+    ChunkMap *chunks = world->chunks;
+    PhaseJob job = { .world = world, .tiles = world->phase_tiles };
+
+    for (int phase = 0; phase < 4; phase++) {
+        int phase_x = phase & 1;
+        int phase_y = phase >> 1;
+
+        // Collected after the previous phase's marks were merged, so tiles
+        // woken earlier in this tick still run
+        int count = 0;
+        for (int ty = phase_y; ty < chunks->tiles_y; ty += 2) {
+            for (int tx = phase_x; tx < chunks->tiles_x; tx += 2) {
+                int t = ty * chunks->tiles_x + tx;
+                if (!rect_empty(&chunks->current[t])) job.tiles[count++] = t;
+            }
+        }
+
+        pool_run(world->pool, count, sweep_tile_task, &job);
+
+        merge_phase(world, job.tiles, count);
+    }
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~    PRESSURE    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Top-down prefix pass: depth[i] counts the water cells stacked directly
+// above a water cell. Only tile columns with an awake tile are redone, the
+// others cannot have changed since their last pass.
+static void update_depth(World *world) {
+    ChunkMap *chunks = world->chunks;
+    const uint8_t *type = world->grid.type;
+    uint16_t *depth = world->depth;
+    int stride = world->stride;
+
+    for (int tx = 0; tx < chunks->tiles_x; tx++) {
+        bool awake = false;
+        for (int ty = 0; ty < chunks->tiles_y && !awake; ty++) {
+            awake = !rect_empty(&chunks->current[ty * chunks->tiles_x + tx]);
+        }
+        if (!awake) continue;
+
+        int x0 = tx * CHUNK_SIZE;
+        int x1 = x0 + CHUNK_SIZE < world->cols ? x0 + CHUNK_SIZE : world->cols;
+        for (int y = 0; y < world->rows; y++) {
+            int base = world_index(world, 0, y);
+            for (int x = x0; x < x1; x++) {
+                int i = base + x;
+                bool stacked = type[i] == WATER && type[i - stride] == WATER;
+                depth[i] = stacked ? depth[i - stride] + 1 : 0;
+            }
+        }
+    }
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Every column of a horizontal water run is connected through row y, so its
+// surface (the top of its stack) may pass water to any other. Surfaces are
+// sorted and the highest feeds the lowest, second highest the second lowest
+// and so on, one cell per column per tick. The surfaces that moved are often
+// in other tiles, so the run itself is kept awake while water still flows.
+static void level_run(World *world, int y, int x0, int x1) {
+    CellPlanes *grid = &world->grid;
+    uint64_t *order = world->level_order;
+    int count = 0;
+
+    for (int x = x0; x <= x1; x++) {
+        if (world->level_stamp[x] == world->tick + 1) continue;
+        int top = y - world->depth[world_index(world, x, y)];
+        order[count++] = (uint64_t)top << 32 | (uint32_t)x;
+    }
+    if (count < 2) return;
+    qsort(order, count, sizeof(uint64_t), compare_u64);
+    bool moved = false;
+
+    int high = 0;
+    int low = count - 1;
+    while (high < low) {
+        int top_high = (int)(order[high] >> 32);
+        int top_low = (int)(order[low] >> 32);
+        int x_high = (int)(uint32_t)order[high];
+        int x_low = (int)(uint32_t)order[low];
+        if (top_low - top_high < 2) break;
+
+        int source = world_index(world, x_high, top_high);
+        int dest = world_index(world, x_low, top_low - 1);
+        world->level_stamp[x_low] = world->tick + 1;
+        low--;
+        // A capped column cannot take more water
+        if (grid->type[dest] != NONE) continue;
+
+        swap_cells(grid, source, dest);
+        world->level_stamp[x_high] = world->tick + 1;
+        high++;
+        world_mark_dirty(world, source);
+        world_mark_dirty(world, dest);
+        moved = true;
+    }
+    if (moved) chunks_mark_rect(world->chunks, x0, y, x1, y);
+}
+
+// Pressure-driven levelling. Runs bottom-up so the widest connections are
+// used first. Only runs that cross a dirty rect are looked at: tile rows
+// without an awake tile are skipped whole, and within a row the scan starts
+// from the rects covering it and follows each run out to its ends.
+static void level_water(World *world) {
+    ChunkMap *chunks = world->chunks;
+    const uint8_t *type = world->grid.type;
+
+    for (int ty = chunks->tiles_y - 1; ty >= 0; ty--) {
+        const DirtyRect *tile_row = &chunks->current[ty * chunks->tiles_x];
+        bool awake = false;
+        for (int tx = 0; tx < chunks->tiles_x && !awake; tx++) awake = !rect_empty(&tile_row[tx]);
+        if (!awake) continue;
+
+        int y_top = ty * CHUNK_SIZE;
+        int y_bottom = y_top + CHUNK_SIZE < world->rows ? y_top + CHUNK_SIZE - 1 : world->rows - 1;
+        for (int y = y_bottom; y >= y_top; y--) {
+            int base = world_index(world, 0, y);
+            int done = 0;  // runs before this column have been levelled
+            // Rects may grow while levelling, so bounds are re-read
+            for (int tx = 0; tx < chunks->tiles_x; tx++) {
+                const DirtyRect *rect = &tile_row[tx];
+                if (y < rect->y0 || y > rect->y1) continue;
+                int x = rect->x0 > done ? rect->x0 : done;
+                while (x <= rect->x1) {
+                    if (type[base + x] != WATER) {
+                        x++;
+                        continue;
+                    }
+                    int x0 = x;
+                    while (x0 > 0 && type[base + x0 - 1] == WATER) x0--;
+                    while (x < world->cols && type[base + x] == WATER) x++;
+                    level_run(world, y, x0, x - 1);
+                    done = x;
+                }
+                if (x > done) done = x;
+            }
+        }
+    }
+}
+
+void update_grid(World *world) {
+    ChunkMap *chunks = world->chunks;
+    chunks_begin_tick(chunks, !world->chunking);
+    // Nothing can have been updated yet this tick, see reset_stamps
+    for (int t = 0; t < chunks->tiles_x * chunks->tiles_y; t++) {
+        if (!rect_empty(&chunks->current[t])) reset_stamps(world, &chunks->current[t], NULL, 0);
+    }
+    world->tick_key = rng_tick_key(world->rng_key, world->tick);
+
+    PROFILE_BEGIN(PROFILE_SWEEP);
+    if (world->pool) {
+        update_grid_tiles(world);
+    } else {
+        update_grid_rows(world);
+    }
+    PROFILE_END(PROFILE_SWEEP);
+
+    PROFILE_BEGIN(PROFILE_SUPPORT);
+    support_resolve(world);
+    PROFILE_END(PROFILE_SUPPORT);
+
+    PROFILE_BEGIN(PROFILE_DEPTH);
+    update_depth(world);
+    PROFILE_END(PROFILE_DEPTH);
+    if (world->levelling) {
+        PROFILE_BEGIN(PROFILE_LEVELLING);
+        level_water(world);
+        PROFILE_END(PROFILE_LEVELLING);
+    }
+    PROFILE_BEGIN(PROFILE_THERMAL);
+    thermal_step(world);
+    PROFILE_END(PROFILE_THERMAL);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~    WORLD    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+const SimParams sim_default_params = {
+    .fire_decay_pct = 5,
+    .slide_left = 0.9f,
+    .boil_offset = 0,
+    .evaporation_span = 20,
+};
+
+// Everything but the cell planes, which the caller has set up already
+static World *world_init(World *world, int rows, int cols, unsigned int seed, bool planes_ok) {
+    world->rows = rows;
+    world->cols = cols;
+    world->stride = cols + 2;
+    world->seed = seed;
+    world->rng_key = rng_key(seed);
+    world->params = sim_default_params;
+    init_neighbor_offsets(world);
+
+    world->level_order = (uint64_t *)malloc(cols * sizeof(uint64_t));
+    world->level_stamp = (uint64_t *)calloc(cols, sizeof(uint64_t));
+    world->levelling = true;
+    world->thermal_isa = thermal_best_isa();
+    world->chunks = chunks_create(rows, cols);
+    world->chunking = true;
+    if (world->chunks) {
+        int cells = (rows + 2) * world->stride;
+        world->support = support_create(cells, world->chunks->tiles_x * world->chunks->tiles_y);
+    }
+    if (!planes_ok || !world->heat_next || !world->depth || !world->level_order ||
+        !world->level_stamp || !world->chunks || !world->support) {
+        fprintf(stderr, "Failed to allocate %dx%d world\n", cols, rows);
+        world_destroy(world);
+        return NULL;
+    }
+
+    srand(seed);  // scenario scatter only, kernels use rng.h
+    world_clear(world);
+    return world;
+}
+
+World *world_create(int rows, int cols, unsigned int seed) {
+    World *world = (World *)calloc(1, sizeof(World));
+    if (!world) return NULL;
+
+    int cells = (rows + 2) * (cols + 2);
+    bool planes_ok = planes_alloc(&world->grid, cells);
+    world->heat_next = (int16_t *)malloc(cells * sizeof(int16_t));
+    world->depth = (uint16_t *)calloc(cells, sizeof(uint16_t));
+    return world_init(world, rows, cols, seed, planes_ok);
+}
+
+// Block layout: the World, then every plane on its own cache line
+static size_t block_round(size_t bytes) {
+    return (bytes + 63) & ~(size_t)63;
+}
+
+static void *block_take(uint8_t **at, size_t bytes) {
+    void *p = *at;
+    *at += block_round(bytes);
+    return p;
+}
+
+size_t world_block_bytes(int rows, int cols) {
+    size_t cells = (size_t)(rows + 2) * (cols + 2);
+    return block_round(sizeof(World)) + block_round(cells * sizeof(uint8_t)) +
+           2 * block_round(cells * sizeof(int16_t)) + block_round(cells * sizeof(uint16_t)) +
+           2 * block_round(cells * sizeof(int8_t)) + block_round((cells + 63) / 64 * sizeof(uint64_t));
+}
+
+World *world_create_in(void *block, int rows, int cols, unsigned int seed) {
+    size_t cells = (size_t)(rows + 2) * (cols + 2);
+    uint8_t *at = (uint8_t *)block;
+    World *world = (World *)block_take(&at, sizeof(World));
+    memset(world, 0, sizeof(World));
+    world->in_block = true;
+    world->grid.type = (uint8_t *)block_take(&at, cells * sizeof(uint8_t));
+    world->grid.temperature = (int16_t *)block_take(&at, cells * sizeof(int16_t));
+    world->heat_next = (int16_t *)block_take(&at, cells * sizeof(int16_t));
+    world->depth = (uint16_t *)block_take(&at, cells * sizeof(uint16_t));
+    world->grid.velocity_x = (int8_t *)block_take(&at, cells * sizeof(int8_t));
+    world->grid.velocity_y = (int8_t *)block_take(&at, cells * sizeof(int8_t));
+    world->grid.updated = (uint64_t *)block_take(&at, (cells + 63) / 64 * sizeof(uint64_t));
+    memset(world->grid.updated, 0, (cells + 63) / 64 * sizeof(uint64_t));
+    return world_init(world, rows, cols, seed, true);
+}
+
+void world_destroy(World *world) {
+    if (!world) return;
+    if (!world->in_block) {
+        planes_free(&world->grid);
+        free(world->heat_next);
+        free(world->depth);
+    }
+    free(world->level_order);
+    free(world->level_stamp);
+    world_set_threads(world, 0);
+    chunks_destroy(world->chunks);
+    support_destroy(world->support);
+    if (!world->in_block) free(world);
+}
+
+void world_clear(World *world) {
+    int stride = world->stride;
+    int count = (world->rows + 2) * stride;
+    for (int i = 0; i < count; i++) {
+        int x = i % stride;
+        int y = i / stride;
+        bool border = x == 0 || y == 0 || x == stride - 1 || y == world->rows + 1;
+        world->grid.type[i] = border ? WALL : NONE;
+        world->grid.temperature[i] = AMBIENT_TEMPERATURE;
+        world->heat_next[i] = AMBIENT_TEMPERATURE;  // the border is never rewritten
+    }
+    memset(world->depth, 0, count * sizeof(uint16_t));
+    memset(world->grid.velocity_x, 0, count * sizeof(int8_t));
+    memset(world->grid.velocity_y, 0, count * sizeof(int8_t));
+    flag_fill_range(world->grid.updated, 0, count, !tick_parity(world));
+    world_mark_all(world);
+}
+
+bool world_set_threads(World *world, int threads) {
+    pool_destroy(world->pool);
+    free(world->outboxes);
+    free(world->phase_tiles);
+    free(world->phase_rects);
+    world->pool = NULL;
+    world->outboxes = NULL;
+    world->phase_tiles = NULL;
+    world->phase_rects = NULL;
+    world->threads = 0;
+    if (threads <= 0) return true;
+
+    int tiles = world->chunks->tiles_x * world->chunks->tiles_y;
+    world->pool = pool_create(threads);
+    world->outboxes = (ChunkOutbox *)malloc(tiles * sizeof(ChunkOutbox));
+    world->phase_tiles = (int *)malloc(tiles * sizeof(int));
+    world->phase_rects = (DirtyRect *)malloc(tiles * sizeof(DirtyRect));
+    if (!world->pool || !world->outboxes || !world->phase_tiles || !world->phase_rects) {
+        fprintf(stderr, "Failed to set up %d update threads\n", threads);
+        world_set_threads(world, 0);
+        return false;
+    }
+    for (int t = 0; t < tiles; t++) chunks_outbox_reset(&world->outboxes[t], world->chunks, t);
+    world->threads = threads;
+    return true;
+}
+
+void world_mark_dirty(World *world, int idx) {
+    chunks_mark(world->chunks, idx % world->stride - 1, idx / world->stride - 1);
+}
+
+void world_mark_all(World *world) {
+    chunks_mark_all(world->chunks);
+    support_survey(world->support);
+}
+
+// A write outside the sweep next to or onto a solid may change its support
+static void seed_write(World *world, int idx) {
+    const uint8_t *type = world->grid.type;
+    bool near_solid = is_solid(type[idx]);
+    for (int n = 0; n < 8 && !near_solid; n++) near_solid = is_solid(type[get_neighbor(world, idx, n)]);
+    if (near_solid) support_push(support_main_queue(world->support), idx);
+}
+
+void world_set_cell(World *world, int idx, Element type, int temperature) {
+    world->grid.type[idx] = (uint8_t)type;
+    world->grid.temperature[idx] = (int16_t)temperature;
+    world->grid.velocity_x[idx] = 0;
+    world->grid.velocity_y[idx] = 0;
+    flag_put(world->grid.updated, idx, !tick_parity(world));
+    world_mark_dirty(world, idx);
+    seed_write(world, idx);
+}
+
+void world_set_halo(World *world, int y, const uint8_t *type, const int16_t *temperature) {
+    int start = world_index(world, 0, y);
+    int inward = y < 0 ? world->stride : -world->stride;
+    for (int x = 0; x < world->cols; x++) {
+        int idx = start + x;
+        if (world->grid.type[idx] != type[x]) {
+            world->grid.type[idx] = type[x];
+            world_mark_dirty(world, idx);
+            seed_write(world, idx + inward);
+        }
+        world->grid.temperature[idx] = temperature[x];
+        world->grid.velocity_x[idx] = 0;
+        world->grid.velocity_y[idx] = 0;
+    }
+}
+
+void world_fill_span(World *world, int y, int x0, int x1, Element type, int temperature) {
+    int start = world_index(world, x0, y);
+    int count = x1 - x0 + 1;
+    memset(&world->grid.type[start], type, count);
+    for (int i = 0; i < count; i++) world->grid.temperature[start + i] = (int16_t)temperature;
+    memset(&world->grid.velocity_x[start], 0, count);
+    memset(&world->grid.velocity_y[start], 0, count);
+    flag_fill_range(world->grid.updated, start, count, !tick_parity(world));
+    chunks_mark_rect(world->chunks, x0 - 1, y - 1, x1 + 1, y + 1);
+    for (int i = 0; i < count; i++) seed_write(world, start + i);
+}
+
+size_t world_memory_bytes(const World *world) {
+    size_t cells = (size_t)(world->rows + 2) * world->stride;
+    return cells * (sizeof(uint8_t) + 2 * sizeof(int16_t) + sizeof(uint16_t) + 2 * sizeof(int8_t)) +
+           3 * ((cells + 63) / 64 * sizeof(uint64_t));  // updated flags, support seen/body bits
+}
+
+void world_step(World *world) {
+    PROFILE_BEGIN(PROFILE_STEP);
+    update_grid(world);
+    world->tick++;
+    PROFILE_END(PROFILE_STEP);
+}
+
+// FNV-1a over the fields that define the visible state. Velocities are left
+// out on purpose: they only ever feed back into movement, so a run that
+// diverges in them shows up in the types a few ticks later.
+uint64_t world_checksum(const World *world) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (int y = 0; y < world->rows; y++) {
+        for (int x = 0; x < world->cols; x++) {
+            int i = world_index(world, x, y);
+            hash = (hash ^ (uint64_t)world->grid.type[i]) * 1099511628211ULL;
+            hash = (hash ^ (uint64_t)(uint32_t)world->grid.temperature[i]) * 1099511628211ULL;
+        }
+    }
+    return hash;
+}
@@ -0,0 +1,156 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "elements.h"
+
+// Simulation core. Nothing in here may depend on raylib so that the same
+// code runs in the game and in the headless benchmark.
+
+#define NEIGHBOR_TOP          1
+#define NEIGHBOR_TOP_RIGHT    2
+#define NEIGHBOR_RIGHT        4
+#define NEIGHBOR_BOTTOM_RIGHT 7
+#define NEIGHBOR_BOTTOM       6
+#define NEIGHBOR_BOTTOM_LEFT  5
+#define NEIGHBOR_LEFT         3
+#define NEIGHBOR_TOP_LEFT     0
+
+#define MAX_TEMPERATURE 1000
+#define MIN_TEMPERATURE 0
+
+// Element enum and per-element rules (elements.h). WALL is the sentinel
+// border around the grid, never painted or drawn.
+
+// Velocities are stored in fixed point, VELOCITY_ONE == 1 cell per tick
+#define VELOCITY_ONE 16
+// Most cells a particle crosses in one tick, what fits in the int8 planes
+#define MAX_TRAVEL (INT8_MAX / VELOCITY_ONE)
+
+// Structure-of-arrays cell storage. Kernels mostly look at the type plane
+// alone, so keeping it dense at one byte per cell is what matters.
+typedef struct {
+    uint8_t *type;          // Element
+    int16_t *temperature;
+    int8_t *velocity_x;
+    int8_t *velocity_y;
+    uint64_t *updated;      // tick parity of the last update, one bit per cell
+} CellPlanes;
+
+// Rule constants that parameter sweeps vary (ensemble.h). world_create sets
+// the defaults, which every other run uses.
+typedef struct {
+    int fire_decay_pct;    // chance per tick that a fire cell dies out, percent
+    float slide_left;      // chance a powder with both diagonals free goes left
+    int boil_offset;       // added to every liquid's boil_point
+    int evaporation_span;  // degrees above boiling at which evaporation is certain
+} SimParams;
+
+extern const SimParams sim_default_params;
+
+typedef struct ChunkMap ChunkMap;
+typedef struct ChunkOutbox ChunkOutbox;
+typedef struct DirtyRect DirtyRect;
+typedef struct ThreadPool ThreadPool;
+typedef struct SupportMap SupportMap;
+typedef struct SupportQueue SupportQueue;
+
+typedef struct {
+    int rows;
+    int cols;
+    int stride;             // cols + 2, planes are (rows + 2) x stride
+    CellPlanes grid;        // updated in place, see update_span
+    int16_t *heat_next;     // thermal stage output, swapped with grid.temperature
+    int thermal_isa;        // ThermalIsa, see thermal.h
+    uint16_t *depth;        // water cells stacked above each water cell
+    bool levelling;         // pressure-driven levelling of connected water
+    uint64_t *level_order;  // per-run scratch, cols entries
+    uint64_t *level_stamp;  // tick + 1 a column last moved water in
+    int neighbor_offset[8]; // index deltas for the NEIGHBOR_* directions
+    ChunkMap *chunks;
+    bool chunking;  // false visits every cell every tick
+    SupportMap *support;    // rigid bodies of solids, see support.h
+    SimParams params;
+    bool in_block;          // struct and planes live in a world_create_in block
+
+    // Checkerboard tile mode, see world_set_threads
+    int threads;
+    ThreadPool *pool;
+    ChunkOutbox *outboxes;
+    int *phase_tiles;
+    DirtyRect *phase_rects;  // rects before a phase's outboxes were merged
+
+    unsigned int seed;
+    uint64_t tick;
+    uint64_t rng_key;   // derived from seed, see rng.h
+    uint64_t tick_key;  // rng_key mixed with the tick being computed
+} World;
+
+// Per-sweep state handed to every kernel
+typedef struct {
+    ChunkOutbox *outbox;  // NULL marks straight into world->chunks
+    SupportQueue *seeds;  // cells whose change may unsupport a solid
+} UpdateCtx;
+
+typedef enum {
+    SCENARIO_EMPTY,
+    SCENARIO_SAND_PILE,
+    SCENARIO_WATER_TANK,
+    SCENARIO_FIRE_STORM,
+    SCENARIO_MIXED,
+    SCENARIO_COUNT
+} Scenario;
+
+// Plane index of interior cell (x, y)
+static inline int world_index(const World *world, int x, int y) {
+    return (y + 1) * world->stride + (x + 1);
+}
+
+static inline int get_neighbor(const World *world, int cell_idx, int neighbor_direction) {
+    return cell_idx + world->neighbor_offset[neighbor_direction];
+}
+
+void swap_cells(CellPlanes *planes, int a, int b);
+float calculate_water_pressure(const World *world, int idx);
+void update_grid(World *world);
+
+// World lifetime. Kernels draw from the counter-based RNG keyed by the seed,
+// and world_create also seeds the global rand() used by the scenarios, so a
+// given seed always produces the same run.
+World *world_create(int rows, int cols, unsigned int seed);
+// Same, but the World and its cell planes are carved out of `block`, which
+// must be world_block_bytes(rows, cols) long and 64-byte aligned. The block
+// stays the caller's; world_destroy frees only the rest.
+World *world_create_in(void *block, int rows, int cols, unsigned int seed);
+size_t world_block_bytes(int rows, int cols);
+void world_destroy(World *world);
+void world_clear(World *world);
+void world_step(World *world);
+// threads <= 0 selects the classic bottom-up row sweep.
+// threads >= 1 runs tiles in four checkerboard phases on a pool of that many
+// threads; results depend only on the seed, never on the thread count.
+bool world_set_threads(World *world, int threads);
+// Anything that writes world->grid outside of world_step (brush, loaders)
+// must report the cell so its tile wakes up.
+void world_mark_dirty(World *world, int idx);
+// Same after the whole grid was rewritten (scenarios, sector windows)
+void world_mark_all(World *world);
+// Overwrites a cell of the current grid (brush, loaders) and wakes its tile
+void world_set_cell(World *world, int idx, Element type, int temperature);
+// Overwrites cells x0..x1 of row y and wakes the tiles around them
+void world_fill_span(World *world, int y, int x0, int x1, Element type, int temperature);
+// Fills the border row y (-1 or rows) with the edge row of a neighbouring
+// grid (strips.h). Kernels read and move into it like any cell, the sweep
+// never visits it, and changes wake the cells next to them.
+void world_set_halo(World *world, int y, const uint8_t *type, const int16_t *temperature);
+size_t world_memory_bytes(const World *world);
+uint64_t world_checksum(const World *world);
+
+// Starting scenarios (scenario.c)
+const char *scenario_name(Scenario scenario);
+int scenario_from_name(const char *name);
+void world_load_scenario(World *world, Scenario scenario);
+
+#endif
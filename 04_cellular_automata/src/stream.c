@@ -0,0 +1,360 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "stream.h"
+#include "chunk.h"
+
+#define TILE_CELLS (CHUNK_SIZE * CHUNK_SIZE)
+#define TILE_BYTES (TILE_CELLS * (sizeof(uint8_t) + sizeof(int16_t)))
+
+static size_t round_up(size_t n, size_t to) {
+    return (n + to - 1) / to * to;
+}
+
+static size_t frame_bytes(uint32_t tile_count, size_t block) {
+    return sizeof(StreamFrame) + round_up((size_t)tile_count * sizeof(uint32_t), 8) + tile_count * block;
+}
+
+// shm_open wants a leading slash, the tools take plain names
+static char *shm_name(const char *name) {
+    size_t length = strlen(name) + 2;
+    char *path = (char *)malloc(length);
+    if (path) snprintf(path, length, "%s%s", name[0] == '/' ? "" : "/", name);
+    return path;
+}
+
+static StreamFrame *slot_frame(uint8_t *base, const StreamHeader *h, uint64_t seq) {
+    return (StreamFrame *)(base + h->header_bytes + (seq % h->slot_count) * h->slot_bytes);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    PRODUCER    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+struct Stream {
+    char *name;
+    uint8_t *base;
+    size_t size;
+    StreamHeader *header;
+    uint32_t session;  // reader session the last frame went to
+    uint64_t frames;  // head, only this side writes it
+    uint64_t drops;
+};
+
+Stream *stream_create(const char *name, const World *world) {
+    Stream *stream = (Stream *)calloc(1, sizeof(Stream));
+    if (!stream) return NULL;
+    stream->name = shm_name(name);
+    if (!stream->name) {
+        free(stream);
+        return NULL;
+    }
+
+    const ChunkMap *chunks = world->chunks;
+    uint32_t tiles = (uint32_t)(chunks->tiles_x * chunks->tiles_y);
+    size_t header_bytes = round_up(sizeof(StreamHeader), 64);
+    size_t slot_bytes = round_up(frame_bytes(tiles, TILE_BYTES), 64);
+    stream->size = header_bytes + STREAM_SLOTS * slot_bytes;
+
+    // A reader of an older stream under this name keeps its own mapping
+    shm_unlink(stream->name);
+    int fd = shm_open(stream->name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    bool ok = fd >= 0 && ftruncate(fd, (off_t)stream->size) == 0;
+    void *base = ok ? mmap(NULL, stream->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    if (fd >= 0) close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Failed to create shared memory %s\n", stream->name);
+        if (fd >= 0) shm_unlink(stream->name);
+        free(stream->name);
+        free(stream);
+        return NULL;
+    }
+    stream->base = (uint8_t *)base;
+
+    StreamHeader *h = (StreamHeader *)base;
+    h->version = STREAM_VERSION;
+    h->header_bytes = (uint32_t)header_bytes;
+    h->rows = world->rows;
+    h->cols = world->cols;
+    h->tiles_x = chunks->tiles_x;
+    h->tiles_y = chunks->tiles_y;
+    h->tile_size = CHUNK_SIZE;
+    h->slot_count = STREAM_SLOTS;
+    h->slot_bytes = slot_bytes;
+    // Readers check the magic first, so it goes in last
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(h->magic, STREAM_MAGIC, sizeof(h->magic));
+    stream->header = h;
+    return stream;
+}
+
+void stream_close(Stream *stream) {
+    if (!stream) return;
+    __atomic_store_n(&stream->header->closed, 1, __ATOMIC_RELEASE);
+    munmap(stream->base, stream->size);
+    shm_unlink(stream->name);
+    free(stream->name);
+    free(stream);
+}
+
+uint64_t stream_frames(const Stream *stream) {
+    return stream->frames;
+}
+
+uint64_t stream_drops(const Stream *stream) {
+    return stream->drops;
+}
+
+static void copy_tile(const World *world, int tiles_x, uint32_t tile, uint8_t *type, int16_t *temperature) {
+    int x0 = (int)(tile % tiles_x) * CHUNK_SIZE;
+    int y0 = (int)(tile / tiles_x) * CHUNK_SIZE;
+    int width = x0 + CHUNK_SIZE <= world->cols ? CHUNK_SIZE : world->cols - x0;
+    int height = y0 + CHUNK_SIZE <= world->rows ? CHUNK_SIZE : world->rows - y0;
+    // Edge tiles: keep the part past the grid deterministic in recordings
+    if (width < CHUNK_SIZE || height < CHUNK_SIZE) {
+        memset(type, 0, TILE_CELLS * sizeof(uint8_t));
+        memset(temperature, 0, TILE_CELLS * sizeof(int16_t));
+    }
+    for (int y = 0; y < height; y++) {
+        int src = world_index(world, x0, y0 + y);
+        memcpy(&type[y * CHUNK_SIZE], &world->grid.type[src], width * sizeof(uint8_t));
+        memcpy(&temperature[y * CHUNK_SIZE], &world->grid.temperature[src], width * sizeof(int16_t));
+    }
+}
+
+bool stream_publish(Stream *stream, World *world) {
+    StreamHeader *h = stream->header;
+    ChunkMap *chunks = world->chunks;
+    if (!__atomic_load_n(&h->reader, __ATOMIC_ACQUIRE)) return false;
+    uint32_t session = __atomic_load_n(&h->session, __ATOMIC_ACQUIRE);
+    uint64_t head = stream->frames;
+    if (head - __atomic_load_n(&h->tail, __ATOMIC_ACQUIRE) >= h->slot_count) {
+        // Changed tiles keep their stream bit and go out with the next frame
+        stream->drops++;
+        __atomic_store_n(&h->drops, stream->drops, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    bool keyframe = session != stream->session;
+    uint32_t tiles = (uint32_t)(chunks->tiles_x * chunks->tiles_y);
+    StreamFrame *frame = slot_frame(stream->base, h, head);
+    uint32_t *index = (uint32_t *)(frame + 1);
+    uint32_t count = 0;
+    for (uint32_t t = 0; t < tiles; t++) {
+        if (keyframe || (chunks->render_dirty[t] & CHUNK_DIRTY_STREAM)) index[count++] = t;
+    }
+    frame->tile_count = count;
+    for (uint32_t k = 0; k < count; k++) {
+        uint8_t *type = (uint8_t *)stream_tile_type(frame, CHUNK_SIZE, k);
+        copy_tile(world, chunks->tiles_x, index[k], type, (int16_t *)(type + TILE_CELLS));
+        chunks->render_dirty[index[k]] &= ~CHUNK_DIRTY_STREAM;
+    }
+    frame->seq = head;
+    frame->tick = world->tick;
+    frame->drops = stream->drops;
+    frame->session = session;
+    frame->flags = keyframe ? STREAM_KEYFRAME : 0;
+    frame->bytes = (uint32_t)frame_bytes(count, TILE_BYTES);
+
+    stream->session = session;
+    stream->frames = head + 1;
+    __atomic_store_n(&h->head, stream->frames, __ATOMIC_RELEASE);
+    return true;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    READER    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+struct StreamReader {
+    uint8_t *base;
+    size_t size;
+    StreamHeader *header;
+    int32_t pid;
+    uint32_t session;
+    uint64_t tail;
+    bool synced;  // seen this session's keyframe
+    const StreamFrame *current;
+};
+
+static bool layout_fits(const StreamHeader *h, size_t size) {
+    size_t tiles = (size_t)h->tiles_x * h->tiles_y;
+    return h->version == STREAM_VERSION && h->header_bytes >= sizeof(StreamHeader) &&
+           h->rows > 0 && h->cols > 0 && h->tile_size == CHUNK_SIZE && h->slot_count > 0 &&
+           h->tiles_x == (h->cols + CHUNK_SIZE - 1) / CHUNK_SIZE &&
+           h->tiles_y == (h->rows + CHUNK_SIZE - 1) / CHUNK_SIZE &&
+           h->slot_bytes >= frame_bytes((uint32_t)tiles, TILE_BYTES) &&
+           h->header_bytes + (uint64_t)h->slot_count * h->slot_bytes <= size;
+}
+
+StreamReader *stream_attach(const char *name) {
+    char *path = shm_name(name);
+    if (!path) return NULL;
+    int fd = shm_open(path, O_RDWR, 0);
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(StreamHeader)) {
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (fd >= 0) close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "No stream at %s\n", path);
+        free(path);
+        return NULL;
+    }
+
+    StreamHeader *h = (StreamHeader *)base;
+    bool ok = memcmp(h->magic, STREAM_MAGIC, sizeof(h->magic)) == 0;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (!ok || !layout_fits(h, (size_t)st.st_size)) {
+        fprintf(stderr, "%s is not a version %d stream\n", path, STREAM_VERSION);
+        munmap(base, (size_t)st.st_size);
+        free(path);
+        return NULL;
+    }
+
+    // One reader at a time; a reader that died without detaching is replaced
+    int32_t pid = (int32_t)getpid();
+    int32_t other = __atomic_load_n(&h->reader, __ATOMIC_ACQUIRE);
+    if (other && other != pid && kill((pid_t)other, 0) == 0) {
+        fprintf(stderr, "%s already has a reader (pid %d)\n", path, (int)other);
+        munmap(base, (size_t)st.st_size);
+        free(path);
+        return NULL;
+    }
+    free(path);
+
+    StreamReader *reader = (StreamReader *)calloc(1, sizeof(StreamReader));
+    if (!reader) {
+        munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+    reader->base = (uint8_t *)base;
+    reader->size = (size_t)st.st_size;
+    reader->header = h;
+    reader->pid = pid;
+    // Free every slot first; the new session is what asks for a keyframe
+    reader->tail = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&h->tail, reader->tail, __ATOMIC_RELEASE);
+    reader->session = __atomic_add_fetch(&h->session, 1, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&h->reader, pid, __ATOMIC_RELEASE);
+    return reader;
+}
+
+void stream_detach(StreamReader *reader) {
+    if (!reader) return;
+    int32_t pid = reader->pid;
+    __atomic_compare_exchange_n(&reader->header->reader, &pid, 0, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    munmap(reader->base, reader->size);
+    free(reader);
+}
+
+const StreamHeader *stream_reader_header(const StreamReader *reader) {
+    return reader->header;
+}
+
+const StreamFrame *stream_next(StreamReader *reader) {
+    const StreamHeader *h = reader->header;
+    while (!reader->current) {
+        if (reader->tail == __atomic_load_n(&h->head, __ATOMIC_ACQUIRE)) return NULL;
+        const StreamFrame *frame = slot_frame(reader->base, h, reader->tail);
+        if (frame->session == reader->session && (frame->flags & STREAM_KEYFRAME)) reader->synced = true;
+        if (reader->synced && frame->tile_count <= (uint32_t)(h->tiles_x * h->tiles_y)) {
+            reader->current = frame;
+        } else {
+            __atomic_store_n(&reader->header->tail, ++reader->tail, __ATOMIC_RELEASE);
+        }
+    }
+    return reader->current;
+}
+
+void stream_release(StreamReader *reader) {
+    if (!reader->current) return;
+    reader->current = NULL;
+    __atomic_store_n(&reader->header->tail, ++reader->tail, __ATOMIC_RELEASE);
+}
+
+bool stream_finished(const StreamReader *reader) {
+    const StreamHeader *h = reader->header;
+    return __atomic_load_n(&h->closed, __ATOMIC_ACQUIRE) &&
+           reader->tail == __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    RECORDINGS    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool stream_file_begin(FILE *out, const StreamHeader *header) {
+    StreamFileHeader h = { 0 };
+    memcpy(h.magic, STREAM_FILE_MAGIC, sizeof(h.magic));
+    h.version = STREAM_VERSION;
+    h.header_bytes = sizeof(StreamFileHeader);
+    h.rows = header->rows;
+    h.cols = header->cols;
+    h.tiles_x = header->tiles_x;
+    h.tiles_y = header->tiles_y;
+    h.tile_size = header->tile_size;
+    return fwrite(&h, sizeof(h), 1, out) == 1;
+}
+
+struct StreamFile {
+    const uint8_t *base;
+    size_t size;
+    size_t offset;  // of the next frame
+};
+
+StreamFile *stream_file_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(StreamFileHeader)) {
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (fd >= 0) close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Failed to open recording %s\n", path);
+        return NULL;
+    }
+
+    const StreamFileHeader *h = (const StreamFileHeader *)base;
+    bool ok = memcmp(h->magic, STREAM_FILE_MAGIC, sizeof(h->magic)) == 0 && h->version == STREAM_VERSION &&
+              h->header_bytes >= sizeof(StreamFileHeader) && h->header_bytes % 8 == 0 &&
+              h->header_bytes <= (size_t)st.st_size && h->tile_size == CHUNK_SIZE && h->rows > 0 &&
+              h->cols > 0 && h->tiles_x == (h->cols + CHUNK_SIZE - 1) / CHUNK_SIZE &&
+              h->tiles_y == (h->rows + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    StreamFile *file = ok ? (StreamFile *)calloc(1, sizeof(StreamFile)) : NULL;
+    if (!file) {
+        if (!ok) fprintf(stderr, "%s is not a version %d recording\n", path, STREAM_VERSION);
+        munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+    file->base = (const uint8_t *)base;
+    file->size = (size_t)st.st_size;
+    file->offset = h->header_bytes;
+    return file;
+}
+
+void stream_file_close(StreamFile *file) {
+    if (!file) return;
+    munmap((void *)file->base, file->size);
+    free(file);
+}
+
+const StreamFileHeader *stream_file_header(const StreamFile *file) {
+    return (const StreamFileHeader *)file->base;
+}
+
+const StreamFrame *stream_file_next(StreamFile *file) {
+    const StreamFileHeader *h = stream_file_header(file);
+    if (file->size - file->offset < sizeof(StreamFrame)) return NULL;
+    const StreamFrame *frame = (const StreamFrame *)(file->base + file->offset);
+    // A frame cut short by a killed recorder ends the file
+    if (frame->tile_count > (uint32_t)(h->tiles_x * h->tiles_y) ||
+        frame->bytes != frame_bytes(frame->tile_count, TILE_BYTES) ||
+        frame->bytes > file->size - file->offset) {
+        return NULL;
+    }
+    file->offset += frame->bytes;
+    return frame;
+}
+
+void stream_file_rewind(StreamFile *file) {
+    file->offset = stream_file_header(file)->header_bytes;
+}
@@ -0,0 +1,137 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim.h"
+
+// Frame stream to another process. The simulation writes the tiles that
+// changed since its last published frame into a ring of slots in POSIX
+// shared memory (/dev/shm/<name>); one reader maps the same memory and
+// reads each frame in place. The writer never waits: with every slot still
+// unread it drops the frame, counts the drop and folds the tiles into the
+// next one. Every attach starts a session whose first frame is a keyframe
+// holding every tile.
+//
+// A frame is a StreamFrame, then tile_count tile indices (padded to 8
+// bytes), then one block per tile: tile_size^2 type bytes followed by
+// tile_size^2 temperatures, row-major. Edge tiles carry the full block and
+// readers clip to rows x cols. Recordings (stream_record) are the same
+// frames back to back behind a StreamFileHeader.
+//
+// POSIX only: used by the headless bench and the stream tools.
+
+#define STREAM_MAGIC "FSANDSHM"
+#define STREAM_FILE_MAGIC "FSANDFRM"
+#define STREAM_VERSION 1
+#define STREAM_SLOTS 8
+#define STREAM_KEYFRAME 0x1  // frame holds every tile
+
+// Producer and reader fields live on their own cache lines
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_bytes;  // first slot starts here
+    int32_t rows;
+    int32_t cols;
+    int32_t tiles_x;
+    int32_t tiles_y;
+    int32_t tile_size;
+    uint32_t slot_count;
+    uint64_t slot_bytes;
+    uint8_t reserved0[16];
+
+    // Producer
+    uint64_t head;    // atomic, frames published
+    uint64_t drops;   // atomic, frames dropped because the reader was behind
+    uint32_t closed;  // atomic, the producer has gone
+    uint8_t reserved1[44];
+
+    // Reader
+    uint64_t tail;    // atomic, frames the reader is done with
+    int32_t reader;   // atomic, pid of the attached reader, 0 for none
+    uint32_t session; // atomic, bumped by every attach
+    uint8_t reserved2[48];
+} StreamHeader;
+
+typedef char stream_header_is_192_bytes[sizeof(StreamHeader) == 192 ? 1 : -1];
+
+typedef struct {
+    uint64_t seq;         // frame number, head when it was written
+    uint64_t tick;        // world tick the frame shows
+    uint64_t drops;       // producer drops so far
+    uint32_t session;     // reader session the frame was written for
+    uint32_t flags;       // STREAM_KEYFRAME
+    uint32_t tile_count;
+    uint32_t bytes;       // whole record, this header included
+} StreamFrame;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_bytes;
+    int32_t rows;
+    int32_t cols;
+    int32_t tiles_x;
+    int32_t tiles_y;
+    int32_t tile_size;
+    uint32_t reserved;
+} StreamFileHeader;
+
+static inline const uint32_t *stream_frame_tiles(const StreamFrame *frame) {
+    return (const uint32_t *)(frame + 1);
+}
+
+static inline const uint8_t *stream_tile_type(const StreamFrame *frame, int tile_size, uint32_t k) {
+    size_t index_bytes = ((size_t)frame->tile_count * sizeof(uint32_t) + 7) & ~(size_t)7;
+    size_t block = (size_t)tile_size * tile_size * (sizeof(uint8_t) + sizeof(int16_t));
+    return (const uint8_t *)(frame + 1) + index_bytes + k * block;
+}
+
+static inline const int16_t *stream_tile_temperature(const StreamFrame *frame, int tile_size, uint32_t k) {
+    return (const int16_t *)(stream_tile_type(frame, tile_size, k) + (size_t)tile_size * tile_size);
+}
+
+// Writing side, in the simulation process
+typedef struct Stream Stream;
+
+// Creates (or replaces) the shared memory `name` sized for `world`
+Stream *stream_create(const char *name, const World *world);
+// Marks the stream closed and unlinks it; a reader keeps its mapping
+void stream_close(Stream *stream);
+// Call once per tick. Writes a frame when a reader is attached and a slot
+// is free, drops it otherwise. Returns true if a frame was written.
+bool stream_publish(Stream *stream, World *world);
+uint64_t stream_frames(const Stream *stream);
+uint64_t stream_drops(const Stream *stream);
+
+// Reading side
+typedef struct StreamReader StreamReader;
+
+// Maps the stream `name` and claims it; fails if another live reader has
+StreamReader *stream_attach(const char *name);
+void stream_detach(StreamReader *reader);
+const StreamHeader *stream_reader_header(const StreamReader *reader);
+// Oldest unread frame, in shared memory, or NULL if there is none yet. It
+// stays valid until stream_release. Frames before this reader's first
+// keyframe are skipped.
+const StreamFrame *stream_next(StreamReader *reader);
+void stream_release(StreamReader *reader);
+// The producer has gone and every frame has been read
+bool stream_finished(const StreamReader *reader);
+
+// Recordings: stream_file_begin writes the file header, frames follow
+bool stream_file_begin(FILE *out, const StreamHeader *header);
+
+typedef struct StreamFile StreamFile;
+
+StreamFile *stream_file_open(const char *path);
+void stream_file_close(StreamFile *file);
+const StreamFileHeader *stream_file_header(const StreamFile *file);
+// Next frame in the mapped file, NULL at the end
+const StreamFrame *stream_file_next(StreamFile *file);
+// Back to the first frame
+void stream_file_rewind(StreamFile *file);
+
+#endif
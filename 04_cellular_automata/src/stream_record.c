@@ -0,0 +1,93 @@
+// Records a frame stream (stream.h) to a file that stream_view -f plays
+// back. Frames are written straight out of the shared memory.
+//
+//   ./stream_record sand sand.frames
+//   ./stream_record -n 600 sand sand.frames
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include "stream.h"
+
+#define POLL_NS 1000000L  // sleep between polls of an empty ring
+
+static volatile sig_atomic_t stop = 0;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "usage: %s [-n frames] stream file\n"
+        "  records until the producer ends, -n frames were written or Ctrl-C\n", prog);
+}
+
+int main(int argc, char **argv) {
+    uint64_t limit = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:h")) != -1) {
+        switch (opt) {
+            case 'n': limit = strtoull(optarg, NULL, 10); break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (argc - optind != 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    StreamReader *reader = stream_attach(argv[optind]);
+    if (!reader) return 1;
+    FILE *out = fopen(argv[optind + 1], "wb");
+    if (!out || !stream_file_begin(out, stream_reader_header(reader))) {
+        fprintf(stderr, "Failed to write %s\n", argv[optind + 1]);
+        if (out) fclose(out);
+        stream_detach(reader);
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    uint64_t tiles = 0;
+    uint64_t first_tick = 0;
+    uint64_t last_tick = 0;
+    bool ok = true;
+    while (!stop && ok && (!limit || frames < limit)) {
+        const StreamFrame *frame = stream_next(reader);
+        if (!frame) {
+            if (stream_finished(reader)) break;
+            struct timespec ts = { 0, POLL_NS };
+            nanosleep(&ts, NULL);
+            continue;
+        }
+        ok = fwrite(frame, frame->bytes, 1, out) == 1;
+        if (!frames) first_tick = frame->tick;
+        last_tick = frame->tick;
+        frames++;
+        bytes += frame->bytes;
+        tiles += frame->tile_count;
+        stream_release(reader);
+    }
+    uint64_t drops = __atomic_load_n(&stream_reader_header(reader)->drops, __ATOMIC_RELAXED);
+    stream_detach(reader);
+    if (fclose(out) != 0) ok = false;
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s\n", argv[optind + 1]);
+        return 1;
+    }
+
+    printf("frames:     %llu, ticks %llu..%llu\n", (unsigned long long)frames,
+           (unsigned long long)first_tick, (unsigned long long)last_tick);
+    printf("written:    %.1f MB, %.1f tiles/frame\n", bytes / 1e6, frames ? (double)tiles / frames : 0.0);
+    printf("dropped:    %llu by the producer\n", (unsigned long long)drops);
+    return 0;
+}
@@ -0,0 +1,150 @@
+// Watches a frame stream (stream.h) published by a headless run, or plays
+// back a file written by stream_record. Tiles are coloured straight out of
+// the shared memory (or the mapped file) into the texture.
+//
+//   ./bench -n 1000000 -O sand & ./stream_view sand
+//   ./stream_view -f sand.frames -z 30
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "raylib.h"
+#include "render.h"
+#include "stream.h"
+
+const int MAX_VIEW_W = 1280;
+const int MAX_VIEW_H = 800;
+const int HUD_H = 24;
+
+typedef struct {
+    StreamReader *reader;  // live, or
+    StreamFile *file;      // playback
+    int tiles;
+    int tile_size;
+    uint64_t frames;       // applied so far
+    uint64_t tick;
+    uint64_t drops;        // producer drops as of the last frame
+    bool ended;
+} Source;
+
+static void apply_frame(Source *source, Renderer *renderer, const StreamFrame *frame) {
+    const uint32_t *tiles = stream_frame_tiles(frame);
+    for (uint32_t k = 0; k < frame->tile_count; k++) {
+        if (tiles[k] >= (uint32_t)source->tiles) continue;
+        renderer_update_tile(renderer, (int)tiles[k], stream_tile_type(frame, source->tile_size, k),
+                             stream_tile_temperature(frame, source->tile_size, k));
+    }
+    source->frames++;
+    source->tick = frame->tick;
+    source->drops = frame->drops;
+}
+
+// Takes what the producer has published, at most one ring's worth so a fast
+// producer cannot hold up drawing
+static void pull_live(Source *source, Renderer *renderer) {
+    uint32_t slots = stream_reader_header(source->reader)->slot_count;
+    for (uint32_t n = 0; n < slots; n++) {
+        const StreamFrame *frame = stream_next(source->reader);
+        if (!frame) break;
+        apply_frame(source, renderer, frame);
+        stream_release(source->reader);
+    }
+    source->ended = stream_finished(source->reader);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "usage: %s stream\n"
+        "       %s -f file [-z fps]\n"
+        "  -f  play a recording from stream_record; space pauses, R restarts\n"
+        "  -z  playback frames per second (default 60)\n", prog, prog);
+}
+
+int main(int argc, char **argv) {
+    const char *file_path = NULL;
+    int fps = 60;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:z:h")) != -1) {
+        switch (opt) {
+            case 'f': file_path = optarg; break;
+            case 'z': fps = atoi(optarg); break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if ((file_path ? argc - optind != 0 : argc - optind != 1) || fps <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Source source = { 0 };
+    int rows, cols;
+    if (file_path) {
+        source.file = stream_file_open(file_path);
+        if (!source.file) return 1;
+        const StreamFileHeader *h = stream_file_header(source.file);
+        rows = h->rows;
+        cols = h->cols;
+        source.tiles = h->tiles_x * h->tiles_y;
+        source.tile_size = h->tile_size;
+    } else {
+        source.reader = stream_attach(argv[optind]);
+        if (!source.reader) return 1;
+        const StreamHeader *h = stream_reader_header(source.reader);
+        rows = h->rows;
+        cols = h->cols;
+        source.tiles = h->tiles_x * h->tiles_y;
+        source.tile_size = h->tile_size;
+    }
+
+    int cell_size = MAX_VIEW_W / cols < MAX_VIEW_H / rows ? MAX_VIEW_W / cols : MAX_VIEW_H / rows;
+    if (cell_size < 1) cell_size = 1;
+    InitWindow(cols * cell_size, rows * cell_size + HUD_H, file_path ? file_path : argv[optind]);
+    SetTargetFPS(file_path ? fps : 60);
+
+    Renderer *renderer = renderer_create(rows, cols);
+    if (!renderer) {
+        CloseWindow();
+        stream_file_close(source.file);
+        stream_detach(source.reader);
+        return 1;
+    }
+
+    bool paused = false;
+    while (!WindowShouldClose()) {
+        if (source.reader) {
+            pull_live(&source, renderer);
+        } else {
+            if (IsKeyReleased(KEY_SPACE)) paused = !paused;
+            // The first frame of a recording is a keyframe, so restarting redraws everything
+            if (IsKeyReleased(KEY_R)) {
+                stream_file_rewind(source.file);
+                source.frames = 0;
+                source.ended = false;
+            }
+            const StreamFrame *frame = paused || source.ended ? NULL : stream_file_next(source.file);
+            if (frame) {
+                apply_frame(&source, renderer, frame);
+            } else if (!paused) {
+                source.ended = true;
+            }
+        }
+
+        BeginDrawing();
+        ClearBackground(BLACK);
+        renderer_draw(renderer, 0, HUD_H, cell_size);
+        const char *state = source.ended ? "  ended" : paused ? "  paused" : "";
+        DrawText(TextFormat("tick %llu  frames %llu  dropped %llu%s", (unsigned long long)source.tick,
+                            (unsigned long long)source.frames, (unsigned long long)source.drops, state),
+                 6, 5, 14, RAYWHITE);
+        EndDrawing();
+    }
+
+    renderer_destroy(renderer);
+    CloseWindow();
+    stream_file_close(source.file);
+    stream_detach(source.reader);
+    return 0;
+}
@@ -0,0 +1,347 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS
+
+#include <errno.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "strips.h"
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~    WIRE    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// A border cell that changed during the step, as sent to its owner
+typedef struct {
+    int32_t x;
+    int16_t temperature;
+    uint8_t type;
+    int8_t velocity_x;
+    int8_t velocity_y;
+    uint8_t pad[3];
+} Claim;
+
+static bool send_all(int fd, const void *data, size_t bytes) {
+    const uint8_t *p = (const uint8_t *)data;
+    while (bytes) {
+        ssize_t n = send(fd, p, bytes, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        bytes -= (size_t)n;
+    }
+    return true;
+}
+
+static bool recv_all(int fd, void *data, size_t bytes) {
+    uint8_t *p = (uint8_t *)data;
+    while (bytes) {
+        ssize_t n = recv(fd, p, bytes, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        bytes -= (size_t)n;
+    }
+    return true;
+}
+
+// One side of a boundary between two strips
+typedef struct {
+    int fd;
+    bool upper;         // this strip is the one above the boundary
+    int row;            // own edge row next to it, 0 or rows - 1
+    int border;         // border row holding the neighbour's halo, -1 or rows
+    uint8_t *sent;      // edge row types as sent this tick
+    uint8_t *halo;      // border row types as received this tick
+    uint8_t *wire;      // halo out, then in: cols temperatures, then cols types
+    Claim *out;         // claims on the neighbour's edge row
+    uint32_t out_count;
+    Claim *in;          // the neighbour's claims on ours
+    uint32_t in_count;
+    uint8_t *replies;   // one byte per claim, 1 granted
+} Boundary;
+
+// Both sides send and receive a message. The upper side sends first and the
+// lower side receives first, so no message size can deadlock the pair.
+static bool swap_message(Boundary *b, const void *out, size_t out_bytes, void *in, size_t in_bytes) {
+    if (b->upper) return send_all(b->fd, out, out_bytes) && recv_all(b->fd, in, in_bytes);
+    return recv_all(b->fd, in, in_bytes) && send_all(b->fd, out, out_bytes);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    EXCHANGE    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static size_t halo_bytes(int cols) {
+    return (size_t)cols * (sizeof(int16_t) + sizeof(uint8_t));
+}
+
+static bool exchange_halo(World *world, Boundary *b) {
+    int cols = world->cols;
+    size_t bytes = halo_bytes(cols);
+    // Temperatures first and the incoming half on 8 bytes, so they stay aligned
+    int16_t *out = (int16_t *)b->wire;
+    int16_t *in = (int16_t *)(b->wire + ((bytes + 7) & ~(size_t)7));
+    int start = world_index(world, 0, b->row);
+    memcpy(out, &world->grid.temperature[start], cols * sizeof(int16_t));
+    memcpy(out + cols, &world->grid.type[start], cols);
+    memcpy(b->sent, out + cols, cols);
+    if (!swap_message(b, out, bytes, in, bytes)) return false;
+
+    const uint8_t *type = (const uint8_t *)(in + cols);
+    world_set_halo(world, b->border, type, in);
+    memcpy(b->halo, type, cols);
+    return true;
+}
+
+static bool exchange_claims(World *world, Boundary *b) {
+    const CellPlanes *grid = &world->grid;
+    int start = world_index(world, 0, b->border);
+    b->out_count = 0;
+    for (int x = 0; x < world->cols; x++) {
+        int idx = start + x;
+        if (grid->type[idx] == b->halo[x]) continue;
+        b->out[b->out_count++] = (Claim){ x, grid->temperature[idx], grid->type[idx],
+                                          grid->velocity_x[idx], grid->velocity_y[idx], { 0 } };
+    }
+    if (!swap_message(b, &b->out_count, sizeof(uint32_t), &b->in_count, sizeof(uint32_t))) return false;
+    if (b->in_count > (uint32_t)world->cols) return false;
+    return swap_message(b, b->out, b->out_count * sizeof(Claim), b->in, b->in_count * sizeof(Claim));
+}
+
+// Grants every claim whose cell still holds what was sent
+static bool exchange_replies(World *world, Boundary *b, StripStats *stats) {
+    int start = world_index(world, 0, b->row);
+    for (uint32_t k = 0; k < b->in_count; k++) {
+        const Claim *c = &b->in[k];
+        int idx = start + c->x;
+        bool valid = c->x >= 0 && c->x < world->cols && c->type < WALL;
+        b->replies[k] = valid && world->grid.type[idx] == b->sent[c->x];
+        if (!b->replies[k]) continue;
+        world_set_cell(world, idx, (Element)c->type, c->temperature);
+        world->grid.velocity_x[idx] = c->velocity_x;
+        world->grid.velocity_y[idx] = c->velocity_y;
+        stats->granted++;
+    }
+    stats->claims += b->out_count;
+    // Our replies go out as theirs come in, so the sizes are each side's claim counts
+    return swap_message(b, b->replies, b->in_count, b->replies + b->in_count, b->out_count);
+}
+
+// Nearest cell of `type`, searching rows inward from the edge and each row
+// outward from column x
+static int find_nearest(const World *world, int x, int row, int inward, uint8_t type) {
+    for (int d = 0; d < world->rows; d++) {
+        int base = world_index(world, 0, row + d * inward);
+        for (int dx = 0; dx < world->cols; dx++) {
+            if (x - dx < 0 && x + dx >= world->cols) break;
+            if (x - dx >= 0 && world->grid.type[base + x - dx] == type) return base + x - dx;
+            if (dx && x + dx < world->cols && world->grid.type[base + x + dx] == type) return base + x + dx;
+        }
+    }
+    return -1;
+}
+
+// A refused move left a copy of the neighbour's cell with us and took the
+// particle away: turn the nearest such copy back into the particle. Burns
+// and melts are simply dropped, nothing of ours moved for them.
+static void undo_refused(World *world, Boundary *b, StripStats *stats) {
+    const uint8_t *replies = b->replies + b->in_count;
+    int inward = b->row == 0 ? 1 : -1;
+    for (uint32_t k = 0; k < b->out_count; k++) {
+        if (replies[k]) continue;
+        const Claim *c = &b->out[k];
+        uint8_t displaced = b->halo[c->x];
+        if (displaced != NONE && element_info[displaced].move != MOVE_LIQUID) continue;
+        int idx = find_nearest(world, c->x, b->row, inward, displaced);
+        if (idx < 0) {
+            stats->lost++;
+            continue;
+        }
+        world_set_cell(world, idx, (Element)c->type, c->temperature);
+        stats->returned++;
+    }
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~    STRIP    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// What every strip hands back to the parent, in shared memory
+typedef struct {
+    uint8_t *type;          // rows x cols
+    int16_t *temperature;
+    StripStats *stats;      // one per strip
+} Results;
+
+static bool boundary_init(Boundary *b, int fd, bool upper, const World *world) {
+    int cols = world->cols;
+    b->fd = fd;
+    b->upper = upper;
+    b->row = upper ? world->rows - 1 : 0;
+    b->border = upper ? world->rows : -1;
+    b->sent = (uint8_t *)malloc(cols);
+    b->halo = (uint8_t *)malloc(cols);
+    b->wire = (uint8_t *)malloc(2 * ((halo_bytes(cols) + 7) & ~(size_t)7));
+    b->out = (Claim *)malloc(cols * sizeof(Claim));
+    b->in = (Claim *)malloc(cols * sizeof(Claim));
+    b->replies = (uint8_t *)malloc(2 * (size_t)cols);
+    return b->sent && b->halo && b->wire && b->out && b->in && b->replies;
+}
+
+static void boundary_free(Boundary *b) {
+    free(b->sent);
+    free(b->halo);
+    free(b->wire);
+    free(b->out);
+    free(b->in);
+    free(b->replies);
+}
+
+// Body of strip process `strip`, rows [y0, y1) of `full`. up and down are
+// the sockets to the neighbours, -1 at the edges of the grid.
+static bool run_strip(const World *full, int strip, int y0, int y1, int ticks, int up, int down,
+                      const Results *results) {
+    int cols = full->cols;
+    World *world = world_create(y1 - y0, cols, full->seed + (unsigned int)strip * 0x9E3779B9u);
+    Boundary bounds[2];
+    int count = 0;
+    memset(bounds, 0, sizeof(bounds));
+    bool ok = world != NULL;
+    // Red-black order: even strips talk down first, odd ones up first, so
+    // pairs (0,1), (2,3), ... exchange at once and (1,2), ... after
+    int first = strip % 2 == 0 ? down : up;
+    int second = strip % 2 == 0 ? up : down;
+    if (ok && first >= 0) ok = boundary_init(&bounds[count++], first, first == down, world);
+    if (ok && second >= 0) ok = boundary_init(&bounds[count++], second, second == down, world);
+    if (!ok) {
+        for (int i = 0; i < count; i++) boundary_free(&bounds[i]);
+        world_destroy(world);
+        return false;
+    }
+
+    world->levelling = full->levelling;
+    world->chunking = full->chunking;
+    world->thermal_isa = full->thermal_isa;
+    world->params = full->params;
+    world->tick = full->tick;
+    world_clear(world);
+    for (int y = y0; y < y1; y++) {
+        int from = world_index(full, 0, y);
+        int to = world_index(world, 0, y - y0);
+        memcpy(&world->grid.type[to], &full->grid.type[from], cols);
+        memcpy(&world->grid.temperature[to], &full->grid.temperature[from], cols * sizeof(int16_t));
+        memcpy(&world->grid.velocity_x[to], &full->grid.velocity_x[from], cols);
+        memcpy(&world->grid.velocity_y[to], &full->grid.velocity_y[from], cols);
+    }
+    world_mark_all(world);
+
+    StripStats *stats = &results->stats[strip];
+    for (int t = 0; t < ticks && ok; t++) {
+        uint64_t t0 = now_ns();
+        for (int i = 0; i < count && ok; i++) ok = exchange_halo(world, &bounds[i]);
+        uint64_t t1 = now_ns();
+        world_step(world);
+        uint64_t t2 = now_ns();
+        for (int i = 0; i < count && ok; i++) ok = exchange_claims(world, &bounds[i]);
+        for (int i = 0; i < count && ok; i++) ok = exchange_replies(world, &bounds[i], stats);
+        for (int i = 0; i < count && ok; i++) undo_refused(world, &bounds[i], stats);
+        uint64_t t3 = now_ns();
+        stats->step_ns += t2 - t1;
+        stats->exchange_ns += (t1 - t0) + (t3 - t2);
+    }
+    if (!ok) fprintf(stderr, "Strip %d lost its neighbour\n", strip);
+
+    for (int y = y0; y < y1; y++) {
+        int from = world_index(world, 0, y - y0);
+        memcpy(&results->type[(size_t)y * cols], &world->grid.type[from], cols);
+        memcpy(&results->temperature[(size_t)y * cols], &world->grid.temperature[from], cols * sizeof(int16_t));
+    }
+    for (int i = 0; i < count; i++) boundary_free(&bounds[i]);
+    world_destroy(world);
+    return ok;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~    PARENT    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool strips_run(World *world, int processes, int ticks, StripStats *stats) {
+    int rows = world->rows;
+    int cols = world->cols;
+    if (processes < 1 || rows / processes < 2) {
+        fprintf(stderr, "Cannot cut %d rows into %d strips of at least 2\n", rows, processes);
+        return false;
+    }
+
+    size_t cells = (size_t)rows * cols;
+    size_t bytes = cells * (sizeof(uint8_t) + sizeof(int16_t)) + processes * sizeof(StripStats);
+    void *shared = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        fprintf(stderr, "Failed to map %zu bytes for strip results\n", bytes);
+        return false;
+    }
+    Results results;
+    results.stats = (StripStats *)shared;
+    results.temperature = (int16_t *)(results.stats + processes);
+    results.type = (uint8_t *)(results.temperature + cells);
+    memset(results.stats, 0, processes * sizeof(StripStats));
+
+    // sockets[2k] is strip k's end of boundary k, sockets[2k + 1] strip k + 1's
+    int *sockets = (int *)malloc(2 * (processes > 1 ? processes - 1 : 1) * sizeof(int));
+    pid_t *pids = (pid_t *)calloc(processes, sizeof(pid_t));
+    bool ok = sockets && pids;
+    int opened = 0;
+    for (int k = 0; ok && k < processes - 1; k++) {
+        ok = socketpair(AF_UNIX, SOCK_STREAM, 0, &sockets[2 * k]) == 0;
+        if (ok) opened++;
+    }
+    if (!ok) fprintf(stderr, "Failed to set up %d strips\n", processes);
+
+    fflush(stdout);
+    fflush(stderr);
+    int started = 0;
+    for (int s = 0; ok && s < processes; s++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            fprintf(stderr, "Failed to start strip %d\n", s);
+            ok = false;
+            break;
+        }
+        if (pid == 0) {
+            int up = s > 0 ? sockets[2 * (s - 1) + 1] : -1;
+            int down = s < processes - 1 ? sockets[2 * s] : -1;
+            for (int i = 0; i < 2 * opened; i++) {
+                if (sockets[i] != up && sockets[i] != down) close(sockets[i]);
+            }
+            int y0 = (int)((int64_t)rows * s / processes);
+            int y1 = (int)((int64_t)rows * (s + 1) / processes);
+            _exit(run_strip(world, s, y0, y1, ticks, up, down, &results) ? 0 : 1);
+        }
+        pids[s] = pid;
+        started++;
+    }
+    // Strips still running notice a missing neighbour as a closed socket
+    for (int i = 0; i < 2 * opened; i++) close(sockets[i]);
+    for (int s = 0; s < started; s++) {
+        int status;
+        while (waitpid(pids[s], &status, 0) < 0 && errno == EINTR) {}
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+    }
+
+    if (ok) {
+        world->tick += (uint64_t)ticks;
+        world_clear(world);
+        for (int y = 0; y < rows; y++) {
+            int to = world_index(world, 0, y);
+            memcpy(&world->grid.type[to], &results.type[(size_t)y * cols], cols);
+            memcpy(&world->grid.temperature[to], &results.temperature[(size_t)y * cols], cols * sizeof(int16_t));
+        }
+        world_mark_all(world);
+        memcpy(stats, results.stats, processes * sizeof(StripStats));
+    }
+    free(sockets);
+    free(pids);
+    munmap(shared, bytes);
+    return ok;
+}
@@ -0,0 +1,45 @@
+#ifndef STRIPS_H
+#define STRIPS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim.h"
+
+// Domain decomposition over processes. The grid is cut into horizontal
+// strips, one forked process each, and neighbouring strips talk over a UNIX
+// domain socket pair. Every tick runs in three exchanges per boundary:
+//
+//   halo    each strip sends its edge row (type and temperature) and puts
+//           the neighbour's into its border row (world_set_halo)
+//   claims  after the local step, every border cell that no longer holds
+//           what arrived is a claim on the neighbour's cell: a particle
+//           moved in (swapping with an empty or liquid cell), or fire
+//           burnt or melted it
+//   replies the owner grants a claim if its cell still holds the type it
+//           sent, i.e. nothing of its own moved there in the meantime. A
+//           refused move is undone by turning the nearest cell of the
+//           swapped-in type back into the particle; a refused burn is
+//           dropped. Types are conserved either way.
+//
+// Strips run their own seeds and see their neighbours one tick late, so
+// results depend on the strip count; with one strip the run is exactly the
+// single-process one. Bodies of solids reaching across a boundary are held
+// up by it, and water pressure does not carry over.
+//
+// POSIX only: used by the headless bench.
+
+typedef struct {
+    uint64_t step_ns;      // local world_step time
+    uint64_t exchange_ns;  // sending, waiting for and applying neighbour data
+    uint64_t claims;       // cells claimed from neighbours
+    uint64_t granted;
+    uint64_t returned;     // refused moves put back
+    uint64_t lost;         // refused moves with nowhere to go back to
+} StripStats;
+
+// Runs `world` for `ticks` ticks as `processes` strips (each at least 2
+// rows) and writes the final types and temperatures back into it. `stats`
+// gets one entry per strip. Returns false if a process failed.
+bool strips_run(World *world, int processes, int ticks, StripStats *stats);
+
+#endif
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "support.h"
+#include "chunk.h"
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~    STORAGE    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+SupportMap *support_create(int cells, int tiles) {
+    SupportMap *map = (SupportMap *)calloc(1, sizeof(SupportMap));
+    if (!map) return NULL;
+    map->queue_count = tiles + 1;
+    map->queues = (SupportQueue *)calloc(map->queue_count, sizeof(SupportQueue));
+    map->seen = (uint64_t *)calloc((cells + 63) / 64, sizeof(uint64_t));
+    map->body = (uint64_t *)calloc((cells + 63) / 64, sizeof(uint64_t));
+    if (!map->queues || !map->seen || !map->body) {
+        support_destroy(map);
+        return NULL;
+    }
+    map->survey = true;
+    return map;
+}
+
+void support_destroy(SupportMap *map) {
+    if (!map) return;
+    for (int q = 0; map->queues && q < map->queue_count; q++) free(map->queues[q].cells);
+    free(map->queues);
+    free(map->seen);
+    free(map->body);
+    free(map->visited);
+    free(map);
+}
+
+SupportQueue *support_main_queue(SupportMap *map) {
+    return &map->queues[map->queue_count - 1];
+}
+
+static bool grow_ints(int **cells, int *capacity) {
+    int grown = *capacity ? *capacity * 2 : 256;
+    int *more = (int *)realloc(*cells, grown * sizeof(int));
+    if (!more) {
+        fprintf(stderr, "Failed to grow support scratch to %d cells\n", grown);
+        return false;
+    }
+    *cells = more;
+    *capacity = grown;
+    return true;
+}
+
+bool support_queue_grow(SupportQueue *queue) {
+    return grow_ints(&queue->cells, &queue->capacity);
+}
+
+void support_survey(SupportMap *map) {
+    for (int q = 0; q < map->queue_count; q++) map->queues[q].count = 0;
+    map->survey = true;
+}
+
+// Only touched by support_resolve on the sim thread, no atomics needed
+static inline bool bit_get(const uint64_t *plane, int idx) {
+    return (plane[idx >> 6] >> (idx & 63)) & 1;
+}
+
+static inline void bit_set(uint64_t *plane, int idx) {
+    plane[idx >> 6] |= 1ULL << (idx & 63);
+}
+
+static inline void bit_clear(uint64_t *plane, int idx) {
+    plane[idx >> 6] &= ~(1ULL << (idx & 63));
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~    BODIES    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static inline bool is_solid(uint8_t type) {
+    return element_info[type].move == MOVE_SOLID;
+}
+
+// Solids in the border rows belong to a neighbouring strip (strips.h); a
+// body reaching into one is held by it
+static inline bool in_border_row(const World *world, int idx) {
+    return idx < world->stride || idx >= (world->rows + 1) * world->stride;
+}
+
+static inline bool holds_up(uint8_t type) {
+    return type == WALL || element_info[type].move == MOVE_POWDER;
+}
+
+// What a falling body may push aside
+static inline bool gives_way(uint8_t type) {
+    return type == NONE || element_info[type].move == MOVE_LIQUID;
+}
+
+static bool visit(SupportMap *map, int idx) {
+    if (map->visited_count == map->visited_capacity && !grow_ints(&map->visited, &map->visited_capacity)) {
+        return false;
+    }
+    map->visited[map->visited_count++] = idx;
+    bit_set(map->seen, idx);
+    bit_set(map->body, idx);
+    return true;
+}
+
+// Flood-fills the body around start into visited[first..]. Returns true as
+// soon as it is known to be held: a cell rests on WALL or a powder, or the
+// body touches one already examined this resolve (held, or just dropped
+// onto). Running out of memory also counts as held, nothing moves then.
+static bool label_body(World *world, SupportMap *map, int start) {
+    const uint8_t *type = world->grid.type;
+    if (!visit(map, start)) return true;
+    for (int head = map->visited_count - 1; head < map->visited_count; head++) {
+        int idx = map->visited[head];
+        if (holds_up(type[get_neighbor(world, idx, NEIGHBOR_BOTTOM_LEFT)]) ||
+            holds_up(type[get_neighbor(world, idx, NEIGHBOR_BOTTOM)]) ||
+            holds_up(type[get_neighbor(world, idx, NEIGHBOR_BOTTOM_RIGHT)])) {
+            return true;
+        }
+        for (int n = 0; n < 8; n++) {
+            int next = get_neighbor(world, idx, n);
+            if (!is_solid(type[next]) || bit_get(map->body, next)) continue;
+            if (in_border_row(world, next) || bit_get(map->seen, next) || !visit(map, next)) return true;
+        }
+    }
+    return false;
+}
+
+static int compare_desc(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x < y) - (x > y);
+}
+
+// Moves a free body one row down. Cells are swapped bottom row first, so a
+// liquid under the body rises through it and ends up on top. False if
+// something the body cannot push aside (fire) is in the way.
+static bool drop_body(World *world, SupportMap *map, int first) {
+    CellPlanes *grid = &world->grid;
+    int stride = world->stride;
+    int *body = &map->visited[first];
+    int count = map->visited_count - first;
+
+    for (int i = 0; i < count; i++) {
+        uint8_t below = grid->type[body[i] + stride];
+        if (!is_solid(below) && !gives_way(below)) return false;
+    }
+
+    qsort(body, count, sizeof(int), compare_desc);
+    int x0 = world->cols, y0 = world->rows, x1 = -1, y1 = -1;
+    for (int i = 0; i < count; i++) {
+        swap_cells(grid, body[i], body[i] + stride);
+        bit_clear(map->seen, body[i]);
+        int x = body[i] % stride - 1;
+        int y = body[i] / stride - 1;
+        if (x < x0) x0 = x;
+        if (x > x1) x1 = x;
+        if (y < y0) y0 = y;
+        if (y > y1) y1 = y;
+    }
+    // The seen bits follow the body so later bodies treat it as examined
+    for (int i = 0; i < count; i++) {
+        body[i] += stride;
+        bit_set(map->seen, body[i]);
+    }
+    chunks_mark_rect(world->chunks, x0 - 1, y0 - 1, x1 + 1, y1 + 2);
+    return true;
+}
+
+// Examines the bodies a seed may have affected: the seed's own and those of
+// its 8 neighbours. Free bodies drop; those still in the air (falling, or
+// stuck above fire) are queued for the next tick.
+static void examine(World *world, SupportMap *map, int seed, SupportQueue *carry) {
+    const uint8_t *type = world->grid.type;
+    for (int n = -1; n < 8; n++) {
+        int start = n < 0 ? seed : get_neighbor(world, seed, n);
+        if (!is_solid(type[start]) || in_border_row(world, start) || bit_get(map->seen, start)) continue;
+
+        int first = map->visited_count;
+        bool held = label_body(world, map, start);
+        for (int i = first; i < map->visited_count; i++) bit_clear(map->body, map->visited[i]);
+        if (held) continue;
+        drop_body(world, map, first);
+        support_push(carry, map->visited[first]);
+    }
+}
+
+void support_resolve(World *world) {
+    SupportMap *map = world->support;
+    SupportQueue *carry = support_main_queue(map);
+    map->visited_count = 0;
+
+    if (map->survey) {
+        // Every solid gets examined, the seeds add nothing
+        map->survey = false;
+        for (int q = 0; q < map->queue_count; q++) map->queues[q].count = 0;
+        for (int y = world->rows - 1; y >= 0; y--) {
+            int base = world_index(world, 0, y);
+            for (int x = 0; x < world->cols; x++) {
+                if (is_solid(world->grid.type[base + x])) examine(world, map, base + x, carry);
+            }
+        }
+    } else {
+        // Tiles in index order, then the row sweep, loaders and last tick's
+        // falling bodies, so the result does not depend on the thread count
+        int pending = carry->count;
+        for (int q = 0; q < map->queue_count; q++) {
+            SupportQueue *queue = &map->queues[q];
+            int count = queue == carry ? pending : queue->count;
+            for (int i = 0; i < count; i++) examine(world, map, queue->cells[i], carry);
+        }
+        for (int q = 0; q < map->queue_count - 1; q++) map->queues[q].count = 0;
+        // Keep only what this resolve queued for the next tick
+        for (int i = pending; i < carry->count; i++) carry->cells[i - pending] = carry->cells[i];
+        carry->count -= pending;
+    }
+
+    for (int i = 0; i < map->visited_count; i++) bit_clear(map->seen, map->visited[i]);
+}
@@ -0,0 +1,53 @@
+#ifndef SUPPORT_H
+#define SUPPORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sim.h"
+
+// Structural support for solids. Touching solid cells (8-connected) form one
+// rigid body. A body is held up when any of its cells has WALL or a powder
+// in one of the three cells below; otherwise the whole body drops one row
+// per tick, pushing liquids up through it, and stops when it lands.
+//
+// Nothing is checked per cell per tick. Kernels and loaders push seeds for
+// cells whose change may cost a body its support (a solid removed, a powder
+// moving out from under one, a solid painted in). After the sweep,
+// support_resolve labels only the bodies next to those seeds, stops as soon
+// as it finds a supporting cell, and moves the ones that have none. Falling
+// bodies seed themselves again for the next tick.
+
+// Seeds pushed by one sweep context. In tile mode every tile has its own,
+// so concurrent tiles never share one.
+typedef struct SupportQueue {
+    int *cells;
+    int count;
+    int capacity;
+} SupportQueue;
+
+typedef struct SupportMap {
+    SupportQueue *queues;  // one per tile, then the row sweep and loaders
+    int queue_count;
+    uint64_t *seen;        // one bit per cell, set while a resolve runs
+    uint64_t *body;        // one bit per cell of the body being labelled
+    int *visited;          // cells whose seen bit is set, grouped by body
+    int visited_count;
+    int visited_capacity;
+    bool survey;           // grid replaced wholesale: examine every solid
+} SupportMap;
+
+SupportMap *support_create(int cells, int tiles);
+void support_destroy(SupportMap *map);
+// Queue the row sweep and writes from outside world_step use
+SupportQueue *support_main_queue(SupportMap *map);
+bool support_queue_grow(SupportQueue *queue);
+// Forget the seeds and examine every solid on the next resolve
+void support_survey(SupportMap *map);
+void support_resolve(World *world);
+
+static inline void support_push(SupportQueue *queue, int idx) {
+    if (queue->count == queue->capacity && !support_queue_grow(queue)) return;
+    queue->cells[queue->count++] = idx;
+}
+
+#endif
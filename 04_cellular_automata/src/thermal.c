@@ -0,0 +1,250 @@
+#include <stdint.h>
+#include "thermal.h"
+#include "chunk.h"
+#include "pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define THERMAL_X86 1
+#include <immintrin.h>
+#endif
+
+// Per-element coefficients in Q8, indexed by Element and padded to 16 so
+// they double as pshufb tables. Conductivity is the share of the gap to the
+// 4-neighbour mean closed per tick; cooling the share of (T - AMBIENT) lost.
+// FIRE and WALL never conduct: fire is a source, the border is insulation.
+// The values come from the element table (elements.h).
+typedef char element_fits_pshufb[ELEMENT_COUNT <= 16 ? 1 : -1];
+#define CONDUCT_ENTRY(name, density, move, burn_point, burn_pct, melt_point, boil_point, \
+                      conduct, ...) [name] = conduct,
+#define COOL_ENTRY(name, density, move, burn_point, burn_pct, melt_point, boil_point, \
+                   conduct, cool, ...) [name] = cool,
+static const uint8_t conduct_q8[16] = { ELEMENT_TABLE(CONDUCT_ENTRY) };
+static const uint8_t cool_q8[16] = { ELEMENT_TABLE(COOL_ENTRY) };
+
+// Both coefficients become Q15 so pmulhrsw can apply them: conductivity
+// also folds in the 1/4 of the neighbour mean.
+#define CONDUCT_SHIFT 5
+#define COOL_SHIFT 7
+
+typedef bool (*ThermalSpan)(const uint8_t *type, const int16_t *in, int16_t *out, int stride, int count);
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~    SCALAR    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Same rounding as pmulhrsw, so every path gives identical results
+static inline int mulhrs(int a, int b) {
+    return (a * b + 0x4000) >> 15;
+}
+
+static bool span_scalar(const uint8_t *type, const int16_t *in, int16_t *out, int stride, int count) {
+    bool changed = false;
+    for (int i = 0; i < count; i++) {
+        int t = in[i];
+        int lap = in[i - stride] + in[i + stride] + in[i - 1] + in[i + 1] - 4 * t;
+        const uint8_t *up = &type[i - stride];
+        const uint8_t *down = &type[i + stride];
+        int fires = (up[-1] == FIRE) + (up[0] == FIRE) + (up[1] == FIRE) +
+                    (type[i - 1] == FIRE) + (type[i + 1] == FIRE) +
+                    (down[-1] == FIRE) + (down[0] == FIRE) + (down[1] == FIRE);
+
+        int v = t + mulhrs(lap, conduct_q8[type[i]] << CONDUCT_SHIFT)
+                  - mulhrs(t - AMBIENT_TEMPERATURE, cool_q8[type[i]] << COOL_SHIFT)
+                  + fires * FIRE_HEAT;
+        if (v > MAX_TEMPERATURE) v = MAX_TEMPERATURE;
+        if (v < MIN_TEMPERATURE) v = MIN_TEMPERATURE;
+
+        out[i] = (int16_t)v;
+        changed |= v != t;
+    }
+    return changed;
+}
+
+#ifdef THERMAL_X86
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    SSSE3    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// 8 cells per step. Each fire compare yields -1 per lane, so the sum is the
+// negated fire count.
+__attribute__((target("ssse3")))
+static bool span_ssse3(const uint8_t *type, const int16_t *in, int16_t *out, int stride, int count) {
+    const __m128i conduct_lut = _mm_loadu_si128((const __m128i *)conduct_q8);
+    const __m128i cool_lut = _mm_loadu_si128((const __m128i *)cool_q8);
+    const __m128i fire = _mm_set1_epi8(FIRE);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ambient = _mm_set1_epi16(AMBIENT_TEMPERATURE);
+    const __m128i heat = _mm_set1_epi16(FIRE_HEAT);
+    const __m128i hi = _mm_set1_epi16(MAX_TEMPERATURE);
+    const __m128i lo = _mm_set1_epi16(MIN_TEMPERATURE);
+    __m128i changed = zero;
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const uint8_t *up = &type[i - stride];
+        const uint8_t *down = &type[i + stride];
+        __m128i ty = _mm_loadl_epi64((const __m128i *)&type[i]);
+        __m128i k = _mm_slli_epi16(_mm_unpacklo_epi8(_mm_shuffle_epi8(conduct_lut, ty), zero), CONDUCT_SHIFT);
+        __m128i c = _mm_slli_epi16(_mm_unpacklo_epi8(_mm_shuffle_epi8(cool_lut, ty), zero), COOL_SHIFT);
+
+        __m128i f = _mm_cmpeq_epi8(_mm_loadl_epi64((const __m128i *)&up[-1]), fire);
+        f = _mm_add_epi8(f, _mm_cmpeq_epi8(_mm_loadl_epi64((const __m128i *)&up[0]), fire));
+        f = _mm_add_epi8(f, _mm_cmpeq_epi8(_mm_loadl_epi64((const __m128i *)&up[1]), fire));
+        f = _mm_add_epi8(f, _mm_cmpeq_epi8(_mm_loadl_epi64((const __m128i *)&type[i - 1]), fire));
+        f = _mm_add_epi8(f, _mm_cmpeq_epi8(_mm_loadl_epi64((const __m128i *)&type[i + 1]), fire));
+        f = _mm_add_epi8(f, _mm_cmpeq_epi8(_mm_loadl_epi64((const __m128i *)&down[-1]), fire));
+        f = _mm_add_epi8(f, _mm_cmpeq_epi8(_mm_loadl_epi64((const __m128i *)&down[0]), fire));
+        f = _mm_add_epi8(f, _mm_cmpeq_epi8(_mm_loadl_epi64((const __m128i *)&down[1]), fire));
+        __m128i fires = _mm_unpacklo_epi8(f, _mm_cmpgt_epi8(zero, f));
+
+        __m128i t = _mm_loadu_si128((const __m128i *)&in[i]);
+        __m128i lap = _mm_add_epi16(
+            _mm_add_epi16(_mm_loadu_si128((const __m128i *)&in[i - stride]),
+                          _mm_loadu_si128((const __m128i *)&in[i + stride])),
+            _mm_add_epi16(_mm_loadu_si128((const __m128i *)&in[i - 1]),
+                          _mm_loadu_si128((const __m128i *)&in[i + 1])));
+        lap = _mm_sub_epi16(lap, _mm_slli_epi16(t, 2));
+
+        __m128i v = _mm_add_epi16(t, _mm_mulhrs_epi16(lap, k));
+        v = _mm_sub_epi16(v, _mm_mulhrs_epi16(_mm_sub_epi16(t, ambient), c));
+        v = _mm_sub_epi16(v, _mm_mullo_epi16(fires, heat));
+        v = _mm_max_epi16(_mm_min_epi16(v, hi), lo);
+
+        _mm_storeu_si128((__m128i *)&out[i], v);
+        changed = _mm_or_si128(changed, _mm_xor_si128(v, t));
+    }
+
+    bool any = _mm_movemask_epi8(_mm_cmpeq_epi8(changed, zero)) != 0xFFFF;
+    return span_scalar(&type[i], &in[i], &out[i], stride, count - i) || any;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~    AVX2    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// 16 cells per step; type bytes stay 128-bit and are widened afterwards
+__attribute__((target("avx2")))
+static bool span_avx2(const uint8_t *type, const int16_t *in, int16_t *out, int stride, int count) {
+    const __m128i conduct_lut = _mm_loadu_si128((const __m128i *)conduct_q8);
+    const __m128i cool_lut = _mm_loadu_si128((const __m128i *)cool_q8);
+    const __m128i fire = _mm_set1_epi8(FIRE);
+    const __m256i ambient = _mm256_set1_epi16(AMBIENT_TEMPERATURE);
+    const __m256i heat = _mm256_set1_epi16(FIRE_HEAT);
+    const __m256i hi = _mm256_set1_epi16(MAX_TEMPERATURE);
+    const __m256i lo = _mm256_set1_epi16(MIN_TEMPERATURE);
+    __m256i changed = _mm256_setzero_si256();
+
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8_t *up = &type[i - stride];
+        const uint8_t *down = &type[i + stride];
+        __m128i ty = _mm_loadu_si128((const __m128i *)&type[i]);
+        __m256i k = _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_shuffle_epi8(conduct_lut, ty)), CONDUCT_SHIFT);
+        __m256i c = _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_shuffle_epi8(cool_lut, ty)), COOL_SHIFT);
+
+        __m128i f = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&up[-1]), fire);
+        f = _mm_add_epi8(f, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&up[0]), fire));
+        f = _mm_add_epi8(f, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&up[1]), fire));
+        f = _mm_add_epi8(f, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&type[i - 1]), fire));
+        f = _mm_add_epi8(f, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&type[i + 1]), fire));
+        f = _mm_add_epi8(f, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&down[-1]), fire));
+        f = _mm_add_epi8(f, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&down[0]), fire));
+        f = _mm_add_epi8(f, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&down[1]), fire));
+        __m256i fires = _mm256_cvtepi8_epi16(f);
+
+        __m256i t = _mm256_loadu_si256((const __m256i *)&in[i]);
+        __m256i lap = _mm256_add_epi16(
+            _mm256_add_epi16(_mm256_loadu_si256((const __m256i *)&in[i - stride]),
+                             _mm256_loadu_si256((const __m256i *)&in[i + stride])),
+            _mm256_add_epi16(_mm256_loadu_si256((const __m256i *)&in[i - 1]),
+                             _mm256_loadu_si256((const __m256i *)&in[i + 1])));
+        lap = _mm256_sub_epi16(lap, _mm256_slli_epi16(t, 2));
+
+        __m256i v = _mm256_add_epi16(t, _mm256_mulhrs_epi16(lap, k));
+        v = _mm256_sub_epi16(v, _mm256_mulhrs_epi16(_mm256_sub_epi16(t, ambient), c));
+        v = _mm256_sub_epi16(v, _mm256_mullo_epi16(fires, heat));
+        v = _mm256_max_epi16(_mm256_min_epi16(v, hi), lo);
+
+        _mm256_storeu_si256((__m256i *)&out[i], v);
+        changed = _mm256_or_si256(changed, _mm256_xor_si256(v, t));
+    }
+
+    bool any = !_mm256_testz_si256(changed, changed);
+    return span_scalar(&type[i], &in[i], &out[i], stride, count - i) || any;
+}
+#endif
+
+static const ThermalSpan span_kernels[THERMAL_ISA_COUNT] = {
+    [THERMAL_SCALAR] = span_scalar,
+#ifdef THERMAL_X86
+    [THERMAL_SSSE3] = span_ssse3,
+    [THERMAL_AVX2] = span_avx2,
+#endif
+};
+
+static const char *isa_names[THERMAL_ISA_COUNT] = {
+    [THERMAL_SCALAR] = "scalar",
+    [THERMAL_SSSE3] = "ssse3",
+    [THERMAL_AVX2] = "avx2",
+};
+
+const char *thermal_isa_name(ThermalIsa isa) {
+    if (isa < 0 || isa >= THERMAL_ISA_COUNT) return "unknown";
+    return isa_names[isa];
+}
+
+static bool isa_supported(ThermalIsa isa) {
+    switch (isa) {
+        case THERMAL_SCALAR: return true;
+#ifdef THERMAL_X86
+        case THERMAL_SSSE3: return __builtin_cpu_supports("ssse3");
+        case THERMAL_AVX2: return __builtin_cpu_supports("avx2");
+#endif
+        default: return false;
+    }
+}
+
+ThermalIsa thermal_best_isa(void) {
+    for (int isa = THERMAL_ISA_COUNT - 1; isa > THERMAL_SCALAR; isa--) {
+        if (isa_supported((ThermalIsa)isa)) return (ThermalIsa)isa;
+    }
+    return THERMAL_SCALAR;
+}
+
+bool thermal_set_isa(World *world, ThermalIsa isa) {
+    if (!isa_supported(isa)) return false;
+    world->thermal_isa = isa;
+    return true;
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~    STAGE    ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// One task per row of tiles. Tasks read the shared planes, write disjoint
+// rows of heat_next and only mark tiles of their own row.
+static void thermal_band_task(void *arg, int ty) {
+    World *world = (World *)arg;
+    ChunkMap *chunks = world->chunks;
+    ThermalSpan span = span_kernels[world->thermal_isa];
+
+    int y0 = ty * CHUNK_SIZE;
+    int y1 = y0 + CHUNK_SIZE < world->rows ? y0 + CHUNK_SIZE : world->rows;
+
+    for (int tx = 0; tx < chunks->tiles_x; tx++) {
+        int x0 = tx * CHUNK_SIZE;
+        int width = x0 + CHUNK_SIZE < world->cols ? CHUNK_SIZE : world->cols - x0;
+        int first = -1;
+        int last = -1;
+
+        for (int y = y0; y < y1; y++) {
+            int idx = world_index(world, x0, y);
+            if (span(&world->grid.type[idx], &world->grid.temperature[idx],
+                     &world->heat_next[idx], world->stride, width)) {
+                if (first < 0) first = y;
+                last = y;
+            }
+        }
+        if (first >= 0) chunks_mark_rect(chunks, x0, first, x0 + width - 1, last);
+    }
+}
+
+void thermal_step(World *world) {
+    if (world->pool) {
+        pool_run(world->pool, world->chunks->tiles_y, thermal_band_task, world);
+    } else {
+        for (int ty = 0; ty < world->chunks->tiles_y; ty++) thermal_band_task(world, ty);
+    }
+
+    int16_t *temperature = world->grid.temperature;
+    world->grid.temperature = world->heat_next;
+    world->heat_next = temperature;
+}
@@ -0,0 +1,34 @@
+#ifndef THERMAL_H
+#define THERMAL_H
+
+#include <stdbool.h>
+#include "sim.h"
+
+// Heat stage. Once per tick, after the particle sweep, every interior cell
+// is rewritten from a 5-point stencil over the temperature plane:
+//
+//   T' = clamp(T + conduct[type] * laplacian - cool[type] * (T - AMBIENT)
+//              + FIRE_HEAT * adjacent fire cells)
+//
+// into world->heat_next, which then becomes the temperature plane. The cost
+// is one pass over the grid whatever is burning. Tiles whose temperatures
+// changed are marked so their kernels see threshold crossings.
+
+#define AMBIENT_TEMPERATURE 20
+#define FIRE_HEAT 12  // per adjacent fire cell per tick
+
+typedef enum {
+    THERMAL_SCALAR,
+    THERMAL_SSSE3,
+    THERMAL_AVX2,
+    THERMAL_ISA_COUNT
+} ThermalIsa;
+
+const char *thermal_isa_name(ThermalIsa isa);
+// Best kernel the running CPU supports
+ThermalIsa thermal_best_isa(void);
+// Returns false if the CPU cannot run `isa`
+bool thermal_set_isa(World *world, ThermalIsa isa);
+void thermal_step(World *world);
+
+#endif